@@ -0,0 +1,228 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#include "asio_http/compression_dictionary.h"
+#include "asio_http/internal/compression.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Compression ratio and throughput of the configured backend, per payload and level. Files given as arguments
+// are measured too. Build once per backend (ASIO_HTTP_COMPRESSION_BACKEND) to compare them. With zstd, small
+// JSON bodies are compressed with gzip, zstd and zstd with a dictionary trained from other bodies
+namespace
+{
+using asio_http::compression_policy;
+using asio_http::compression_settings;
+using asio_http::upload_encoding;
+using asio_http::internal::compress;
+using asio_http::internal::compress_body;
+using asio_http::internal::compression_dictionary;
+using asio_http::internal::compression;
+using asio_http::internal::create_decoder;
+
+const std::size_t                   payload_size = 1024 * 1024;
+const std::chrono::duration<double> min_duration(0.25);
+
+std::vector<std::uint8_t> to_bytes(const std::string& str)
+{
+  return std::vector<std::uint8_t>(str.begin(), str.end());
+}
+
+// An array of records, as returned by a REST API
+std::vector<std::uint8_t> make_json()
+{
+  std::minstd_rand                 random;
+  std::uniform_int_distribution<>  number(0, 100000);
+  const std::vector<std::string>   tags = { "\"new\"", "\"premium\"", "\"trial\"", "\"archived\"", "\"beta\"" };
+  std::string                      json = "[";
+  for (int id = 0; json.size() < payload_size; ++id)
+  {
+    const auto user = std::to_string(number(random));
+    json += std::string(id == 0 ? "" : ",") + "{\"id\":" + std::to_string(id) + ",\"name\":\"user_" + user +
+            "\",\"email\":\"user" + user + "@example.com\",\"active\":" + (number(random) % 2 ? "true" : "false") +
+            ",\"score\":" + std::to_string(number(random) / 100.0) + ",\"tags\":[" + tags[number(random) % 5] + "]}";
+  }
+  return to_bytes(json + "]");
+}
+
+// Words of a small vocabulary, the frequent ones much more often, like natural language
+std::vector<std::uint8_t> make_text()
+{
+  const std::vector<std::string> words = { "the",     "of",     "and",    "to",         "in",       "request",
+                                           "client",  "server", "body",   "connection", "response", "header",
+                                           "timeout", "retry",  "stream", "compressed", "buffer",   "executor" };
+  std::minstd_rand               random;
+  std::geometric_distribution<>  word(0.2);
+  std::string                    text;
+  for (int i = 1; text.size() < payload_size; ++i)
+  {
+    text += words[word(random) % words.size()];
+    text += i % 12 == 0 ? ".\n" : " ";
+  }
+  return to_bytes(text);
+}
+
+// Application log lines
+std::vector<std::uint8_t> make_log()
+{
+  const std::vector<std::string> levels = { "INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR" };
+  std::minstd_rand               random;
+  std::uniform_int_distribution<> number(0, 1000);
+  std::string                    log;
+  for (int i = 0; log.size() < payload_size; ++i)
+  {
+    log += "2019-05-01T12:" + std::to_string(10 + i / 6000 % 50) + ":" + std::to_string(10 + i / 100 % 50) + "." +
+           std::to_string(100 + i % 900) + "Z " + levels[number(random) % levels.size()] + " [worker-" +
+           std::to_string(number(random) % 8) + "] request " + std::to_string(i) + " completed in " +
+           std::to_string(number(random)) + " ms status=" + (number(random) % 10 ? "200" : "503") + "\n";
+  }
+  return to_bytes(log);
+}
+
+#ifdef ASIO_HTTP_HAS_ZSTD
+// Between 200 and 2000 bytes, with the fields of a record
+std::vector<std::vector<std::uint8_t>> make_small_json(std::size_t count)
+{
+  std::minstd_rand                       random;
+  std::uniform_int_distribution<>        number(0, 100000);
+  std::vector<std::vector<std::uint8_t>> bodies;
+  const std::vector<std::string>         events = { "login", "logout", "purchase", "view", "search" };
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    std::string json = "{\"user\":" + std::to_string(number(random)) + ",\"session\":\"" +
+                       std::to_string(number(random)) + "-" + std::to_string(number(random)) + "\",\"events\":[";
+    const auto events_count = 2 + number(random) % 19;
+    for (int j = 0; j < events_count; ++j)
+    {
+      json += std::string(j == 0 ? "" : ",") + "{\"type\":\"" + events[number(random) % events.size()] +
+              "\",\"timestamp\":" + std::to_string(1556712000 + number(random)) + ",\"duration_ms\":" +
+              std::to_string(number(random) % 5000) + ",\"ok\":" + (number(random) % 10 ? "true" : "false") + "}";
+    }
+    bodies.push_back(to_bytes(json + "]}"));
+  }
+  return bodies;
+}
+#endif
+
+template<typename F>
+double get_throughput(std::size_t bytes, F function)
+{
+  std::size_t runs  = 0;
+  const auto  start = std::chrono::steady_clock::now();
+  auto        now   = start;
+  for (; now - start < min_duration; now = std::chrono::steady_clock::now())
+  {
+    function();
+    runs++;
+  }
+  return bytes * runs / std::chrono::duration<double>(now - start).count() / (1024 * 1024);
+}
+
+void run(const std::string& name, const std::vector<std::uint8_t>& payload)
+{
+  for (const int level : { 1, 6, 9 })
+  {
+    compression_settings settings;
+    settings.level = level;
+
+    std::vector<std::uint8_t> compressed;
+    const auto compress_speed = get_throughput(payload.size(), [&]() { compressed = compress(payload, settings); });
+
+    std::vector<std::uint8_t> decompressed;
+    const auto                decompress_speed = get_throughput(payload.size(), [&]() {
+      decompressed.clear();
+      create_decoder(compression::gzip)->decode(compressed.data(), compressed.size(), decompressed);
+    });
+
+    std::printf("%-12s %5d %10zu %8.2f %14.1f %16.1f%s\n",
+                name.c_str(),
+                level,
+                payload.size(),
+                static_cast<double>(payload.size()) / compressed.size(),
+                compress_speed,
+                decompress_speed,
+                decompressed == payload ? "" : "  (round trip failed)");
+  }
+}
+
+#ifdef ASIO_HTTP_HAS_ZSTD
+void run_small(const std::string&                            name,
+               const std::vector<std::vector<std::uint8_t>>& bodies,
+               const compression_settings&                   settings,
+               const compression_dictionary*                 dictionary)
+{
+  std::size_t bytes = 0;
+  for (const auto& body : bodies)
+  {
+    bytes += body.size();
+  }
+
+  std::size_t compressed_bytes = 0;
+  const auto  speed            = get_throughput(bytes, [&]() {
+    compressed_bytes = 0;
+    std::chrono::duration<double> time;
+    for (const auto& body : bodies)
+    {
+      compressed_bytes += compress_body(body, compression_policy::always, settings, dictionary, time).size();
+    }
+  });
+
+  std::printf("%-16s %5d %8.2f %14.1f %12.2f\n",
+              name.c_str(),
+              settings.level,
+              static_cast<double>(bytes) / compressed_bytes,
+              speed,
+              bytes / speed / (1024 * 1024) / bodies.size() * 1e6);
+}
+#endif
+
+void run_small_json()
+{
+#ifdef ASIO_HTTP_HAS_ZSTD
+  // Trained on other bodies than those measured
+  const auto bodies = make_small_json(4000);
+  const auto half   = bodies.begin() + bodies.size() / 2;
+  const compression_dictionary dictionary(
+    asio_http::train_compression_dictionary(std::vector<std::vector<std::uint8_t>>(bodies.begin(), half)));
+  const std::vector<std::vector<std::uint8_t>> measured(half, bodies.end());
+
+  std::printf("\n%-16s %5s %8s %14s %12s\n", "small json", "level", "ratio", "compress MB/s", "us per body");
+  for (const int level : { 1, 3, 6 })
+  {
+    compression_settings settings;
+    settings.level = level;
+    run_small("gzip", measured, settings, nullptr);
+    settings.encoding = upload_encoding::zstd;
+    run_small("zstd", measured, settings, nullptr);
+    run_small("zstd dictionary", measured, settings, &dictionary);
+  }
+#endif
+}
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  std::printf("Backend: %s\n\n", asio_http::internal::get_compression_backend().c_str());
+  std::printf("%-12s %5s %10s %8s %14s %16s\n", "payload", "level", "bytes", "ratio", "compress MB/s", "decompress MB/s");
+
+  run("json", make_json());
+  run("text", make_text());
+  run("log", make_log());
+  run_small_json();
+
+  for (int i = 1; i < argc; ++i)
+  {
+    std::ifstream file(argv[i], std::ios::binary);
+    run(argv[i], std::vector<std::uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()));
+  }
+}
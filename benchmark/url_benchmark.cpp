@@ -0,0 +1,86 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#include "asio_http/url.h"
+
+#include <boost/lexical_cast.hpp>
+#include <chrono>
+#include <cstdio>
+#include <regex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Urls parsed per second by the url constructor, against the std::regex based parser it replaced
+namespace
+{
+const std::chrono::duration<double> min_duration(0.25);
+
+// Keeps the parsed urls from being optimized away
+volatile std::uint16_t sink;
+
+const std::vector<std::string> urls = { "www.google.com",
+                                        "http://127.0.0.1:10123/anything",
+                                        "https://api.example.com/v1/users/1234/orders?status=open&page=2",
+                                        "https://storage.example.com:8443/buckets/logs/2019/05/01/"
+                                        "worker-7.log.gz?signature=0123456789abcdef0123456789abcdef" };
+
+// The previous implementation
+std::tuple<std::string, std::string, std::uint16_t, std::string, std::string> parse_with_regex(const std::string& url)
+{
+  static const std::regex r("^((.+):\\/\\/)?([A-Za-z0-9\\-\\.]+)(:([0-9]+))?(\\/[^?]*)?(\\?.*)?$");
+  std::smatch             what;
+  if (!std::regex_match(url, what, r))
+  {
+    throw std::runtime_error("Failed to parse url: '" + url + "'");
+  }
+
+  const std::string protocol = (what[2].matched ? what[2].str() : std::string("http"));
+
+  std::uint16_t port = 0;
+  if (what[5].length() > 0)
+  {
+    port = boost::lexical_cast<std::uint16_t>(what[5].str());
+  }
+  else if (protocol == "http")
+  {
+    port = 80;
+  }
+  else if (protocol == "https")
+  {
+    port = 443;
+  }
+
+  return std::make_tuple(protocol, what[3].str(), port, what[6].str().empty() ? "/" : what[6].str(), what[7].str());
+}
+
+template<typename F>
+double get_rate(F function)
+{
+  std::size_t runs  = 0;
+  const auto  start = std::chrono::steady_clock::now();
+  auto        now   = start;
+  for (; now - start < min_duration; now = std::chrono::steady_clock::now())
+  {
+    function();
+    runs++;
+  }
+  return runs / std::chrono::duration<double>(now - start).count();
+}
+}  // namespace
+
+int main()
+{
+  std::printf("%-8s %14s %14s %8s\n", "length", "regex urls/s", "parser urls/s", "speedup");
+  for (const auto& str : urls)
+  {
+    const auto regex_rate  = get_rate([&]() { sink = asio_http::url(parse_with_regex(str)).port; });
+    const auto parser_rate = get_rate([&]() { sink = asio_http::url(str).port; });
+
+    std::printf("%-8zu %14.0f %14.0f %7.1fx\n", str.size(), regex_rate, parser_rate, parser_rate / regex_rate);
+  }
+  return 0;
+}
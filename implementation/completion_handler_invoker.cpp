@@ -7,6 +7,7 @@
 #include "asio_http/internal/completion_handler_invoker.h"
 
 #include "asio_http/http_request_result.h"
+#include "asio_http/internal/recycling_allocator.h"
 #include "asio_http/internal/request_data.h"
 
 #include <boost/asio.hpp>
@@ -20,7 +21,9 @@ void completion_handler_invoker::invoke_handler(const request_data& request_data
 {
   boost::asio::dispatch(
     request_data.m_completion_executor,
-    [res = std::move(result), handler = request_data.m_completion_handler]() mutable { handler(std::move(res)); });
+    make_recycling_handler([res = std::move(result), handler = std::move(request_data.m_completion_handler)]() mutable {
+      handler(std::move(res));
+    }));
 }
 }  // namespace internal
 }  // namespace asio_http
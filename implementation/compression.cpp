@@ -6,17 +6,44 @@
 
 #include "asio_http/internal/compression.h"
 
+#include "asio_http/compression_dictionary.h"
+#include "asio_http/http_request_result.h"
+
 #include <loguru.hpp>
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
 #include <cstdint>
 #include <iostream>
 #include <sstream>
 #include <vector>
 #include <zlib.h>
 
+#ifdef ASIO_HTTP_HAS_BROTLI
+#include <brotli/decode.h>
+#endif
+#ifdef ASIO_HTTP_HAS_ZSTD
+#include <zdict.h>
+#include <zstd.h>
+#include <zstd_errors.h>
+#endif
+#ifdef ASIO_HTTP_HAS_LIBDEFLATE
+#include <libdeflate.h>
+#include <memory>
+#endif
+
 namespace
 {
 const int GZIP_ENCODING = 16;
+
+const std::size_t decode_block_size = 32768;
+
+// Compressed, encrypted or random data has close to 8 bits of entropy per byte
+const std::size_t entropy_sample_size      = 4096;
+const std::size_t entropy_sample_slices    = 4;
+const double      max_compressible_entropy = 7.5;
 }
 
 namespace asio_http
@@ -24,41 +51,87 @@ namespace asio_http
 namespace internal
 {
 using std::uint8_t;
-std::vector<uint8_t> compress(const std::vector<uint8_t>& data, int compression_level)
+namespace
 {
-  z_stream             z_str{};
-  std::vector<uint8_t> result;
+// Whole-buffer gzip compression backend. zlib-ng in compatibility mode is a drop-in replacement for zlib
+#ifdef ASIO_HTTP_HAS_LIBDEFLATE
+struct compressor_deleter
+{
+  void operator()(libdeflate_compressor* compressor) const { libdeflate_free_compressor(compressor); }
+};
 
-  // We need a gzip header hence calling deflateInit2
-  if (deflateInit2(&z_str, compression_level, Z_DEFLATED, (GZIP_ENCODING + MAX_WBITS), 8, Z_DEFAULT_STRATEGY) == Z_OK)
+std::vector<uint8_t>
+gzip_compress(const std::vector<uint8_t>& data, const compression_settings& settings, std::size_t max_size)
+{
+  // Compressors are expensive to allocate, so every thread keeps one per level. libdeflate has no strategies
+  thread_local std::array<std::unique_ptr<libdeflate_compressor, compressor_deleter>, 9> compressors;
+
+  const int level      = std::clamp(settings.level, 1, 9);
+  auto&     compressor = compressors[level - 1];
+  if (!compressor)
   {
-    z_str.next_in  = reinterpret_cast<Bytef*>(const_cast<uint8_t*>(data.data()));
-    z_str.avail_in = data.size();
+    compressor.reset(libdeflate_alloc_compressor(level));
+    if (!compressor)
+    {
+      LOG_F(ERROR, "compress: failed to initialize libdeflate for gzip compression");
+      return {};
+    }
+  }
 
-    int                ret;
-    std::vector<Bytef> outbuffer(32768);
+  // Nothing is written when the result does not fit, i.e. it would be useless
+  std::vector<uint8_t> result(std::min(libdeflate_gzip_compress_bound(compressor.get(), data.size()), max_size));
+  result.resize(libdeflate_gzip_compress(compressor.get(), data.data(), data.size(), result.data(), result.size()));
+  return result;
+}
+#else
+int get_zlib_strategy(asio_http::compression_strategy strategy)
+{
+  switch (strategy)
+  {
+    case asio_http::compression_strategy::filtered:
+      return Z_FILTERED;
+    case asio_http::compression_strategy::huffman_only:
+      return Z_HUFFMAN_ONLY;
+    case asio_http::compression_strategy::rle:
+      return Z_RLE;
+    default:
+      return Z_DEFAULT_STRATEGY;
+  }
+}
 
-    // blockwise compression
-    do
-    {
-      z_str.next_out  = outbuffer.data();
-      z_str.avail_out = outbuffer.size();
+std::vector<uint8_t>
+gzip_compress(const std::vector<uint8_t>& data, const compression_settings& settings, std::size_t max_size)
+{
+  z_stream             z_str{};
+  std::vector<uint8_t> result;
 
-      ret = deflate(&z_str, Z_FINISH);
+  // We need a gzip header hence calling deflateInit2
+  if (deflateInit2(&z_str,
+                   std::clamp(settings.level, 1, 9),
+                   Z_DEFLATED,
+                   (GZIP_ENCODING + MAX_WBITS),
+                   8,
+                   get_zlib_strategy(settings.strategy)) == Z_OK)
+  {
+    // Compressed in a single call into a buffer which is large enough, unless the result would be useless
+    result.resize(std::min<std::size_t>(deflateBound(&z_str, data.size()), max_size));
 
-      if (result.size() < z_str.total_out)
-      {
-        uint8_t* const compressed_buffer = reinterpret_cast<uint8_t*>(outbuffer.data());
-        result.insert(result.end(), compressed_buffer, compressed_buffer + z_str.total_out - result.size());
-      }
-    } while (ret == Z_OK);
+    z_str.next_in   = const_cast<Bytef*>(data.data());
+    z_str.avail_in  = data.size();
+    z_str.next_out  = result.data();
+    z_str.avail_out = result.size();
 
+    const int ret = deflate(&z_str, Z_FINISH);
+    result.resize(z_str.total_out);
     deflateEnd(&z_str);
 
     if (ret != Z_STREAM_END)
     {
+      if (ret != Z_OK && ret != Z_BUF_ERROR)
+      {
+        LOG_F(ERROR, "compress: error while attempting gzip compression: %d", ret);
+      }
       result.clear();
-      LOG_F(ERROR, "compress: error while attempting gzip compression: %d", ret);
     }
   }
   else
@@ -68,83 +141,517 @@ std::vector<uint8_t> compress(const std::vector<uint8_t>& data, int compression_
 
   return result;
 }
+#endif
+
+#ifdef ASIO_HTTP_HAS_ZSTD
+struct zstd_context_deleter
+{
+  void operator()(ZSTD_CCtx* context) const { ZSTD_freeCCtx(context); }
+};
+
+// The dictionary, if any, determines the level
+std::vector<uint8_t>
+zstd_compress(const std::vector<uint8_t>& data, int level, const ZSTD_CDict* dictionary, std::size_t max_size)
+{
+  // Contexts are reused, which matters for small bodies
+  thread_local std::unique_ptr<ZSTD_CCtx, zstd_context_deleter> context(ZSTD_createCCtx());
+
+  std::vector<uint8_t> result(std::min(ZSTD_compressBound(data.size()), max_size));
+  const auto           size = dictionary ?
+    ZSTD_compress_usingCDict(context.get(), result.data(), result.size(), data.data(), data.size(), dictionary) :
+    ZSTD_compressCCtx(context.get(), result.data(), result.size(), data.data(), data.size(), level);
+  if (ZSTD_isError(size))
+  {
+    if (ZSTD_getErrorCode(size) != ZSTD_error_dstSize_tooSmall)
+    {
+      LOG_F(ERROR, "compress: error while attempting zstd compression: %s", ZSTD_getErrorName(size));
+    }
+    result.clear();
+  }
+  else
+  {
+    result.resize(size);
+  }
+  return result;
+}
+#endif
+}  // namespace
+
+compression_dictionary::compression_dictionary(std::vector<uint8_t> data)
+    : m_data(std::move(data))
+    , m_id(get_compression_dictionary_id(m_data))
+    , m_mutex()
+    , m_prepared()
+{
+}
+
+compression_dictionary::~compression_dictionary()
+{
+#ifdef ASIO_HTTP_HAS_ZSTD
+  for (const auto prepared : m_prepared)
+  {
+    ZSTD_freeCDict(prepared);
+  }
+#endif
+}
+
+// Parameters are unused without zstd
+std::vector<uint8_t> compression_dictionary::compress([[maybe_unused]] const std::vector<uint8_t>& data,
+                                                      [[maybe_unused]] int                         level,
+                                                      [[maybe_unused]] std::size_t                 max_size) const
+{
+#ifdef ASIO_HTTP_HAS_ZSTD
+  ZSTD_CDict* prepared;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto&                       slot = m_prepared[std::clamp(level, 1, 9) - 1];
+    if (!slot)
+    {
+      slot = ZSTD_createCDict(m_data.data(), m_data.size(), std::clamp(level, 1, 9));
+    }
+    prepared = slot;
+  }
+  if (prepared)
+  {
+    return zstd_compress(data, level, prepared, max_size);
+  }
+  LOG_F(ERROR, "compress: failed to prepare zstd dictionary %u", m_id);
+#endif
+  return {};
+}
+
+std::vector<uint8_t>
+compress(const std::vector<uint8_t>& data, const compression_settings& settings, std::size_t max_size)
+{
+  return gzip_compress(data, settings, max_size);
+}
 
 std::vector<uint8_t> compress(const std::vector<uint8_t>& data)
 {
-  return compress(data, Z_BEST_COMPRESSION);
+  return compress(data, {});
 }
 
-std::vector<uint8_t> decompress_gzip(const std::vector<uint8_t>& data)
+std::string get_compression_backend()
 {
-  z_stream             z_str{};
-  std::vector<uint8_t> result;
+#ifdef ASIO_HTTP_HAS_LIBDEFLATE
+  return "libdeflate " LIBDEFLATE_VERSION_STRING;
+#else
+  return std::string("zlib ") + zlibVersion();
+#endif
+}
+
+bool looks_compressible(const std::vector<uint8_t>& data)
+{
+  // A few slices spread over the data, so headers or padding at the beginning do not decide alone
+  std::array<std::size_t, 256> histogram{};
+  std::size_t                  sampled = 0;
+  for (std::size_t slice = 0; slice < entropy_sample_slices; ++slice)
+  {
+    const auto begin = data.size() * slice / entropy_sample_slices;
+    const auto end   = std::min(data.size(), begin + entropy_sample_size / entropy_sample_slices);
+    for (auto i = begin; i < end; ++i)
+    {
+      histogram[data[i]]++;
+    }
+    sampled += end - begin;
+  }
+
+  double entropy = 0;
+  for (const auto count : histogram)
+  {
+    if (count != 0)
+    {
+      const double p = static_cast<double>(count) / sampled;
+      entropy -= p * std::log2(p);
+    }
+  }
+  return sampled == 0 || entropy < max_compressible_entropy;
+}
+
+std::vector<uint8_t> compress_body(const std::vector<uint8_t>&                    data,
+                                   compression_policy                            policy,
+                                   const compression_settings&                   settings,
+                                   [[maybe_unused]] const compression_dictionary* dictionary,
+                                   std::chrono::duration<double>&                time)
+{
+  time = std::chrono::duration<double>(0);
+  switch (policy)
+  {
+    case compression_policy::never:
+      return {};
+    case compression_policy::when_better:
+      if (data.empty() || data.size() < settings.min_size || (settings.entropy_check && !looks_compressible(data)))
+      {
+        return {};
+      }
+      break;
+    case compression_policy::always:
+      if (data.empty())
+      {
+        return {};
+      }
+      break;
+  }
 
-  if (inflateInit2(&z_str, (GZIP_ENCODING + MAX_WBITS)) != Z_OK)
+  const auto start = std::chrono::steady_clock::now();
+
+  // When it has to be better, compression is given up as soon as the output is not smaller
+  const auto           max_size = policy == compression_policy::always ? SIZE_MAX : data.size() - 1;
+  std::vector<uint8_t> compressed_data;
+#ifdef ASIO_HTTP_HAS_ZSTD
+  if (settings.encoding == upload_encoding::zstd)
   {
-    DLOG_F(ERROR, "decompress_gzip: failed to initialize zlib for gzip decompression");
+    compressed_data = dictionary ? dictionary->compress(data, settings.level, max_size) :
+                                   zstd_compress(data, std::clamp(settings.level, 1, 9), nullptr, max_size);
   }
   else
+#endif
   {
-    z_str.next_in  = reinterpret_cast<Bytef*>(const_cast<uint8_t*>(data.data()));
-    z_str.avail_in = data.size();
+    compressed_data = compress(data, settings, max_size);
+  }
+  time = std::chrono::steady_clock::now() - start;
+  return compressed_data;
+}
 
-    int                ret;
-    std::vector<Bytef> outbuffer(32768);
+std::string get_upload_content_encoding([[maybe_unused]] const compression_settings& settings)
+{
+#ifdef ASIO_HTTP_HAS_ZSTD
+  if (settings.encoding == upload_encoding::zstd)
+  {
+    return "zstd";
+  }
+#endif
+  return "gzip";
+}
 
+namespace
+{
+// Gzip or deflate data. Deflate data may come with or without the zlib wrapper, as servers disagree on it
+class inflater : public decoder
+{
+public:
+  explicit inflater(compression format)
+      : m_stream{}
+      , m_format(format)
+      , m_initialized(false)
+      , m_raw_deflate(false)
+      , m_received(false)
+      , m_finished(false)
+      , m_fed(0)
+  {
+    init(format == compression::gzip ? (GZIP_ENCODING + MAX_WBITS) : MAX_WBITS);
+  }
+
+  ~inflater() override
+  {
+    if (m_initialized)
+    {
+      inflateEnd(&m_stream);
+    }
+  }
+
+  bool decode(const uint8_t* data, std::size_t size, std::vector<uint8_t>& output) override
+  {
+    if (!m_initialized)
+    {
+      return false;
+    }
+    m_received = m_received || size != 0;
+
+    // Whether deflate data has the zlib wrapper is only known once its header has been seen whole, so the first
+    // bytes are held back until then
+    if (m_format == compression::deflate && m_fed == 0)
+    {
+      m_pending.insert(m_pending.end(), data, data + size);
+      if (m_pending.size() < zlib_header_size)
+      {
+        return true;
+      }
+      data = m_pending.data();
+      size = m_pending.size();
+    }
+
+    m_stream.next_in  = const_cast<Bytef*>(data);
+    m_stream.avail_in = size;
+
+    int ret;
     do
     {
-      z_str.next_out  = outbuffer.data();
-      z_str.avail_out = outbuffer.size();
+      // Decompressed straight into the output, growing it a block at a time
+      const auto offset = output.size();
+      output.resize(offset + decode_block_size);
+      m_stream.next_out  = output.data() + offset;
+      m_stream.avail_out = decode_block_size;
 
-      ret = inflate(&z_str, 0);
+      ret = inflate(&m_stream, Z_NO_FLUSH);
+      output.resize(output.size() - m_stream.avail_out);
 
-      if (result.size() < z_str.total_out)
+      // The zlib header is the first thing checked, so nothing has been decompressed when it is missing. All the
+      // data received so far is in this call, so it can be fed again
+      if (ret == Z_DATA_ERROR && m_format == compression::deflate && !m_raw_deflate && m_fed == 0 &&
+          m_stream.total_out == 0)
       {
-        uint8_t* inflated_buffer = reinterpret_cast<uint8_t*>(outbuffer.data());
-        result.insert(result.end(), inflated_buffer, inflated_buffer + z_str.total_out - result.size());
+        m_raw_deflate = true;
+        if (!init(-MAX_WBITS))
+        {
+          return false;
+        }
+        m_stream.next_in   = const_cast<Bytef*>(data);
+        m_stream.avail_in  = size;
+        m_stream.avail_out = 0;
+        ret                = Z_OK;
       }
-    } while (ret == Z_OK);
+    } while (ret == Z_OK && (m_stream.avail_out == 0 || m_stream.avail_in != 0));
 
-    inflateEnd(&z_str);
+    m_fed += size;
+    m_pending.clear();
+    m_finished = m_finished || ret == Z_STREAM_END;
 
-    if (ret != Z_STREAM_END)
+    if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
     {
-      LOG_F(ERROR,
-            "decompress_gzip: error while attempting gzip "
-            "decompression: %d",
-            ret);
+      LOG_F(ERROR, "inflater: error while attempting decompression: %d", ret);
+      return false;
     }
+    return true;
   }
 
-  return result;
-}
+  bool finish() override { return !m_received || m_finished; }
+
+private:
+  static constexpr std::size_t zlib_header_size = 2;
 
-std::vector<uint8_t> decompress_deflate(const std::vector<uint8_t>& data)
+  bool init(int window_bits)
+  {
+    if (m_initialized)
+    {
+      inflateEnd(&m_stream);
+    }
+
+    m_stream      = z_stream{};
+    m_initialized = inflateInit2(&m_stream, window_bits) == Z_OK;
+    if (!m_initialized)
+    {
+      LOG_F(ERROR, "inflater: failed to initialize zlib for decompression");
+    }
+    return m_initialized;
+  }
+
+  z_stream             m_stream;
+  compression          m_format;
+  bool                 m_initialized;
+  bool                 m_raw_deflate;
+  bool                 m_received;
+  bool                 m_finished;
+  std::size_t          m_fed;      // Bytes handed to zlib so far
+  std::vector<uint8_t> m_pending;  // Start of deflate data, until its header is complete
+};
+
+#ifdef ASIO_HTTP_HAS_BROTLI
+class brotli_decoder : public decoder
 {
-  std::vector<uint8_t> result;
-  if (!data.empty())
+public:
+  brotli_decoder()
+      : m_state(BrotliDecoderCreateInstance(nullptr, nullptr, nullptr))
+      , m_received(false)
+      , m_finished(false)
+  {
+  }
+
+  ~brotli_decoder() override { BrotliDecoderDestroyInstance(m_state); }
+
+  bool decode(const uint8_t* data, std::size_t size, std::vector<uint8_t>& output) override
   {
-    // iterate untill the buffer is large enough to hold uncompressed data
-    uLongf             size = data.size() * 2;
-    std::vector<Bytef> buffer;
-    int                error_code;
+    m_received = m_received || size != 0;
+
+    std::size_t         available_in = size;
+    BrotliDecoderResult ret;
     do
     {
-      size *= 2;
-      buffer.resize(size);
-      error_code = uncompress(buffer.data(), &size, reinterpret_cast<const Bytef*>(data.data()), data.size());
-    } while (error_code == Z_BUF_ERROR);
+      const auto  offset        = output.size();
+      std::size_t available_out = decode_block_size;
+      output.resize(offset + decode_block_size);
+      uint8_t* next_out = output.data() + offset;
+
+      ret = BrotliDecoderDecompressStream(m_state, &available_in, &data, &available_out, &next_out, nullptr);
+      output.resize(output.size() - available_out);
+    } while (ret == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT);
+    m_finished = m_finished || ret == BROTLI_DECODER_RESULT_SUCCESS;
+
+    if (ret == BROTLI_DECODER_RESULT_ERROR)
+    {
+      LOG_F(ERROR,
+            "brotli_decoder: error while attempting decompression: %s",
+            BrotliDecoderErrorString(BrotliDecoderGetErrorCode(m_state)));
+      return false;
+    }
+    return true;
+  }
+
+  bool finish() override { return !m_received || m_finished; }
+
+private:
+  BrotliDecoderState* m_state;
+  bool                m_received;
+  bool                m_finished;
+};
+#endif
+
+#ifdef ASIO_HTTP_HAS_ZSTD
+class zstd_decoder : public decoder
+{
+public:
+  zstd_decoder()
+      : m_stream(ZSTD_createDStream())
+      , m_received(false)
+      , m_finished(false)
+  {
+  }
 
-    if (error_code == Z_OK)
+  ~zstd_decoder() override { ZSTD_freeDStream(m_stream); }
+
+  bool decode(const uint8_t* data, std::size_t size, std::vector<uint8_t>& output) override
+  {
+    if (size == 0)
     {
-      result.assign(buffer.begin(), buffer.begin() + size);
+      return true;
     }
-    else
+    m_received = true;
+
+    ZSTD_inBuffer input{ data, size, 0 };
+    std::size_t   ret;
+    bool          output_full;
+    do
+    {
+      const auto offset = output.size();
+      output.resize(offset + decode_block_size);
+      ZSTD_outBuffer out{ output.data() + offset, decode_block_size, 0 };
+
+      ret         = ZSTD_decompressStream(m_stream, &out, &input);
+      output_full = out.pos == out.size;
+      output.resize(offset + out.pos);
+    } while (!ZSTD_isError(ret) && (input.pos != input.size || output_full));
+    // Zero once a frame has been decoded and flushed whole
+    m_finished = ret == 0;
+
+    if (ZSTD_isError(ret))
     {
-      LOG_F(ERROR, "decompress_deflate: error while attempting deflate: %d", error_code);
+      LOG_F(ERROR, "zstd_decoder: error while attempting decompression: %s", ZSTD_getErrorName(ret));
+      return false;
     }
+    return true;
+  }
+
+  bool finish() override { return !m_received || m_finished; }
+
+private:
+  ZSTD_DStream* m_stream;
+  bool          m_received;
+  bool          m_finished;
+};
+#endif
+
+std::string create_accept_encoding()
+{
+  std::string value = "gzip, deflate";
+#ifdef ASIO_HTTP_HAS_BROTLI
+  value += ", br";
+#endif
+#ifdef ASIO_HTTP_HAS_ZSTD
+  value += ", zstd";
+#endif
+  return value;
+}
+}  // namespace
+
+compression get_content_encoding(const http_headers& headers)
+{
+  const std::string value(headers.get(http_header::content_encoding));
+
+  if (iequals(value, "deflate"))
+  {
+    return compression::deflate;
+  }
+  else if (iequals(value, "gzip"))
+  {
+    return compression::gzip;
+  }
+#ifdef ASIO_HTTP_HAS_BROTLI
+  else if (iequals(value, "br"))
+  {
+    return compression::brotli;
+  }
+#endif
+#ifdef ASIO_HTTP_HAS_ZSTD
+  else if (iequals(value, "zstd"))
+  {
+    return compression::zstd;
+  }
+#endif
+  else if (!value.empty() && !iequals(value, "identity"))
+  {
+    LOG_F(ERROR, "Unknown content encoding");
+  }
+  return compression::none;
+}
+
+const std::string& get_accept_encoding()
+{
+  static const std::string value = create_accept_encoding();
+  return value;
+}
+
+std::unique_ptr<decoder> create_decoder(compression format)
+{
+  switch (format)
+  {
+    case compression::deflate:
+    case compression::gzip:
+      return std::make_unique<inflater>(format);
+#ifdef ASIO_HTTP_HAS_BROTLI
+    case compression::brotli:
+      return std::make_unique<brotli_decoder>();
+#endif
+#ifdef ASIO_HTTP_HAS_ZSTD
+    case compression::zstd:
+      return std::make_unique<zstd_decoder>();
+#endif
+    default:
+      return nullptr;
   }
-  return result;
 }
 }  // namespace internal
+
+std::vector<uint8_t> train_compression_dictionary([[maybe_unused]] const std::vector<std::vector<uint8_t>>& samples,
+                                                  [[maybe_unused]] std::size_t                              max_size)
+{
+  std::vector<uint8_t> dictionary;
+#ifdef ASIO_HTTP_HAS_ZSTD
+  std::vector<uint8_t> samples_data;
+  std::vector<size_t>  sample_sizes;
+  for (const auto& sample : samples)
+  {
+    samples_data.insert(samples_data.end(), sample.begin(), sample.end());
+    sample_sizes.push_back(sample.size());
+  }
+
+  dictionary.resize(max_size);
+  const auto size = ZDICT_trainFromBuffer(
+    dictionary.data(), dictionary.size(), samples_data.data(), sample_sizes.data(), sample_sizes.size());
+  if (ZDICT_isError(size))
+  {
+    LOG_F(ERROR, "train_compression_dictionary: training failed: %s", ZDICT_getErrorName(size));
+  }
+  dictionary.resize(ZDICT_isError(size) ? 0 : size);
+#endif
+  return dictionary;
+}
+
+std::uint32_t get_compression_dictionary_id([[maybe_unused]] const std::vector<uint8_t>& dictionary)
+{
+#ifdef ASIO_HTTP_HAS_ZSTD
+  return ZSTD_getDictID_fromDict(dictionary.data(), dictionary.size());
+#else
+  return 0;
+#endif
+}
 }  // namespace asio_http
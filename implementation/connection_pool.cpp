@@ -5,20 +5,26 @@
 */
 #include "asio_http/internal/connection_pool.h"
 
+#include "asio_http/error.h"
+#include "asio_http/internal/http2_client_connection.h"
 #include "asio_http/internal/http_client_connection.h"
 #include "asio_http/internal/http_content.h"
 #include "asio_http/internal/http_stack_shared.h"
 #include "asio_http/internal/encoding.h"
+#include "asio_http/internal/recycling_allocator.h"
 #include "asio_http/internal/socket.h"
 #include "asio_http/internal/tuple_ptr.h"
 #include "asio_http/url.h"
 
 #include "loguru.hpp"
 
+#include <algorithm>
 #include <cinttypes>
 #include <memory>
+#include <mutex>
 #include <tuple>
 #include <utility>
+#include <vector>
 
 namespace asio_http
 {
@@ -73,24 +79,75 @@ struct drop_last : drop_last_impl<std::make_index_sequence<sizeof...(Xs) - 1>, s
 {
 };
 
-template<typename... Ls, template<typename...> typename T, typename Args, std::size_t... I>
-auto allocate_layers(T<Ls...>*, Args&& args, std::index_sequence<I...>)
+// Every stack of a protocol is a block of the same type, so the blocks of closed connections are kept for the
+// next connections of that protocol, to any host
+template<typename T>
+class stack_allocator
 {
-  std::tuple<std::unique_ptr<Ls>...> ptrs;
+public:
+  using value_type = T;
+
+  stack_allocator() = default;
+  template<typename U>
+  stack_allocator(const stack_allocator<U>&)
+  {
+  }
 
-  (std::apply(
-     [&ptrs](auto&&... args) {
-       std::get<I>(ptrs).reset(new
-                               typename std::tuple_element<I, T<Ls...>>::type( std::forward<decltype(args)>(args)... ));
-     },
-     std::get<I>(std::forward<Args>(args))),
-   ...);
+  T* allocate(std::size_t n)
+  {
+    if (n == 1)
+    {
+      auto&                       list = get_free_list();
+      std::lock_guard<std::mutex> lock(list.m_mutex);
+      if (!list.m_blocks.empty())
+      {
+        auto* block = list.m_blocks.back();
+        list.m_blocks.pop_back();
+        return static_cast<T*>(block);
+      }
+    }
+    return std::allocator<T>().allocate(n);
+  }
 
-  connect_layers(drop_first<I...>(), drop_last<I...>(), ptrs);
+  void deallocate(T* p, std::size_t n)
+  {
+    if (n == 1)
+    {
+      auto&                       list = get_free_list();
+      std::lock_guard<std::mutex> lock(list.m_mutex);
+      if (list.m_blocks.size() < max_free_blocks)
+      {
+        list.m_blocks.push_back(p);
+        return;
+      }
+    }
+    std::allocator<T>().deallocate(p, n);
+  }
+
+private:
+  static constexpr std::size_t max_free_blocks = 16;
+
+  struct free_list
+  {
+    std::mutex         m_mutex;
+    std::vector<void*> m_blocks;
+  };
+
+  // Never destroyed, as stacks may be released after static objects are destroyed
+  static free_list& get_free_list()
+  {
+    static auto* list = new free_list();
+    return *list;
+  }
+};
 
-  auto t = std::apply([](auto&&... args) { return tuple_ptr<Ls...>((args.get())...); }, ptrs);
+template<typename... Ls, template<typename...> typename T, typename Args, std::size_t... I>
+auto allocate_layers(T<Ls...>*, Args&& args, std::index_sequence<I...>)
+{
+  auto t = allocate_tuple<stack_allocator, Ls...>(std::forward<Args>(args));
 
-  ((std::get<I>(ptrs).release()), ...);
+  auto layers = std::make_tuple(t.template get<I>()...);
+  connect_layers(drop_first<I...>(), drop_last<I...>(), layers);
 
   return t;
 }
@@ -116,36 +173,78 @@ auto make_shared_stack(Ts... args)
   return allocate_layers(dummy, std::make_tuple(args...), seq());
 }
 
-http_stack connection_pool::get_connection(const url& url, const ssl_settings& ssl)
+http_stack connection_pool::get_connection(const url& url, const ssl_settings& ssl, std::uint32_t pipeline_depth)
 {
   http_stack handle;
 
   auto host = std::make_pair(url.host, url.port);
 
-  if (m_connection_pool[host].empty())
+  const bool http2 = m_http2_max_concurrent_streams != 0 && m_http1_hosts.count(host) == 0;
+  if (http2)
   {
-    handle = create_stack(url, ssl);
-    m_allocations++;
+    pipeline_depth = m_http2_max_concurrent_streams;
   }
-  else
+
+  // Idle connections first, then pipelining on a busy one, and only then a new connection. Nothing is queued
+  // behind a response which closes the connection
+  auto& pipelines = m_pipelined_connections[host];
+  auto  pipeline  = std::find_if(pipelines.begin(), pipelines.end(), [pipeline_depth](const auto& connection) {
+    return !connection.m_retired && connection.m_requests < pipeline_depth && connection.m_handle->is_reusable();
+  });
+
+  if (!m_connection_pool[host].empty())
   {
     handle = m_connection_pool[host].top();
     m_connection_pool[host].pop();
   }
+  else if (pipeline != pipelines.end())
+  {
+    pipeline->m_requests++;
+    return pipeline->m_handle;
+  }
+  else
+  {
+    handle = create_stack(url, ssl, http2);
+    m_allocations++;
+  }
+
+  if (pipeline_depth > 1)
+  {
+    pipelines.push_back({ handle, 1, false });
+  }
 
   return handle;
 }
 
-http_stack connection_pool::create_stack(const url& url, const ssl_settings& ssl)
+http_stack connection_pool::create_stack(const url& url, const ssl_settings& ssl, bool http2)
 {
-  auto shared_data = std::make_shared<http_stack_shared>(m_context);
+  auto shared_data = std::allocate_shared<http_stack_shared>(
+    recycling_allocator<http_stack_shared>(), m_context, m_worker_executor, m_offload_threshold, m_connections);
   auto host        = std::make_pair(url.host, url.port);
 
-  if (url.protocol == "https")
+  if (http2 && url.protocol == "https")
+  {
+    auto stack = make_shared_stack<http_content, encoding, http2_client_connection, ssl_transport>(
+      std::make_tuple(shared_data, std::reference_wrapper(m_context), host),
+      std::make_tuple(shared_data),
+      std::make_tuple(shared_data),
+      std::make_tuple(shared_data, std::reference_wrapper(m_context), url.host, ssl, std::vector<std::string>{ "h2", "http/1.1" }));
+    return stack.get<0>();
+  }
+  else if (http2)
+  {
+    auto stack = make_shared_stack<http_content, encoding, http2_client_connection, transport>(
+      std::make_tuple(shared_data, std::reference_wrapper(m_context), host),
+      std::make_tuple(shared_data),
+      std::make_tuple(shared_data),
+      std::make_tuple(shared_data, std::reference_wrapper(m_context)));
+    return stack.get<0>();
+  }
+  else if (url.protocol == "https")
   {
     auto stack = make_shared_stack<http_content, encoding, http_client_connection, ssl_transport>(
       std::make_tuple(shared_data, std::reference_wrapper(m_context), host),
-      std::make_tuple(),
+      std::make_tuple(shared_data),
       std::make_tuple(shared_data),
       std::make_tuple(shared_data, std::reference_wrapper(m_context), url.host, ssl));
     return stack.get<0>();
@@ -154,18 +253,50 @@ http_stack connection_pool::create_stack(const url& url, const ssl_settings& ssl
   {
     auto stack = make_shared_stack<http_content, encoding, http_client_connection, transport>(
       std::make_tuple(shared_data, std::reference_wrapper(m_context), host),
-      std::make_tuple(),
+      std::make_tuple(shared_data),
       std::make_tuple(shared_data),
       std::make_tuple(shared_data, std::reference_wrapper(m_context)));
     return stack.get<0>();
   }
 }
 
-void connection_pool::release_connection(http_stack handle, bool clean_up)
+void connection_pool::release_connection(http_stack handle, const boost::system::error_code& ec)
 {
   auto http_layer = handle;
 
-  const auto host = http_layer->get_host_and_port();
+  // Multiplexed connections survive the errors of a single stream, but not a GOAWAY from the server
+  const auto host     = http_layer->get_host_and_port();
+  const bool reusable = http_layer->is_reusable();
+  const bool clean_up = ec && !reusable;
+
+  if (ec == http2_error::http_1_1_required)
+  {
+    m_http1_hosts.insert(host);
+  }
+
+  auto& pipelines = m_pipelined_connections[host];
+  auto  pipeline  = std::find_if(
+    pipelines.begin(), pipelines.end(), [&handle](const auto& connection) { return connection.m_handle == handle; });
+  if (pipeline != pipelines.end())
+  {
+    // Still busy with other requests, or it failed and must not be used any more
+    pipeline->m_retired = pipeline->m_retired || !reusable;
+    if (--pipeline->m_requests != 0)
+    {
+      if (clean_up)
+      {
+        m_connection_pool[host] = std::stack<http_stack>();
+      }
+      return;
+    }
+
+    const bool retired = pipeline->m_retired;
+    pipelines.erase(pipeline);
+    if (retired && !clean_up)
+    {
+      return;
+    }
+  }
 
   // Throw away handle in case of error and clean all others
   if (clean_up)
@@ -173,7 +304,7 @@ void connection_pool::release_connection(http_stack handle, bool clean_up)
     auto new_stack = std::stack<http_stack>();
     m_connection_pool[host].swap(new_stack);
   }
-  else
+  else if (reusable)
   {
     m_connection_pool[host].push(handle);
   }
@@ -181,7 +312,23 @@ void connection_pool::release_connection(http_stack handle, bool clean_up)
 
 connection_pool::~connection_pool()
 {
-  DLOG_F(INFO, "Destroyed connection pool after allocations: %" PRIu64, m_allocations);
+  // HTTP/2 connections keep reading while idle, which would keep them, and the io_context, running
+  for (auto& host : m_connection_pool)
+  {
+    for (; !host.second.empty(); host.second.pop())
+    {
+      host.second.top()->close_idle_async();
+    }
+  }
+  for (const auto& host : m_pipelined_connections)
+  {
+    for (const auto& connection : host.second)
+    {
+      connection.m_handle->close_idle_async();
+    }
+  }
+
+  DLOG_F(INFO, "Destroyed connection pool after allocations: %" PRIu64, m_allocations.load());
 }
 }  // namespace internal
 }  // namespace asio_http
@@ -6,10 +6,9 @@
 
 #include "asio_http/internal/data_sink.h"
 #include "asio_http/http_request_result.h"
-#include "asio_http/internal/compression.h"
-
-#include "loguru.hpp"
 
+#include <algorithm>
+#include <cstdlib>
 #include <vector>
 
 namespace asio_http
@@ -22,40 +21,50 @@ using std::uint8_t;
 uint32_t data_sink::write_callback(const void* data, uint32_t size, uint32_t count)
 {
   uint32_t ret = size * count;
-  m_data.write(static_cast<const char*>(data), ret);
+  if (!m_chunk_handler)
+  {
+    const auto begin = static_cast<const uint8_t*>(data);
+    if (m_data.capacity() == 0 && m_small_size + ret <= m_small.size())
+    {
+      std::copy_n(begin, ret, m_small.data() + m_small_size);
+      m_small_size += ret;
+      return ret;
+    }
+    if (m_data.empty())
+    {
+      m_data.insert(m_data.end(), m_small.data(), m_small.data() + m_small_size);
+    }
+    m_data.insert(m_data.end(), begin, begin + ret);
+  }
+  else if (ret != 0)
+  {
+    const auto begin = static_cast<const uint8_t*>(data);
+    m_backlog->push();
+    m_chunk_handler(std::vector<uint8_t>(begin, begin + ret), m_backlog);
+  }
   return ret;
 }
 
-std::vector<uint8_t> data_sink::get_data() const
+http_body data_sink::take_data()
 {
-  const std::string& str = m_data.str();
-  switch (m_compression)
-  {
-    case compression::none:
-      return { str.begin(), str.end() };
-    case compression::deflate:
-      return decompress_deflate(std::vector<uint8_t>(str.begin(), str.end()));
-    case compression::gzip:
-      return decompress_gzip(std::vector<uint8_t>(str.begin(), str.end()));
-  }
+  return m_data.empty() ? http_body(m_small.data(), m_small_size) : http_body(std::move(m_data));
 }
 
-void data_sink::header_callback(const std::vector<std::pair<std::string, std::string>>& headers)
+void data_sink::header_callback(const http_headers& headers)
 {
-  const auto value = get_header(headers, "Content-Encoding");
-
-  if (iequals(value, "deflate"))
+  // The body is received into a single buffer, which may be sized up front
+  const std::string length(headers.get(http_header::content_length));
+  const auto        size = std::strtoull(length.c_str(), nullptr, 10);
+  if (size > m_small.size())
   {
-    m_compression = compression::deflate;
-  }
-  else if (iequals(value, "gzip"))
-  {
-    m_compression = compression::gzip;
-  }
-  else if (!value.empty())
-  {
-    LOG_F(ERROR, "Unknown content encoding");
+    m_data.reserve(std::min<std::uint64_t>(size, max_reserved_size));
   }
 }
+
+void data_sink::set_chunk_handler(chunk_handler handler, std::shared_ptr<body_backlog> backlog)
+{
+  m_chunk_handler = std::move(handler);
+  m_backlog       = std::move(backlog);
+}
 }  // namespace internal
 }  // namespace asio_http
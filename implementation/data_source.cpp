@@ -6,48 +6,83 @@
 
 #include "asio_http/internal/data_source.h"
 
-#include "asio_http/internal/compression.h"
+#include "asio_http/error.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
 
 namespace asio_http
 {
 namespace internal
 {
-namespace
-{
 using std::uint8_t;
 
-auto compress_data_source(std::vector<uint8_t> data, compression_policy policy)
+data_source::data_source(request_body data)
+    : m_data(std::move(data))
+    , m_offset(0)
+    , m_size(m_data->size())
+    , m_generator()
+    , m_generator_size()
+    , m_generated(0)
+    , m_generator_used(false)
+{
+}
+
+data_source::data_source(body_generator generator, std::optional<std::uint64_t> size)
+    : m_data()
+    , m_offset(0)
+    , m_size(size.value_or(0))
+    , m_generator(std::move(generator))
+    , m_generator_size(size)
+    , m_generated(0)
+    , m_generator_used(false)
+{
+}
+
+size_t data_source::read_callback(char* data, size_t size, boost::system::error_code& ec)
 {
-  if (policy != compression_policy::never && !data.empty())
+  if (m_generator)
   {
-    auto compressed_data = compress(data);
-    if (!compressed_data.empty() && (policy == compression_policy::always || compressed_data.size() < data.size()))
+    m_generator_used = true;
+    const auto count = m_generator(reinterpret_cast<uint8_t*>(data), size);
+    m_generated += count;
+    if (count > size ||
+        (m_generator_size && (count == 0 ? m_generated != *m_generator_size : m_generated > *m_generator_size)))
     {
-      data.swap(compressed_data);
-      return std::make_pair(data, std::vector<std::string>{ "Content-Encoding: gzip" });
+      ec = client_error::body_size_mismatch;
+      return 0;
     }
+    return count;
   }
-  return std::make_pair(data, std::vector<std::string>{});
-}
-}  // namespace
 
-data_source::data_source(std::vector<uint8_t> data, compression_policy policy)
-    : data_source(compress_data_source(std::move(data), policy))
-{
+  const auto length = std::min(size, m_size - m_offset);
+  std::copy_n(m_data->data() + m_offset, length, reinterpret_cast<uint8_t*>(data));
+  m_offset += length;
+
+  return length;
 }
 
-size_t data_source::read_callback(char* data, size_t size)
+request_body data_source::take_buffer()
 {
-  m_data.read(data, size);
-
-  return static_cast<size_t>(m_data.gcount());
+  if (m_generator || m_offset != 0 || m_size == 0)
+  {
+    return {};
+  }
+  m_offset = m_size;
+  return m_data;
 }
 
 bool data_source::seek_callback(std::int32_t offset, std::ios_base::seekdir origin)
 {
-  m_data.clear();
-  m_data.seekg(static_cast<std::streamoff>(offset), origin);
-  return m_data.good();
+  const std::int64_t base     = origin == std::ios_base::beg ? 0 : origin == std::ios_base::cur ? m_offset : m_size;
+  const std::int64_t position = base + offset;
+  if (m_generator || position < 0 || position > static_cast<std::int64_t>(m_size))
+  {
+    return false;
+  }
+  m_offset = static_cast<std::size_t>(position);
+  return true;
 }
 }  // namespace internal
 }  // namespace asio_http
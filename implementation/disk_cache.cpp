@@ -0,0 +1,536 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#include "asio_http/internal/disk_cache.h"
+
+#include "asio_http/http_request_result.h"
+#include "asio_http/internal/response_cache.h"
+
+#include "loguru.hpp"
+
+#include <algorithm>
+#include <boost/asio/post.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <system_error>
+#include <vector>
+
+namespace asio_http
+{
+namespace internal
+{
+namespace
+{
+const std::uint32_t RECORD_MAGIC      = 0x31524841;  // "AHR1"
+const std::uint32_t REFRESH_MAGIC     = 0x31464841;  // "AHF1", records whose body is that of an earlier record
+const std::uint32_t TOMBSTONE_STATUS  = 0;           // Status code of the records erasing a key
+const std::size_t   MIN_SEGMENT_SIZE  = 1024 * 1024;
+const char* const   SEGMENT_PREFIX    = "segment-";
+const char* const   SEGMENT_EXTENSION = ".dat";
+
+// Records are laid out as: header, key, headers block ("name\0value\0" pairs) and body. Refresh records have the
+// location of the body instead of the body
+struct record_header
+{
+  std::uint32_t magic;
+  std::uint32_t status_code;
+  std::uint32_t key_size;
+  std::uint32_t headers_size;
+  std::int64_t  expiration_time_ms;
+  std::uint64_t body_size;
+};
+
+struct body_location
+{
+  std::uint64_t segment;
+  std::uint64_t offset;
+};
+
+std::uint64_t get_record_size(const record_header& header)
+{
+  return sizeof(record_header) + header.key_size + header.headers_size +
+    (header.magic == REFRESH_MAGIC ? sizeof(body_location) : header.body_size);
+}
+
+// Records read from disk may have any sizes, e.g. in a corrupt segment, so each one is checked against the space
+// left instead of adding them up, which could wrap around
+bool is_valid_record(const record_header& header, std::uint64_t available)
+{
+  if ((header.magic != RECORD_MAGIC && header.magic != REFRESH_MAGIC) || available < sizeof(header))
+  {
+    return false;
+  }
+  available -= sizeof(header);
+  if (header.key_size > available)
+  {
+    return false;
+  }
+  available -= header.key_size;
+  if (header.headers_size > available)
+  {
+    return false;
+  }
+  available -= header.headers_size;
+  return (header.magic == REFRESH_MAGIC ? sizeof(body_location) : header.body_size) <= available;
+}
+
+std::string get_segment_file_name(const std::string& path, std::uint64_t id)
+{
+  return (std::filesystem::path(path) / (SEGMENT_PREFIX + std::to_string(id) + SEGMENT_EXTENSION)).string();
+}
+
+// Other files in the directory are left alone
+std::optional<std::uint64_t> parse_segment_file_name(const std::string& name)
+{
+  const std::size_t prefix_size    = std::strlen(SEGMENT_PREFIX);
+  const std::size_t extension_size = std::strlen(SEGMENT_EXTENSION);
+  if (name.size() <= prefix_size + extension_size || name.compare(0, prefix_size, SEGMENT_PREFIX) != 0 ||
+      name.compare(name.size() - extension_size, extension_size, SEGMENT_EXTENSION) != 0)
+  {
+    return {};
+  }
+
+  const char* const first = name.data() + prefix_size;
+  const char* const last  = name.data() + name.size() - extension_size;
+  std::uint64_t     id;
+  const auto        result = std::from_chars(first, last, id);
+  if (result.ec != std::errc() || result.ptr != last)
+  {
+    return {};
+  }
+  return id;
+}
+
+std::string serialize_headers(const std::vector<std::pair<std::string, std::string>>& headers)
+{
+  std::string block;
+  for (const auto& header : headers)
+  {
+    block.append(header.first).push_back('\0');
+    block.append(header.second).push_back('\0');
+  }
+  return block;
+}
+
+std::vector<std::pair<std::string, std::string>> deserialize_headers(const char* data, std::size_t size)
+{
+  std::vector<std::pair<std::string, std::string>> headers;
+
+  const char* const end = data + size;
+  while (data < end)
+  {
+    const char* const name_end  = std::find(data, end, '\0');
+    const char* const value     = std::min(name_end + 1, end);
+    const char* const value_end = std::find(value, end, '\0');
+    headers.emplace_back(std::string(data, name_end), std::string(value, value_end));
+    data = value_end + 1;
+  }
+  return headers;
+}
+
+std::mutex                                        registry_mutex;
+std::map<std::string, std::weak_ptr<disk_cache>> registry;
+}  // namespace
+
+std::shared_ptr<disk_cache> disk_cache::open(const std::string& path, std::size_t max_size)
+{
+  std::lock_guard<std::mutex> lock(registry_mutex);
+
+  try
+  {
+    const auto normalized_path = std::filesystem::absolute(path).lexically_normal().string();
+
+    auto cache = registry[normalized_path].lock();
+    if (!cache)
+    {
+      cache                     = std::make_shared<disk_cache>(normalized_path, max_size);
+      registry[normalized_path] = cache;
+    }
+    return cache;
+  }
+  catch (const std::filesystem::filesystem_error& e)
+  {
+    LOG_F(ERROR, "Failed to open disk cache %s, running without it: %s", path.c_str(), e.what());
+    return {};
+  }
+}
+
+disk_cache::disk_cache(const std::string& path, std::size_t max_size)
+    : m_path(path)
+    , m_max_size(max_size)
+    , m_segment_size(std::max(max_size / 16, MIN_SEGMENT_SIZE))
+    , m_size(0)
+    , m_writer(1)
+{
+  std::filesystem::create_directories(m_path);
+
+  std::vector<std::uint64_t> ids;
+  for (const auto& entry : std::filesystem::directory_iterator(m_path))
+  {
+    const auto id = parse_segment_file_name(entry.path().filename().string());
+    if (id && entry.is_regular_file())
+    {
+      ids.push_back(*id);
+    }
+  }
+  std::sort(ids.begin(), ids.end());
+
+  for (const auto id : ids)
+  {
+    load_segment(id, get_segment_file_name(m_path, id));
+  }
+
+  // Never append to existing segments, they might end with a partially written record
+  const std::uint64_t active_id = ids.empty() ? 0 : ids.back() + 1;
+  m_segments[active_id]         = { get_segment_file_name(m_path, active_id), 0, nullptr };
+  m_active_segment.open(m_segments[active_id].m_file_name, std::ios::binary | std::ios::trunc);
+  if (!m_active_segment)
+  {
+    throw std::filesystem::filesystem_error(
+      "Cannot create segment", m_segments[active_id].m_file_name, std::make_error_code(std::errc::io_error));
+  }
+
+  evict_segments();
+
+  DLOG_F(INFO, "Opened disk cache %s with %zu entries", m_path.c_str(), m_index.size());
+}
+
+disk_cache::~disk_cache()
+{
+  // Pending records are written first
+  m_writer.join();
+}
+
+void disk_cache::load_segment(std::uint64_t id, const std::string& file_name)
+{
+  std::error_code ec;
+  const auto      size = std::filesystem::file_size(file_name, ec);
+  if (ec)
+  {
+    LOG_F(ERROR, "Failed to read disk cache segment %s: %s", file_name.c_str(), ec.message().c_str());
+    return;
+  }
+  if (size == 0)
+  {
+    std::filesystem::remove(file_name, ec);
+    return;
+  }
+
+  auto& segment = m_segments[id] = { file_name, size, nullptr };
+  m_size += segment.m_size;
+
+  const std::uint8_t* data;
+  try
+  {
+    data = map(segment, segment.m_size);
+  }
+  catch (const boost::interprocess::interprocess_exception& e)
+  {
+    LOG_F(ERROR, "Failed to map disk cache segment %s: %s", file_name.c_str(), e.what());
+    return;
+  }
+
+  std::uint64_t offset = 0;
+  record_header header;
+
+  while (offset + sizeof(header) <= segment.m_size)
+  {
+    std::memcpy(&header, data + offset, sizeof(header));
+    if (!is_valid_record(header, segment.m_size - offset))
+    {
+      LOG_F(WARNING, "Truncated or corrupt disk cache segment %s", file_name.c_str());
+      break;
+    }
+
+    std::string key(reinterpret_cast<const char*>(data + offset + sizeof(header)), header.key_size);
+    const auto  body_offset = offset + sizeof(header) + header.key_size + header.headers_size;
+    if (header.status_code == TOMBSTONE_STATUS)
+    {
+      m_index.erase(key);
+    }
+    else if (header.magic == REFRESH_MAGIC)
+    {
+      body_location body;
+      std::memcpy(&body, data + body_offset, sizeof(body));
+
+      // The body is gone once its segment has been evicted
+      const auto body_segment = m_segments.find(body.segment);
+      if (body_segment != m_segments.end() && body.offset <= body_segment->second.m_size &&
+          header.body_size <= body_segment->second.m_size - body.offset)
+      {
+        m_index[std::move(key)] = { id, offset, body.segment, body.offset };
+      }
+      else
+      {
+        m_index.erase(key);
+      }
+    }
+    else
+    {
+      m_index[std::move(key)] = { id, offset, id, body_offset };
+    }
+    offset += get_record_size(header);
+  }
+}
+
+const std::uint8_t* disk_cache::map(segment& segment, std::uint64_t end_offset)
+{
+  // Segments only grow, so regions mapped before are still valid for the records they cover
+  if (!segment.m_mapping || segment.m_mapping->get_size() < end_offset)
+  {
+    const boost::interprocess::file_mapping file(segment.m_file_name.c_str(), boost::interprocess::read_only);
+    segment.m_mapping =
+      std::make_shared<const boost::interprocess::mapped_region>(file, boost::interprocess::read_only, 0, end_offset);
+  }
+  return static_cast<const std::uint8_t*>(segment.m_mapping->get_address());
+}
+
+std::shared_ptr<const cached_response> disk_cache::find(const std::string& key)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  const auto pending = m_pending_writes.find(key);
+  if (pending != m_pending_writes.end())
+  {
+    return pending->second.m_response;
+  }
+
+  const auto it = m_index.find(key);
+  if (it == m_index.end())
+  {
+    return {};
+  }
+
+  auto& segment      = m_segments.at(it->second.m_segment);
+  auto& body_segment = m_segments.at(it->second.m_body_segment);
+
+  const std::uint8_t* record;
+  const std::uint8_t* body;
+  try
+  {
+    record = map(segment, segment.m_size) + it->second.m_offset;
+    body   = map(body_segment, body_segment.m_size) + it->second.m_body_offset;
+  }
+  catch (const boost::interprocess::interprocess_exception& e)
+  {
+    LOG_F(ERROR, "Failed to map disk cache segment %s: %s", segment.m_file_name.c_str(), e.what());
+    return {};
+  }
+
+  record_header header;
+  std::memcpy(&header, record, sizeof(header));
+
+  const auto* const headers_block = reinterpret_cast<const char*>(record + sizeof(header) + header.key_size);
+
+  auto response               = std::make_shared<cached_response>();
+  response->m_status_code     = header.status_code;
+  response->m_headers         = deserialize_headers(headers_block, header.headers_size);
+  response->m_body            = std::shared_ptr<const std::uint8_t>(body_segment.m_mapping, body);
+  response->m_body_size       = header.body_size;
+  response->m_expiration_time = std::chrono::system_clock::time_point(std::chrono::milliseconds(header.expiration_time_ms));
+  response->m_etag            = get_header(response->m_headers, "ETag");
+  response->m_last_modified   = get_header(response->m_headers, "Last-Modified");
+
+  return response;
+}
+
+void disk_cache::store(const std::string& key, std::shared_ptr<const cached_response> response)
+{
+  queue_write(key, std::move(response), false);
+}
+
+void disk_cache::refresh(const std::string& key, std::shared_ptr<const cached_response> response)
+{
+  queue_write(key, std::move(response), true);
+}
+
+void disk_cache::queue_write(const std::string& key, std::shared_ptr<const cached_response> response, bool refresh)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto&                       pending = m_pending_writes[key];
+    pending.m_response                  = response;
+    pending.m_writes++;
+  }
+  boost::asio::post(m_writer, [this, key, response = std::move(response), refresh]() mutable {
+    write(key, std::move(response), refresh);
+  });
+}
+
+void disk_cache::erase(const std::string& key)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_index.count(key) == 0 && m_pending_writes.count(key) == 0)
+    {
+      return;
+    }
+    auto& pending = m_pending_writes[key];
+    pending.m_response.reset();
+    pending.m_writes++;
+  }
+  boost::asio::post(m_writer, [this, key]() { write(key, nullptr, false); });
+}
+
+// On the writer, the records of a key are written in the order they were stored
+void disk_cache::write(const std::string& key, std::shared_ptr<const cached_response> response, bool refresh)
+{
+  bool                           indexed;
+  std::optional<record_location> body;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto                  it = m_index.find(key);
+    indexed                        = it != m_index.end();
+    if (refresh && indexed && has_body(it->second, *response))
+    {
+      body = it->second;
+    }
+  }
+  if (response || indexed)
+  {
+    append(key, response.get(), body ? &*body : nullptr);
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  const auto                  pending = m_pending_writes.find(key);
+  if (--pending->second.m_writes == 0)
+  {
+    m_pending_writes.erase(pending);
+  }
+}
+
+// With the lock held. The body on disk is the one the response was validated against if it has the same
+// validators and size
+bool disk_cache::has_body(const record_location& location, const cached_response& response)
+{
+  if (response.m_etag.empty() && response.m_last_modified.empty())
+  {
+    return false;
+  }
+
+  auto&               segment = m_segments.at(location.m_segment);
+  const std::uint8_t* record;
+  try
+  {
+    record = map(segment, segment.m_size) + location.m_offset;
+  }
+  catch (const boost::interprocess::interprocess_exception& e)
+  {
+    LOG_F(ERROR, "Failed to map disk cache segment %s: %s", segment.m_file_name.c_str(), e.what());
+    return false;
+  }
+
+  record_header header;
+  std::memcpy(&header, record, sizeof(header));
+  const auto headers =
+    deserialize_headers(reinterpret_cast<const char*>(record + sizeof(header) + header.key_size), header.headers_size);
+
+  return header.body_size == response.m_body_size && get_header(headers, "ETag") == response.m_etag &&
+    get_header(headers, "Last-Modified") == response.m_last_modified;
+}
+
+// The file is written without holding the lock, which is only taken to publish the record. Only the writer
+// modifies the segments, so it reads them without the lock. Given the location of the body already on disk, only
+// a refresh record is written
+void disk_cache::append(const std::string& key, const cached_response* response, const record_location* body)
+{
+  const auto headers_block = response ? serialize_headers(response->m_headers) : std::string{};
+  const auto expiration =
+    response ? std::chrono::duration_cast<std::chrono::milliseconds>(response->m_expiration_time.time_since_epoch()) :
+               std::chrono::milliseconds{};
+
+  const record_header header{ body ? REFRESH_MAGIC : RECORD_MAGIC,
+                              response ? response->m_status_code : TOMBSTONE_STATUS,
+                              static_cast<std::uint32_t>(key.size()),
+                              static_cast<std::uint32_t>(headers_block.size()),
+                              expiration.count(),
+                              response ? response->m_body_size : 0 };
+
+  // Start a new segment when the active one is full, or after a write error
+  auto active = std::prev(m_segments.end());
+  if (!m_active_segment ||
+      (active->second.m_size != 0 && active->second.m_size + get_record_size(header) > m_segment_size))
+  {
+    const auto id = active->first + 1;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      active = m_segments.emplace(id, segment{ get_segment_file_name(m_path, id), 0, nullptr }).first;
+    }
+    m_active_segment.close();
+    m_active_segment.clear();
+    m_active_segment.open(active->second.m_file_name, std::ios::binary | std::ios::trunc);
+  }
+
+  m_active_segment.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  m_active_segment.write(key.data(), key.size());
+  m_active_segment.write(headers_block.data(), headers_block.size());
+  if (body)
+  {
+    const body_location location{ body->m_body_segment, body->m_body_offset };
+    m_active_segment.write(reinterpret_cast<const char*>(&location), sizeof(location));
+  }
+  else if (response)
+  {
+    m_active_segment.write(reinterpret_cast<const char*>(response->m_body.get()), response->m_body_size);
+  }
+  m_active_segment.flush();
+
+  if (!m_active_segment)
+  {
+    LOG_F(ERROR, "Failed to write disk cache segment %s", active->second.m_file_name.c_str());
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  record_location             location{ active->first, active->second.m_size, active->first, 0 };
+  location.m_body_offset = location.m_offset + sizeof(header) + key.size() + headers_block.size();
+  if (body)
+  {
+    location.m_body_segment = body->m_body_segment;
+    location.m_body_offset  = body->m_body_offset;
+  }
+  active->second.m_size += get_record_size(header);
+  m_size += get_record_size(header);
+
+  if (response)
+  {
+    m_index[key] = location;
+  }
+  else
+  {
+    m_index.erase(key);
+  }
+
+  evict_segments();
+}
+
+void disk_cache::evict_segments()
+{
+  while (m_size > m_max_size && m_segments.size() > 1)
+  {
+    const auto oldest = m_segments.begin();
+
+    for (auto it = m_index.begin(); it != m_index.end();)
+    {
+      const bool evicted = it->second.m_segment == oldest->first || it->second.m_body_segment == oldest->first;
+      it                 = evicted ? m_index.erase(it) : std::next(it);
+    }
+
+    // Responses still using the mapped region keep it alive after the file is removed
+    std::error_code ec;
+    std::filesystem::remove(oldest->second.m_file_name, ec);
+
+    m_size -= oldest->second.m_size;
+    m_segments.erase(oldest);
+  }
+}
+}  // namespace internal
+}  // namespace asio_http
@@ -0,0 +1,390 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#include "asio_http/internal/hpack.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace asio_http
+{
+namespace internal
+{
+namespace
+{
+const std::size_t entry_overhead = 32;
+
+const std::pair<const char*, const char*> static_table[] = {
+  { ":authority", "" },
+  { ":method", "GET" },
+  { ":method", "POST" },
+  { ":path", "/" },
+  { ":path", "/index.html" },
+  { ":scheme", "http" },
+  { ":scheme", "https" },
+  { ":status", "200" },
+  { ":status", "204" },
+  { ":status", "206" },
+  { ":status", "304" },
+  { ":status", "400" },
+  { ":status", "404" },
+  { ":status", "500" },
+  { "accept-charset", "" },
+  { "accept-encoding", "gzip, deflate" },
+  { "accept-language", "" },
+  { "accept-ranges", "" },
+  { "accept", "" },
+  { "access-control-allow-origin", "" },
+  { "age", "" },
+  { "allow", "" },
+  { "authorization", "" },
+  { "cache-control", "" },
+  { "content-disposition", "" },
+  { "content-encoding", "" },
+  { "content-language", "" },
+  { "content-length", "" },
+  { "content-location", "" },
+  { "content-range", "" },
+  { "content-type", "" },
+  { "cookie", "" },
+  { "date", "" },
+  { "etag", "" },
+  { "expect", "" },
+  { "expires", "" },
+  { "from", "" },
+  { "host", "" },
+  { "if-match", "" },
+  { "if-modified-since", "" },
+  { "if-none-match", "" },
+  { "if-range", "" },
+  { "if-unmodified-since", "" },
+  { "last-modified", "" },
+  { "link", "" },
+  { "location", "" },
+  { "max-forwards", "" },
+  { "proxy-authenticate", "" },
+  { "proxy-authorization", "" },
+  { "range", "" },
+  { "referer", "" },
+  { "refresh", "" },
+  { "retry-after", "" },
+  { "server", "" },
+  { "set-cookie", "" },
+  { "strict-transport-security", "" },
+  { "transfer-encoding", "" },
+  { "user-agent", "" },
+  { "vary", "" },
+  { "via", "" },
+  { "www-authenticate", "" },
+};
+
+// Huffman code lengths of the symbols in RFC 7541, Appendix B; the last one is EOS. The code is canonical,
+// so the lengths are enough to rebuild it
+const std::uint8_t huffman_code_lengths[257] = {
+  13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+  28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+  6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+  5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+  13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+  7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+  15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+  6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+  20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+  24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+  22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+  21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+  26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+  19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+  20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+  26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+  30,
+};
+
+struct huffman_table
+{
+  huffman_table()
+      : first_code()
+      , count()
+      , offset()
+      , symbols()
+  {
+    for (std::uint16_t symbol = 0; symbol < 257; ++symbol)
+    {
+      count[huffman_code_lengths[symbol]]++;
+    }
+    std::uint32_t code  = 0;
+    std::uint16_t index = 0;
+    for (std::size_t length = 1; length < count.size(); ++length)
+    {
+      first_code[length] = code;
+      offset[length]     = index;
+      code               = (code + count[length]) << 1;
+      index += count[length];
+    }
+    auto next = offset;
+    for (std::uint16_t symbol = 0; symbol < 257; ++symbol)
+    {
+      symbols[next[huffman_code_lengths[symbol]]++] = symbol;
+    }
+  }
+
+  std::array<std::uint32_t, 31>  first_code;
+  std::array<std::uint16_t, 31>  count;
+  std::array<std::uint16_t, 31>  offset;
+  std::array<std::uint16_t, 257> symbols;
+};
+
+bool huffman_decode(const std::uint8_t* data, std::size_t size, std::string& output)
+{
+  static const huffman_table table;
+
+  std::uint32_t code   = 0;
+  std::size_t   length = 0;
+  for (std::size_t i = 0; i < size; ++i)
+  {
+    for (int bit = 7; bit >= 0; --bit)
+    {
+      code = (code << 1) | ((data[i] >> bit) & 1);
+      if (++length >= table.count.size())
+      {
+        return false;
+      }
+      if (code - table.first_code[length] < table.count[length])
+      {
+        const auto symbol = table.symbols[table.offset[length] + code - table.first_code[length]];
+        if (symbol == 256)
+        {
+          return false;
+        }
+        output.push_back(static_cast<char>(symbol));
+        code   = 0;
+        length = 0;
+      }
+    }
+  }
+
+  // Padding is the most significant bits of EOS
+  return length < 8 && code == (1u << length) - 1;
+}
+
+bool decode_integer(const std::uint8_t*& p, const std::uint8_t* end, int prefix_bits, std::uint64_t& value)
+{
+  const std::uint64_t max_prefix = (1u << prefix_bits) - 1;
+
+  value = *p++ & max_prefix;
+  if (value < max_prefix)
+  {
+    return true;
+  }
+  for (int shift = 0; p != end && shift < 56; shift += 7)
+  {
+    const auto byte = *p++;
+    value += static_cast<std::uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool decode_string(const std::uint8_t*& p, const std::uint8_t* end, std::string& value)
+{
+  if (p == end)
+  {
+    return false;
+  }
+  const bool    huffman = (*p & 0x80) != 0;
+  std::uint64_t length;
+  if (!decode_integer(p, end, 7, length) || length > static_cast<std::uint64_t>(end - p))
+  {
+    return false;
+  }
+  value.clear();
+  if (huffman && !huffman_decode(p, length, value))
+  {
+    return false;
+  }
+  if (!huffman)
+  {
+    value.assign(reinterpret_cast<const char*>(p), length);
+  }
+  p += length;
+  return true;
+}
+
+void encode_integer(std::uint8_t first_byte, int prefix_bits, std::uint64_t value, std::vector<std::uint8_t>& block)
+{
+  const std::uint64_t max_prefix = (1u << prefix_bits) - 1;
+  if (value < max_prefix)
+  {
+    block.push_back(static_cast<std::uint8_t>(first_byte | value));
+    return;
+  }
+  block.push_back(static_cast<std::uint8_t>(first_byte | max_prefix));
+  value -= max_prefix;
+  while (value >= 0x80)
+  {
+    block.push_back(static_cast<std::uint8_t>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  block.push_back(static_cast<std::uint8_t>(value));
+}
+
+void encode_string(const std::string& value, std::vector<std::uint8_t>& block)
+{
+  encode_integer(0x00, 7, value.size(), block);
+  block.insert(block.end(), value.begin(), value.end());
+}
+}  // namespace
+
+hpack_decoder::hpack_decoder(std::size_t max_table_size)
+    : m_dynamic_table()
+    , m_table_size(0)
+    , m_max_table_size(max_table_size)
+    , m_settings_table_size(max_table_size)
+{
+}
+
+bool hpack_decoder::decode(const std::uint8_t*                               data,
+                           std::size_t                                       size,
+                           std::vector<std::pair<std::string, std::string>>& headers)
+{
+  const std::uint8_t* p   = data;
+  const std::uint8_t* end = data + size;
+
+  while (p != end)
+  {
+    std::uint64_t                       index;
+    std::pair<std::string, std::string> entry;
+
+    if (*p & 0x80)
+    {
+      // Indexed header field
+      if (!decode_integer(p, end, 7, index) || !get_entry(index, entry))
+      {
+        return false;
+      }
+      headers.push_back(std::move(entry));
+    }
+    else if ((*p & 0xe0) == 0x20)
+    {
+      // Dynamic table size update
+      if (!decode_integer(p, end, 5, index) || index > m_settings_table_size)
+      {
+        return false;
+      }
+      m_max_table_size = index;
+      evict(m_max_table_size);
+    }
+    else
+    {
+      // Literal header field, with incremental indexing or not
+      const bool indexing = (*p & 0xc0) == 0x40;
+      if (!decode_integer(p, end, indexing ? 6 : 4, index))
+      {
+        return false;
+      }
+      if (index != 0 ? !get_entry(index, entry) : !decode_string(p, end, entry.first))
+      {
+        return false;
+      }
+      if (!decode_string(p, end, entry.second))
+      {
+        return false;
+      }
+      if (indexing)
+      {
+        add_entry(entry);
+      }
+      headers.push_back(std::move(entry));
+    }
+  }
+
+  return true;
+}
+
+bool hpack_decoder::get_entry(std::uint64_t index, std::pair<std::string, std::string>& entry) const
+{
+  if (index == 0)
+  {
+    return false;
+  }
+  if (index <= std::size(static_table))
+  {
+    entry = { static_table[index - 1].first, static_table[index - 1].second };
+    return true;
+  }
+  index -= std::size(static_table) + 1;
+  if (index >= m_dynamic_table.size())
+  {
+    return false;
+  }
+  entry = m_dynamic_table[index];
+  return true;
+}
+
+void hpack_decoder::add_entry(std::pair<std::string, std::string> entry)
+{
+  const std::size_t size = entry.first.size() + entry.second.size() + entry_overhead;
+
+  evict(size <= m_max_table_size ? m_max_table_size - size : 0);
+  if (size <= m_max_table_size)
+  {
+    m_table_size += size;
+    m_dynamic_table.push_front(std::move(entry));
+  }
+}
+
+void hpack_decoder::evict(std::size_t max_size)
+{
+  while (m_table_size > max_size)
+  {
+    const auto& entry = m_dynamic_table.back();
+    m_table_size -= entry.first.size() + entry.second.size() + entry_overhead;
+    m_dynamic_table.pop_back();
+  }
+}
+
+void hpack_encode(const std::vector<std::pair<std::string, std::string>>& headers, std::vector<std::uint8_t>& block)
+{
+  for (const auto& header : headers)
+  {
+    std::size_t name_index = 0;
+    std::size_t index      = 0;
+    for (std::size_t i = 0; i < std::size(static_table) && index == 0; ++i)
+    {
+      if (header.first == static_table[i].first)
+      {
+        name_index = name_index == 0 ? i + 1 : name_index;
+        index      = header.second == static_table[i].second ? i + 1 : 0;
+      }
+    }
+
+    if (index != 0)
+    {
+      encode_integer(0x80, 7, index, block);
+    }
+    else
+    {
+      // Literal header field without indexing
+      encode_integer(0x00, 4, name_index, block);
+      if (name_index == 0)
+      {
+        encode_string(header.first, block);
+      }
+      encode_string(header.second, block);
+    }
+  }
+}
+}  // namespace internal
+}  // namespace asio_http
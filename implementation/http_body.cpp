@@ -0,0 +1,117 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#include "asio_http/http_body.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace asio_http
+{
+http_body::http_body(std::vector<std::uint8_t>&& data)
+    : m_size(data.size())
+{
+  if (m_size <= inline_capacity)
+  {
+    std::memcpy(m_inline.data(), data.data(), m_size);
+  }
+  else
+  {
+    const auto buffer = std::make_shared<const std::vector<std::uint8_t>>(std::move(data));
+    m_shared          = std::shared_ptr<const std::uint8_t>(buffer, buffer->data());
+  }
+}
+
+http_body::http_body(const std::uint8_t* data, std::size_t size)
+    : m_size(0)
+{
+  if (size <= inline_capacity)
+  {
+    assign(data, size);
+  }
+  else
+  {
+    *this = http_body(std::vector<std::uint8_t>(data, data + size));
+  }
+}
+
+http_body::http_body(std::shared_ptr<const std::uint8_t> data, std::size_t size)
+    : m_size(0)
+{
+  if (size <= inline_capacity)
+  {
+    assign(data.get(), size);
+  }
+  else
+  {
+    m_size   = size;
+    m_shared = std::move(data);
+  }
+}
+
+http_body::http_body(const http_body& other)
+    : m_size(0)
+{
+  *this = other;
+}
+
+http_body::http_body(http_body&& other) noexcept
+    : m_size(0)
+{
+  *this = std::move(other);
+}
+
+http_body& http_body::operator=(const http_body& other)
+{
+  if (other.m_shared)
+  {
+    m_size   = other.m_size;
+    m_shared = other.m_shared;
+  }
+  else if (this != &other)
+  {
+    m_shared.reset();
+    assign(other.m_inline.data(), other.m_size);
+  }
+  return *this;
+}
+
+http_body& http_body::operator=(http_body&& other) noexcept
+{
+  if (other.m_shared)
+  {
+    m_size   = other.m_size;
+    m_shared = std::move(other.m_shared);
+  }
+  else if (this != &other)
+  {
+    m_shared.reset();
+    assign(other.m_inline.data(), other.m_size);
+  }
+  other.m_size = 0;
+  return *this;
+}
+
+void http_body::assign(const std::uint8_t* data, std::size_t size)
+{
+  if (size != 0)
+  {
+    std::memcpy(m_inline.data(), data, size);
+  }
+  m_size = size;
+}
+
+bool operator==(const http_body& body, const std::vector<std::uint8_t>& data)
+{
+  return std::equal(body.begin(), body.end(), data.begin(), data.end());
+}
+
+bool operator==(const std::vector<std::uint8_t>& data, const http_body& body)
+{
+  return body == data;
+}
+}  // namespace asio_http
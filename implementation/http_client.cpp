@@ -31,4 +31,9 @@ void http_client::cancel_requests(std::string cancellation_token)
 {
   m_request_manager->cancel_requests_async(std::move(cancellation_token));
 }
+
+http_client_stats http_client::get_stats() const
+{
+  return m_request_manager->get_stats();
+}
 }  // namespace asio_http
@@ -10,6 +10,7 @@
 #include "asio_http/internal/request_data.h"
 #include "asio_http/internal/request_manager.h"
 
+#include <algorithm>
 #include <vector>
 
 namespace asio_http
@@ -18,18 +19,25 @@ namespace internal
 {
 std::shared_ptr<http_request> create_redirection(const http_result_data& http_result_data)
 {
-  const std::string location = get_header(http_result_data.m_headers, "Location");
-  const auto&       request  = *http_result_data.m_request;
+  const std::string location(http_result_data.m_headers.get(http_header::location));
+  const auto&       request = *http_result_data.m_request;
 
   if (!location.empty())
   {
-    return std::make_shared<http_request>(request.get_http_method(),
-                                          url(location),
-                                          request.get_timeout_msec(),
-                                          request.get_ssl_settings(),
-                                          request.get_http_headers(),
-                                          request.get_post_data(),
-                                          request.get_compress_post_data_policy());
+    // Everything else is kept, including the per-request options. Prepared headers become headers of the
+    // request, as their Host is that of the original url
+    auto redirection   = std::make_shared<http_request>(request);
+    redirection->m_url = url(location);
+    if (const auto prepared = std::move(redirection->m_prepared_headers))
+    {
+      auto& headers = redirection->m_http_headers;
+      headers.insert(headers.begin(), prepared->m_headers.begin(), prepared->m_headers.end());
+      headers.erase(std::remove_if(headers.begin(),
+                                   headers.end(),
+                                   [](const auto& header) { return iequals(header.first, "Host"); }),
+                    headers.end());
+    }
+    return redirection;
   }
   else
   {
@@ -43,31 +51,18 @@ std::pair<bool, std::shared_ptr<http_request>> process_errors(const boost::syste
   if (ec)
   {
     if (ec == boost::asio::error::broken_pipe || ec == boost::asio::error::connection_reset ||
-        ec == HPE_INVALID_EOF_STATE || ec == boost::asio::error::eof)
+        ec == HPE_INVALID_EOF_STATE || ec == boost::asio::error::eof ||
+        ec == boost::asio::error::connection_aborted || ec == http2_error::refused_stream ||
+        ec == http2_error::http_1_1_required)
     {
       return { true, {} };
     }
   }
 
-  switch (http_result_data.m_status_code)
+  if (is_redirection(http_result_data.m_status_code))
   {
-    case 301:
-    case 302:
-    case 303:
-    case 304:
-    case 305:
-    case 306:
-    case 307:
-    case 308:
-    {
-      auto new_request = create_redirection(http_result_data);
-      return { static_cast<bool>(new_request), new_request };
-    }
-
-    default:
-    {
-      break;
-    }
+    auto new_request = create_redirection(http_result_data);
+    return { static_cast<bool>(new_request), new_request };
   }
 
   return { false, {} };
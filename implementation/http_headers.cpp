@@ -0,0 +1,201 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#include "asio_http/http_headers.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace asio_http
+{
+namespace
+{
+// Enough for the headers of most responses
+const std::size_t initial_buffer_size = 1024;
+
+const std::uint32_t fnv_offset_basis = 2166136261u;
+const std::uint32_t fnv_prime        = 16777619u;
+
+constexpr char to_lower(char c)
+{
+  return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+// FNV-1a of the lowercase name, which may be hashed in pieces
+constexpr std::uint32_t hash_name(std::string_view name, std::uint32_t hash = fnv_offset_basis)
+{
+  for (const auto c : name)
+  {
+    hash = (hash ^ static_cast<std::uint8_t>(to_lower(c))) * fnv_prime;
+  }
+  return hash;
+}
+
+bool iequals(std::string_view a, std::string_view b)
+{
+  return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](char a, char b) { return to_lower(a) == to_lower(b); });
+}
+
+struct well_known_header
+{
+  std::string_view m_name;
+  std::uint32_t    m_hash;
+};
+
+constexpr well_known_header make_header(std::string_view name)
+{
+  return { name, hash_name(name) };
+}
+
+// In the order of http_header
+constexpr std::array<well_known_header, static_cast<std::size_t>(http_header::other)> well_known_headers = {
+  make_header("age"),
+  make_header("cache-control"),
+  make_header("connection"),
+  make_header("content-encoding"),
+  make_header("content-length"),
+  make_header("content-type"),
+  make_header("date"),
+  make_header("etag"),
+  make_header("expires"),
+  make_header("keep-alive"),
+  make_header("last-modified"),
+  make_header("location"),
+  make_header("pragma"),
+  make_header("retry-after"),
+  make_header("transfer-encoding"),
+  make_header("vary")
+};
+
+http_header get_well_known_header(std::string_view name, std::uint32_t hash)
+{
+  for (std::size_t i = 0; i < well_known_headers.size(); ++i)
+  {
+    if (well_known_headers[i].m_hash == hash && iequals(well_known_headers[i].m_name, name))
+    {
+      return static_cast<http_header>(i);
+    }
+  }
+  return http_header::other;
+}
+}  // namespace
+
+http_headers::http_headers(const std::vector<std::pair<std::string, std::string>>& headers)
+{
+  for (const auto& header : headers)
+  {
+    add(header.first, header.second);
+  }
+}
+
+void http_headers::add(std::string_view name, std::string_view value)
+{
+  auto& entry        = start_entry();
+  entry.m_name_size  = name.size();
+  entry.m_value_size = value.size();
+  entry.m_hash       = hash_name(name);
+  m_buffer.append(name).append(value);
+  end_name();
+  m_parsing_value = true;
+}
+
+void http_headers::append_name(std::string_view piece)
+{
+  auto& entry = m_parsing_value || m_entries.empty() ? start_entry() : m_entries.back();
+  entry.m_name_size += piece.size();
+  entry.m_hash = hash_name(piece, entry.m_hash);
+  m_buffer.append(piece);
+  m_parsing_value = false;
+}
+
+void http_headers::append_value(std::string_view piece)
+{
+  if (!m_parsing_value && !m_entries.empty())
+  {
+    end_name();
+  }
+  auto& entry = m_entries.empty() ? start_entry() : m_entries.back();
+  entry.m_value_size += piece.size();
+  m_buffer.append(piece);
+  m_parsing_value = true;
+}
+
+http_headers::value_type http_headers::operator[](std::size_t index) const
+{
+  const auto& entry = m_entries[index];
+  const auto  name  = std::string_view(m_buffer).substr(entry.m_offset, entry.m_name_size);
+  auto        value = std::string_view(m_buffer).substr(entry.m_offset + entry.m_name_size, entry.m_value_size);
+
+  // The parser leaves the trailing whitespace of the values
+  const auto end = value.find_last_not_of("\n\r\t ");
+  value.remove_suffix(end == std::string_view::npos ? value.size() : value.size() - end - 1);
+  return { name, value };
+}
+
+std::string_view http_headers::get(std::string_view name) const
+{
+  const auto hash   = hash_name(name);
+  const auto header = get_well_known_header(name, hash);
+  if (header != http_header::other)
+  {
+    return get(header);
+  }
+
+  for (std::size_t i = 0; i < m_entries.size(); ++i)
+  {
+    if (m_entries[i].m_hash == hash)
+    {
+      const auto entry = (*this)[i];
+      if (iequals(entry.first, name))
+      {
+        return entry.second;
+      }
+    }
+  }
+  return {};
+}
+
+std::string_view http_headers::get(http_header header) const
+{
+  if (header == http_header::other)
+  {
+    return {};
+  }
+  const auto index = m_well_known[static_cast<std::size_t>(header)];
+  return index != 0 ? (*this)[index - 1].second : std::string_view{};
+}
+
+std::vector<std::pair<std::string, std::string>> http_headers::to_vector() const
+{
+  std::vector<std::pair<std::string, std::string>> headers;
+  headers.reserve(size());
+  for (const auto header : *this)
+  {
+    headers.emplace_back(header.first, header.second);
+  }
+  return headers;
+}
+
+http_headers::entry& http_headers::start_entry()
+{
+  if (m_buffer.capacity() < initial_buffer_size)
+  {
+    m_buffer.reserve(initial_buffer_size);
+  }
+  return m_entries.emplace_back(entry{ static_cast<std::uint32_t>(m_buffer.size()), 0, 0, fnv_offset_basis });
+}
+
+// Resolves the name of the last header, which is complete
+void http_headers::end_name()
+{
+  const auto count = m_entries.size();
+  const auto token = static_cast<std::size_t>(get_well_known_header((*this)[count - 1].first, m_entries.back().m_hash));
+  if (token < header_count && m_well_known[token] == 0 && count <= UINT16_MAX)
+  {
+    m_well_known[token] = static_cast<std::uint16_t>(count);
+  }
+}
+}  // namespace asio_http
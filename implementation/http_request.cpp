@@ -16,12 +16,18 @@ http_request::http_request(http_method                                      http
                            std::vector<std::uint8_t>                        post_data,
                            compression_policy                               compression_policy)
     : m_http_method(http_method)
-    , m_url(url)
+    , m_url(std::move(url))
     , m_timeout_msec(timeout_msec)
     , m_certificates(certificates)
     , m_http_headers(std::move(http_headers))
-    , m_post_data(std::move(post_data))
+    , m_prepared_headers()
+    , m_post_data(std::make_shared<const std::vector<std::uint8_t>>(std::move(post_data)))
     , m_compression_policy(compression_policy)
+    , m_compression_settings()
+    , m_body_handler()
+    , m_body_generator()
+    , m_body_size()
+    , m_auto_accept_encoding(true)
 {
 }
 }  // namespace asio_http
@@ -0,0 +1,188 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#ifndef ASIO_HTTP_COMPLETION_HANDLER_H
+#define ASIO_HTTP_COMPLETION_HANDLER_H
+
+#include "asio_http/http_request_result.h"
+
+#include <boost/asio/associated_allocator.hpp>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace asio_http
+{
+namespace internal
+{
+// Move-only, type-erased void(http_request_result) handler, called at most once. Small handlers, such as the ones
+// of futures and coroutines or lambdas capturing a few pointers, are stored inline; larger ones are allocated with
+// their associated allocator, and that memory is released before the handler is called, so it may be reused
+class completion_handler
+{
+public:
+  static constexpr std::size_t inline_capacity = 4 * sizeof(void*);
+
+  completion_handler() noexcept
+      : m_operations(nullptr)
+  {
+  }
+
+  template<typename Handler,
+           typename = std::enable_if_t<!std::is_same<std::decay_t<Handler>, completion_handler>::value>>
+  completion_handler(Handler&& handler)
+      : m_operations(&storage<std::decay_t<Handler>>::operations)
+  {
+    storage<std::decay_t<Handler>>::create(m_storage, std::forward<Handler>(handler));
+  }
+
+  completion_handler(completion_handler&& other) noexcept
+      : m_operations(std::exchange(other.m_operations, nullptr))
+  {
+    if (m_operations)
+    {
+      m_operations->move(other.m_storage, m_storage);
+    }
+  }
+
+  completion_handler& operator=(completion_handler&& other) noexcept
+  {
+    if (this != &other)
+    {
+      reset();
+      m_operations = std::exchange(other.m_operations, nullptr);
+      if (m_operations)
+      {
+        m_operations->move(other.m_storage, m_storage);
+      }
+    }
+    return *this;
+  }
+
+  completion_handler(const completion_handler&) = delete;
+  completion_handler& operator=(const completion_handler&) = delete;
+
+  ~completion_handler() { reset(); }
+
+  explicit operator bool() const { return m_operations != nullptr; }
+
+  // Leaves this empty
+  void operator()(http_request_result result)
+  {
+    std::exchange(m_operations, nullptr)->invoke(m_storage, std::move(result));
+  }
+
+private:
+  union buffer
+  {
+    void*                                   m_allocated;
+    std::aligned_storage_t<inline_capacity> m_inline;
+  };
+
+  struct operations_table
+  {
+    void (*invoke)(buffer& storage, http_request_result&& result);
+    void (*move)(buffer& from, buffer& to) noexcept;
+    void (*destroy)(buffer& storage) noexcept;
+  };
+
+  template<typename Handler>
+  static constexpr bool is_inline = sizeof(Handler) <= inline_capacity &&
+                                    alignof(Handler) <= alignof(buffer) &&
+                                    std::is_nothrow_move_constructible<Handler>::value;
+
+  template<typename Handler, bool = is_inline<Handler>>
+  struct storage
+  {
+    static Handler& get(buffer& storage) { return *std::launder(reinterpret_cast<Handler*>(&storage.m_inline)); }
+
+    template<typename H>
+    static void create(buffer& storage, H&& handler)
+    {
+      new (&storage.m_inline) Handler(std::forward<H>(handler));
+    }
+
+    static void invoke(buffer& storage, http_request_result&& result)
+    {
+      Handler handler(std::move(get(storage)));
+      get(storage).~Handler();
+      handler(std::move(result));
+    }
+
+    static void move(buffer& from, buffer& to) noexcept
+    {
+      new (&to.m_inline) Handler(std::move(get(from)));
+      get(from).~Handler();
+    }
+
+    static void destroy(buffer& storage) noexcept { get(storage).~Handler(); }
+
+    static constexpr operations_table operations{ &invoke, &move, &destroy };
+  };
+
+  template<typename Handler>
+  struct storage<Handler, false>
+  {
+    using allocator_type = typename std::allocator_traits<
+      boost::asio::associated_allocator_t<Handler>>::template rebind_alloc<Handler>;
+    using traits = std::allocator_traits<allocator_type>;
+
+    template<typename H>
+    static void create(buffer& storage, H&& handler)
+    {
+      allocator_type allocator(boost::asio::get_associated_allocator(handler));
+      auto*          pointer = traits::allocate(allocator, 1);
+      try
+      {
+        traits::construct(allocator, pointer, std::forward<H>(handler));
+      }
+      catch (...)
+      {
+        traits::deallocate(allocator, pointer, 1);
+        throw;
+      }
+      storage.m_allocated = pointer;
+    }
+
+    static void invoke(buffer& storage, http_request_result&& result)
+    {
+      auto*   pointer = static_cast<Handler*>(storage.m_allocated);
+      Handler handler(std::move(*pointer));
+      release(pointer);
+      handler(std::move(result));
+    }
+
+    static void move(buffer& from, buffer& to) noexcept { to.m_allocated = std::exchange(from.m_allocated, nullptr); }
+
+    static void destroy(buffer& storage) noexcept { release(static_cast<Handler*>(storage.m_allocated)); }
+
+    static void release(Handler* pointer) noexcept
+    {
+      allocator_type allocator(boost::asio::get_associated_allocator(*pointer));
+      traits::destroy(allocator, pointer);
+      traits::deallocate(allocator, pointer, 1);
+    }
+
+    static constexpr operations_table operations{ &invoke, &move, &destroy };
+  };
+
+  void reset() noexcept
+  {
+    if (m_operations)
+    {
+      std::exchange(m_operations, nullptr)->destroy(m_storage);
+    }
+  }
+
+  const operations_table* m_operations;  // Null when empty
+  buffer                  m_storage;
+};
+}  // namespace internal
+}  // namespace asio_http
+
+#endif
@@ -17,6 +17,7 @@ struct request_data;
 class completion_handler_invoker
 {
 public:
+  // Moves the handler out of the request, which must be completed only once
   static void invoke_handler(const request_data& request_data, http_request_result result);
 };
 }  // namespace internal
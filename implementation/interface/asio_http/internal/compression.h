@@ -7,20 +7,99 @@
 #ifndef ASIO_HTTP_COMPRESSION_H
 #define ASIO_HTTP_COMPRESSION_H
 
+#include "asio_http/http_headers.h"
+#include "asio_http/http_request.h"
+
+#include <array>
+#include <chrono>
 #include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
 #include <vector>
 
+struct ZSTD_CDict_s;
+
 namespace asio_http
 {
 namespace internal
 {
+// zstd dictionary for request bodies. It is prepared once per compression level, and may be used from any thread
+class compression_dictionary
+{
+public:
+  explicit compression_dictionary(std::vector<std::uint8_t> data);
+  compression_dictionary(const compression_dictionary&) = delete;
+  ~compression_dictionary();
+
+  // Zero if the data is not a zstd dictionary
+  std::uint32_t get_id() const { return m_id; }
+
+  // The result is empty if it would be larger than max_size
+  std::vector<std::uint8_t> compress(const std::vector<std::uint8_t>& data, int level, std::size_t max_size) const;
+
+private:
+  std::vector<std::uint8_t>            m_data;
+  std::uint32_t                        m_id;
+  mutable std::mutex                   m_mutex;
+  mutable std::array<ZSTD_CDict_s*, 9> m_prepared;  // Per level, on first use
+};
+
+// Gzip compression. The result is empty if it would be larger than max_size
+std::vector<std::uint8_t> compress(const std::vector<std::uint8_t>& data,
+                                   const compression_settings&      settings,
+                                   std::size_t                      max_size = SIZE_MAX);
+
 std::vector<std::uint8_t> compress(const std::vector<std::uint8_t>& data);
 
-std::vector<std::uint8_t> compress(const std::vector<std::uint8_t>& data, int compression_level);
+// Name and version of the library behind compress
+std::string get_compression_backend();
+
+// Estimates from a sample whether data is worth compressing, by its entropy
+bool looks_compressible(const std::vector<std::uint8_t>& data);
+
+// Compresses a request body as its policy allows, with the encoding of the settings and the dictionary, if
+// any. The result is empty when compression is skipped or does not pay off. The time spent is returned anyway
+std::vector<std::uint8_t> compress_body(const std::vector<std::uint8_t>& data,
+                                        compression_policy               policy,
+                                        const compression_settings&      settings,
+                                        const compression_dictionary*    dictionary,
+                                        std::chrono::duration<double>&   time);
+
+// Content-Encoding of the bodies compressed with the settings
+std::string get_upload_content_encoding(const compression_settings& settings);
+
+enum class compression
+{
+  none,
+  deflate,
+  gzip,
+  brotli,
+  zstd
+};
+
+// Content-Encoding of a response, none if it is missing or not supported
+compression get_content_encoding(const http_headers& headers);
+
+// Value of the Accept-Encoding header, which lists the encodings supported by this build
+const std::string& get_accept_encoding();
+
+// Incremental decompression, for bodies which are decoded as they arrive
+class decoder
+{
+public:
+  virtual ~decoder() {}
+
+  // Appends the data decompressed so far to output, which might be nothing. False if the data is corrupt
+  virtual bool decode(const std::uint8_t* data, std::size_t size, std::vector<std::uint8_t>& output) = 0;
 
-std::vector<std::uint8_t> decompress_gzip(const std::vector<std::uint8_t>& data);
+  // Once the body ended. False if the compressed data stopped short of its end, i.e. the body was truncated
+  virtual bool finish() = 0;
+};
 
-std::vector<std::uint8_t> decompress_deflate(const std::vector<std::uint8_t>& data);
+// Null if the format is not supported
+std::unique_ptr<decoder> create_decoder(compression format);
 }  // namespace internal
 }  // namespace asio_http
 
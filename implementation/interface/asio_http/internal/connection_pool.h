@@ -10,10 +10,14 @@
 #include <asio_http/internal/tuple_ptr.h>
 
 #include <boost/asio.hpp>
+#include <boost/system/error_code.hpp>
 
+#include <atomic>
 #include <map>
 #include <memory>
+#include <set>
 #include <stack>
+#include <vector>
 
 namespace asio_http
 {
@@ -34,21 +38,49 @@ using http_stack = tuple_element_ptr<http_stack_interface>;
 class connection_pool
 {
 public:
-  connection_pool(boost::asio::io_context& context)
+  // HTTP/2 is used when the maximum number of streams per connection is not zero. Response bodies of at
+  // least offload_threshold bytes are decoded on the worker executor, if any
+  connection_pool(boost::asio::io_context& context,
+                  std::uint32_t            http2_max_concurrent_streams,
+                  boost::asio::executor    worker_executor,
+                  std::size_t              offload_threshold)
       : m_context(context)
+      , m_http2_max_concurrent_streams(http2_max_concurrent_streams)
+      , m_worker_executor(std::move(worker_executor))
+      , m_offload_threshold(offload_threshold)
       , m_allocations(0)
+      , m_connections(std::make_shared<std::atomic<std::uint64_t>>(0))
   {
   }
   ~connection_pool();
-  http_stack get_connection(const url& url, const ssl_settings& ssl);
-  void       release_connection(http_stack handle, bool clean_up);
+  // A pipeline depth greater than one allows handing out a connection which is still running requests.
+  // HTTP/2 connections are shared up to the maximum number of streams instead
+  http_stack    get_connection(const url& url, const ssl_settings& ssl, std::uint32_t pipeline_depth);
+  void          release_connection(http_stack handle, const boost::system::error_code& ec);
+  std::uint64_t get_allocations() const { return m_allocations; }
+  // Connections established, including those of stacks which connect again
+  std::uint64_t get_connections() const { return *m_connections; }
 
 private:
-  http_stack create_stack(const url& url, const ssl_settings& ssl);
+  struct pipelined_connection
+  {
+    http_stack    m_handle;
+    std::uint32_t m_requests;
+    bool          m_retired;  // Failed, it only waits for its remaining requests
+  };
+
+  http_stack create_stack(const url& url, const ssl_settings& ssl, bool http2);
 
-  boost::asio::io_context&                                                m_context;
-  std::map<std::pair<std::string, std::uint16_t>, std::stack<http_stack>> m_connection_pool;
-  uint64_t                                                                m_allocations;
+  boost::asio::io_context&                                                           m_context;
+  std::map<std::pair<std::string, std::uint16_t>, std::stack<http_stack>>            m_connection_pool;
+  std::map<std::pair<std::string, std::uint16_t>, std::vector<pipelined_connection>> m_pipelined_connections;
+  // Servers which did not select HTTP/2 through ALPN
+  std::set<std::pair<std::string, std::uint16_t>>                                    m_http1_hosts;
+  const std::uint32_t                                                                m_http2_max_concurrent_streams;
+  const boost::asio::executor                                                        m_worker_executor;
+  const std::size_t                                                                  m_offload_threshold;
+  std::atomic<std::uint64_t>                                                         m_allocations;
+  const std::shared_ptr<std::atomic<std::uint64_t>>                                  m_connections;
 };
 }  // namespace internal
 }  // namespace asio_http
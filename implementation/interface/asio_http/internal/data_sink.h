@@ -7,39 +7,84 @@
 #ifndef ASIO_HTTP_DATA_SINK_H
 #define ASIO_HTTP_DATA_SINK_H
 
-#include <sstream>
+#include "asio_http/http_body.h"
+#include "asio_http/http_headers.h"
+#include "asio_http/http_request.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
 #include <vector>
 
 namespace asio_http
 {
 namespace internal
 {
-class data_sink
+// Chunks of a streamed body which its handler has not processed yet. The connection stops reading the body while
+// there are too many of them, and is resumed once the handler catches up
+class body_backlog
 {
 public:
-  data_sink()
-      : m_compression(compression::none)
+  static constexpr std::size_t max_chunks = 4;
+
+  explicit body_backlog(std::function<void()> on_drained)
+      : m_chunks(0)
+      , m_on_drained(std::move(on_drained))
   {
   }
+
+  void push() { m_chunks++; }
+  // Once the handler has returned, on its executor
+  void pop()
+  {
+    if (m_chunks-- == max_chunks)
+    {
+      m_on_drained();
+    }
+  }
+  bool is_full() const { return m_chunks >= max_chunks; }
+
+private:
+  std::atomic<std::size_t> m_chunks;
+  std::function<void()>    m_on_drained;
+};
+
+// Hands a chunk of the body to the body handler of the request, popping it from the backlog once processed
+using chunk_handler = std::function<void(std::vector<std::uint8_t> chunk, std::shared_ptr<body_backlog> backlog)>;
+
+class data_sink
+{
+public:
+  data_sink() {}
   data_sink(const data_sink&) = delete;
   data_sink(data_sink&&)      = default;
 
-  std::uint32_t             write_callback(const void* data, std::uint32_t size, std::uint32_t count);
-  std::vector<std::uint8_t> get_data() const;
+  std::uint32_t write_callback(const void* data, std::uint32_t size, std::uint32_t count);
 
-  // used to find Content-Encoding: deflate headers
-  void header_callback(const std::vector<std::pair<std::string, std::string>>&);
+  // The body is moved out of the sink
+  http_body take_data();
+
+  // used to find the Content-Length header, which sizes the buffer
+  void header_callback(const http_headers& headers);
+
+  // From now on the body is handed to the handler as it arrives instead of being stored
+  void set_chunk_handler(chunk_handler handler, std::shared_ptr<body_backlog> backlog);
+
+  // The handler is behind, the body should not be read further
+  bool is_backlogged() const { return m_backlog && m_backlog->is_full(); }
 
 private:
-  std::ostringstream m_data;
+  // Do not trust the Content-Length header beyond this when reserving memory
+  static constexpr std::size_t max_reserved_size = 64 * 1024 * 1024;
 
-  enum class compression
-  {
-    none,
-    deflate,
-    gzip
-  };
-  compression m_compression;
+  // Small bodies are received without any allocation, larger ones into a single buffer
+  std::array<std::uint8_t, http_body::inline_capacity> m_small;
+  std::size_t                                          m_small_size = 0;
+  std::vector<std::uint8_t>                            m_data;
+  chunk_handler                                        m_chunk_handler;
+  std::shared_ptr<body_backlog>                        m_backlog;
 };
 }  // namespace internal
 }  // namespace asio_http
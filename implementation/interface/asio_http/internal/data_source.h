@@ -9,8 +9,11 @@
 
 #include "asio_http/http_request.h"
 
-#include <sstream>
-#include <utility>
+#include <boost/system/error_code.hpp>
+#include <cstdint>
+#include <ios>
+#include <memory>
+#include <optional>
 #include <vector>
 
 namespace asio_http
@@ -22,27 +25,39 @@ class data_source
 public:
   data_source(const data_source&) = delete;
   data_source(data_source&&)      = default;
-  data_source(std::vector<std::uint8_t> data, compression_policy policy);
+  // The body, already encoded, is shared with the request and every retry of it. Only the offset is per source
+  explicit data_source(request_body data);
 
-  size_t read_callback(char* data, size_t size);
+  // The body is pulled from the generator as it is sent
+  data_source(body_generator generator, std::optional<std::uint64_t> size);
+
+  // Zero at the end of the body. Generators which produce fewer or more bytes than the given size fail with
+  // client_error::body_size_mismatch
+  size_t read_callback(char* data, size_t size, boost::system::error_code& ec);
+
+  // The whole body, when it is in memory and has not been read yet, so that it is written as it is. Null
+  // otherwise. It is read from then on
+  request_body take_buffer();
 
   // this is needed if the peer is using a 3XX redirect
   bool seek_callback(std::int32_t offset, std::ios_base::seekdir origin);
 
   std::size_t get_size() const { return m_size; }
 
-  std::vector<std::string> get_encoding_headers() { return m_encoding_headers; }
+  // The size of generated bodies might be unknown until they end
+  bool has_size() const { return !m_generator || m_generator_size.has_value(); }
+
+  // Generated bodies cannot be sent again once they have been read
+  bool is_replayable() const { return !m_generator || !m_generator_used; }
 
 private:
-  data_source(const std::pair<std::vector<std::uint8_t>, std::vector<std::string>>& data)
-      : m_data(std::string(data.first.begin(), data.first.end()))
-      , m_size(data.first.size())
-      , m_encoding_headers(data.second)
-  {
-  }
-  std::istringstream       m_data;
-  std::size_t              m_size;
-  std::vector<std::string> m_encoding_headers;
+  request_body                 m_data;
+  std::size_t                  m_offset;
+  std::size_t                  m_size;
+  body_generator               m_generator;
+  std::optional<std::uint64_t> m_generator_size;
+  std::uint64_t                m_generated;
+  bool                         m_generator_used;
 };
 }  // namespace internal
 }  // namespace asio_http
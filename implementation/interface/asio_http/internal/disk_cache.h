@@ -0,0 +1,105 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#ifndef ASIO_HTTP_DISK_CACHE_H
+#define ASIO_HTTP_DISK_CACHE_H
+
+#include <boost/asio/thread_pool.hpp>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace boost
+{
+namespace interprocess
+{
+class mapped_region;
+}
+}  // namespace boost
+
+namespace asio_http
+{
+namespace internal
+{
+struct cached_response;
+
+// Persistent tier of the response cache. Responses are appended to segment files, which are memory-mapped
+// to serve hits, so bodies are never loaded into heap buffers. The index is kept in memory and rebuilt on
+// start-up from the record headers. When the size limit is exceeded the oldest segment is deleted.
+// Records are written by a thread of the cache, and only indexed once written; until then, the responses being
+// stored are served from memory. Revalidated responses only get a record of their headers, which points at the
+// body already on disk. It is thread safe: all the clients of the process using the same directory share one
+// instance
+class disk_cache
+{
+public:
+  // Null if the directory cannot be used, the client then runs without a disk tier
+  static std::shared_ptr<disk_cache> open(const std::string& path, std::size_t max_size);
+
+  disk_cache(const std::string& path, std::size_t max_size);
+  disk_cache(const disk_cache&) = delete;
+  disk_cache& operator=(const disk_cache&) = delete;
+  ~disk_cache();
+
+  std::shared_ptr<const cached_response> find(const std::string& key);
+  void store(const std::string& key, std::shared_ptr<const cached_response> response);
+  // For a response revalidated with a 304 Not Modified, whose body is the one stored for the key
+  void refresh(const std::string& key, std::shared_ptr<const cached_response> response);
+  void erase(const std::string& key);
+
+private:
+  struct segment
+  {
+    std::string                                               m_file_name;
+    std::uint64_t                                             m_size;
+    std::shared_ptr<const boost::interprocess::mapped_region> m_mapping;
+  };
+
+  // The body is in an earlier record after a refresh
+  struct record_location
+  {
+    std::uint64_t m_segment;
+    std::uint64_t m_offset;
+    std::uint64_t m_body_segment;
+    std::uint64_t m_body_offset;
+  };
+
+  // Latest response stored for a key, null if erased, while its records are being written
+  struct pending_write
+  {
+    std::shared_ptr<const cached_response> m_response;
+    std::size_t                            m_writes;
+  };
+
+  void                load_segment(std::uint64_t id, const std::string& file_name);
+  void                queue_write(const std::string&                     key,
+                                  std::shared_ptr<const cached_response> response,
+                                  bool                                   refresh);
+  void                write(const std::string& key, std::shared_ptr<const cached_response> response, bool refresh);
+  void                append(const std::string& key, const cached_response* response, const record_location* body);
+  bool                has_body(const record_location& location, const cached_response& response);
+  void                evict_segments();
+  const std::uint8_t* map(segment& segment, std::uint64_t end_offset);
+
+  const std::string                                m_path;
+  const std::size_t                                m_max_size;
+  const std::size_t                                m_segment_size;
+  std::mutex                                       m_mutex;
+  std::map<std::uint64_t, segment>                 m_segments;
+  std::unordered_map<std::string, record_location> m_index;
+  std::unordered_map<std::string, pending_write>   m_pending_writes;
+  std::ofstream                                    m_active_segment;  // Used by the writer only
+  std::uint64_t                                    m_size;
+  boost::asio::thread_pool                         m_writer;
+};
+}  // namespace internal
+}  // namespace asio_http
+
+#endif
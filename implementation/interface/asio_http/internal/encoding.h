@@ -7,10 +7,20 @@
 #ifndef ASIO_HTTP_ENCODING_H
 #define ASIO_HTTP_ENCODING_H
 
+#include "asio_http/error.h"
 #include "asio_http/http_request.h"
 #include "asio_http/url.h"
+#include "asio_http/http_request_result.h"
+#include "asio_http/internal/compression.h"
+#include "asio_http/internal/http_stack_shared.h"
+#include "asio_http/internal/recycling_allocator.h"
 #include "asio_http/internal/tuple_ptr.h"
 
+#include <boost/asio.hpp>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -20,13 +30,8 @@ namespace asio_http
 {
 namespace internal
 {
-enum class compression
-{
-  none,
-  deflate,
-  gzip
-};
-
+// Decodes the response bodies as they arrive, so decompression overlaps with the transfer. Large bodies
+// may be decoded on a worker executor, one chunk after another, and handed back to the stack strand
 template<std::size_t N, typename Ls>
 class encoding : public shared_tuple_base<encoding<N, Ls>>
 {
@@ -34,29 +39,216 @@ public:
   typename Ls::template type<N - 1>* upper_layer;
   typename Ls::template type<N + 1>* lower_layer;
 
-  void write_headers(http_method method, url url, std::vector<std::pair<std::string, std::string>> headers)
+  explicit encoding(std::shared_ptr<http_stack_shared> shared_data)
+      : m_shared_data(std::move(shared_data))
+  {
+  }
+
+  void write_headers(std::uint32_t                                    id,
+                     http_method                                      method,
+                     url                                              url,
+                     std::vector<std::pair<std::string, std::string>> headers,
+                     std::shared_ptr<const prepared_headers>          prepared)
   {
-    lower_layer->write_headers(method, url, std::move(headers));
+    lower_layer->write_headers(id, method, std::move(url), std::move(headers), std::move(prepared));
   }
 
-  void on_error(const boost::system::error_code& ec) { upper_layer->on_error(ec); }
+  void on_error(const boost::system::error_code& ec)
+  {
+    m_decoders.clear();
+    upper_layer->on_error(ec);
+  }
 
-  void on_headers(unsigned int status_code, std::vector<std::pair<std::string, std::string>> headers)
+  void on_stream_error(std::uint32_t id, const boost::system::error_code& ec)
   {
-    upper_layer->on_headers(status_code, std::move(headers));
+    m_decoders.erase(id);
+    upper_layer->on_stream_error(id, ec);
   }
 
-  void on_body(const char* at, size_t length) { upper_layer->on_body(at, length); }
+  void on_headers(std::uint32_t id, unsigned int status_code, http_headers headers)
+  {
+    if (auto decoder = create_decoder(get_content_encoding(headers)))
+    {
+      auto& decoding     = m_decoders[id];
+      decoding.m_decoder = std::move(decoder);
+      decoding.m_worker.reset();
+      if (should_offload(headers))
+      {
+        decoding.m_worker.emplace(m_shared_data->worker_executor);
+      }
+    }
+    else
+    {
+      m_decoders.erase(id);
+    }
+    upper_layer->on_headers(id, status_code, std::move(headers));
+  }
 
-  void message_complete() { upper_layer->message_complete(); }
+  void on_body(std::uint32_t id, const char* at, size_t length)
+  {
+    const auto it = m_decoders.find(id);
+    if (it == m_decoders.end())
+    {
+      upper_layer->on_body(id, at, length);
+      return;
+    }
 
-  void close () {lower_layer->close();}
+    if (it->second.m_worker)
+    {
+      // The chunk is copied, as the lower layer reuses its buffer
+      const auto begin = reinterpret_cast<const std::uint8_t*>(at);
+      boost::asio::post(*it->second.m_worker,
+                        [ptr     = this->shared_from_this(),
+                         id,
+                         decoder = it->second.m_decoder,
+                         chunk   = std::vector<std::uint8_t>(begin, begin + length)]() {
+                          std::vector<std::uint8_t> decoded;
+                          const bool success = decoder->decode(chunk.data(), chunk.size(), decoded);
+                          boost::asio::post(
+                            ptr->m_shared_data->strand,
+                            make_recycling_handler([ptr, id, decoder, success, decoded = std::move(decoded)]() {
+                              ptr->on_decoded(id, decoder, success, decoded);
+                            }));
+                        });
+      return;
+    }
 
-  auto get_body_data(char* at, std::size_t length) { return upper_layer->get_body_data(at, length); }
+    // The buffer keeps its capacity between chunks
+    m_decoded.clear();
+    if (!it->second.m_decoder->decode(reinterpret_cast<const std::uint8_t*>(at), length, m_decoded))
+    {
+      on_decoding_error(id);
+      return;
+    }
+    if (!m_decoded.empty())
+    {
+      upper_layer->on_body(id, reinterpret_cast<const char*>(m_decoded.data()), m_decoded.size());
+    }
+  }
+
+  void message_complete(std::uint32_t id)
+  {
+    const auto it = m_decoders.find(id);
+    if (it == m_decoders.end())
+    {
+      upper_layer->message_complete(id);
+      return;
+    }
+
+    if (it->second.m_worker)
+    {
+      // Completion waits behind the chunks still being decoded
+      boost::asio::post(*it->second.m_worker, [ptr = this->shared_from_this(), id, decoder = it->second.m_decoder]() {
+        const bool success = decoder->finish();
+        boost::asio::post(
+          ptr->m_shared_data->strand,
+          make_recycling_handler([ptr, id, decoder, success]() { ptr->on_decoded_complete(id, decoder, success); }));
+      });
+      return;
+    }
+
+    if (!it->second.m_decoder->finish())
+    {
+      on_decoding_error(id);
+      return;
+    }
+    m_decoders.erase(it);
+    upper_layer->message_complete(id);
+  }
+
+  bool reset(std::uint32_t id)
+  {
+    m_decoders.erase(id);
+    return lower_layer->reset(id);
+  }
+
+  void close()
+  {
+    m_decoders.clear();
+    lower_layer->close();
+  }
+
+  bool is_reusable() const { return lower_layer->is_reusable(); }
+
+  auto get_body_data(std::uint32_t id, char* at, std::size_t length)
+  {
+    return upper_layer->get_body_data(id, at, length);
+  }
+
+  auto take_body_buffer(std::uint32_t id) { return upper_layer->take_body_buffer(id); }
+
+  bool is_body_backlogged(std::uint32_t id) { return upper_layer->is_body_backlogged(id); }
+
+  void resume_body(std::uint32_t id) { lower_layer->resume_body(id); }
 
 private:
+  struct decoding
+  {
+    std::shared_ptr<decoder>                                  m_decoder;
+    std::optional<boost::asio::strand<boost::asio::executor>> m_worker;  // Set when decoded off the stack strand
+  };
+
+  // Bodies of unknown size might be large as well
+  bool should_offload(const http_headers& headers) const
+  {
+    if (!m_shared_data->worker_executor)
+    {
+      return false;
+    }
+    const std::string length(headers.get(http_header::content_length));
+    return length.empty() || std::strtoull(length.c_str(), nullptr, 10) >= m_shared_data->offload_threshold;
+  }
+
+  // Results of a decoder which is no longer in use, because the response failed or was reset, are dropped
+  bool is_current(std::uint32_t id, const std::shared_ptr<decoder>& decoder) const
+  {
+    const auto it = m_decoders.find(id);
+    return it != m_decoders.end() && it->second.m_decoder == decoder;
+  }
+
+  // Only the response fails. The rest of its body, if any, is still read and dropped, so the connection can be reused
+  void on_decoding_error(std::uint32_t id) { on_stream_error(id, make_error_code(client_error::decoding_error)); }
+
+  void on_decoded(std::uint32_t                    id,
+                  const std::shared_ptr<decoder>&  decoder,
+                  bool                             success,
+                  const std::vector<std::uint8_t>& decoded)
+  {
+    if (!is_current(id, decoder))
+    {
+      return;
+    }
+    if (!success)
+    {
+      on_decoding_error(id);
+    }
+    else if (!decoded.empty())
+    {
+      upper_layer->on_body(id, reinterpret_cast<const char*>(decoded.data()), decoded.size());
+    }
+  }
+
+  void on_decoded_complete(std::uint32_t id, const std::shared_ptr<decoder>& decoder, bool success)
+  {
+    if (!is_current(id, decoder))
+    {
+      return;
+    }
+    if (!success)
+    {
+      on_decoding_error(id);
+      return;
+    }
+    m_decoders.erase(id);
+    upper_layer->message_complete(id);
+  }
+
+  std::shared_ptr<http_stack_shared> m_shared_data;
+  // Only for the responses with a supported Content-Encoding
+  std::map<std::uint32_t, decoding> m_decoders;
+  std::vector<std::uint8_t>         m_decoded;
 };
-}
-}
+}  // namespace internal
+}  // namespace asio_http
 
 #endif  // ASIO_HTTP_ENCODING_H
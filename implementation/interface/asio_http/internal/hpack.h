@@ -0,0 +1,47 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#ifndef ASIO_HTTP_HPACK_H
+#define ASIO_HTTP_HPACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace asio_http
+{
+namespace internal
+{
+// HPACK header compression (RFC 7541) for the HTTP/2 layer. One decoder per connection, as the
+// dynamic table is shared by all the header blocks received on it
+class hpack_decoder
+{
+public:
+  explicit hpack_decoder(std::size_t max_table_size = 4096);
+
+  // Decodes a complete header block, returns false if it is malformed
+  bool decode(const std::uint8_t* data, std::size_t size, std::vector<std::pair<std::string, std::string>>& headers);
+
+private:
+  bool get_entry(std::uint64_t index, std::pair<std::string, std::string>& entry) const;
+  void add_entry(std::pair<std::string, std::string> entry);
+  void evict(std::size_t max_size);
+
+  std::deque<std::pair<std::string, std::string>> m_dynamic_table;
+  std::size_t                                     m_table_size;
+  std::size_t                                     m_max_table_size;
+  std::size_t                                     m_settings_table_size;
+};
+
+// Encodes without Huffman coding nor dynamic table, so the compression state of the server never changes
+void hpack_encode(const std::vector<std::pair<std::string, std::string>>& headers, std::vector<std::uint8_t>& block);
+}  // namespace internal
+}  // namespace asio_http
+
+#endif
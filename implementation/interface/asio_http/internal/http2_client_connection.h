@@ -0,0 +1,994 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#ifndef ASIO_HTTP_HTTP2_CLIENT_CONNECTION_H
+#define ASIO_HTTP_HTTP2_CLIENT_CONNECTION_H
+
+#include "asio_http/error.h"
+#include "asio_http/http_request.h"
+#include "asio_http/internal/hpack.h"
+#include "asio_http/internal/http_client_connection.h"
+#include "asio_http/internal/http_stack_shared.h"
+#include "asio_http/internal/socket.h"
+#include "asio_http/internal/tuple_ptr.h"
+
+#include <algorithm>
+#include <atomic>
+#include <boost/asio.hpp>
+#include <cctype>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace asio_http
+{
+namespace internal
+{
+enum class http2_frame_type : std::uint8_t
+{
+  data          = 0x0,
+  headers       = 0x1,
+  priority      = 0x2,
+  rst_stream    = 0x3,
+  settings      = 0x4,
+  push_promise  = 0x5,
+  ping          = 0x6,
+  goaway        = 0x7,
+  window_update = 0x8,
+  continuation  = 0x9
+};
+
+// HTTP/2 protocol layer (RFC 7540). Each request of the upper layer is sent as a stream, and many of them are
+// multiplexed on the same connection
+template<std::size_t N, typename Ls>
+class http2_client_connection
+    : public protocol_layer
+    , public shared_tuple_base<http2_client_connection<N, Ls>>
+{
+public:
+  http2_client_connection(std::shared_ptr<http_stack_shared> shared_data);
+  ~http2_client_connection() override {}
+
+  virtual void on_connected(const boost::system::error_code& ec) override;
+  virtual void on_write(const boost::system::error_code& ec) override;
+  virtual void on_read(const std::uint8_t* data, std::size_t size, boost::system::error_code ec) override;
+  typename Ls::template type<N - 1>* upper_layer;
+  typename Ls::template type<N + 1>* lower_layer;
+
+  void write_headers(std::uint32_t                                    id,
+                     http_method                                      method,
+                     url                                              url,
+                     std::vector<std::pair<std::string, std::string>> headers,
+                     std::shared_ptr<const prepared_headers>          prepared);
+  // Resets the stream of the request, the connection remains usable for the others
+  bool reset(std::uint32_t id);
+  void close() override;
+  // False once the server sent GOAWAY or the stream identifiers ran out, until the connection is opened again.
+  // It may be called from any thread
+  bool is_reusable() const { return !m_goaway; }
+  // The body handler of the request caught up, the window updates held back for its stream are sent
+  void resume_body(std::uint32_t id);
+
+private:
+  static constexpr std::uint8_t  flag_end_stream       = 0x1;
+  static constexpr std::uint8_t  flag_ack              = 0x1;
+  static constexpr std::uint8_t  flag_end_headers      = 0x4;
+  static constexpr std::uint8_t  flag_padded           = 0x8;
+  static constexpr std::uint8_t  flag_priority         = 0x20;
+  static constexpr std::size_t   frame_header_size     = 9;
+  static constexpr std::uint32_t default_window_size   = 65535;
+  static constexpr std::uint32_t max_frame_size        = 16384;
+  static constexpr std::uint32_t local_stream_window   = 1024 * 1024;
+  static constexpr std::uint32_t local_session_window  = 16 * 1024 * 1024;
+  static constexpr std::uint32_t default_max_streams   = 100;
+  static constexpr std::int64_t  max_window_size       = 0x7fffffff;
+  static constexpr std::size_t   max_pending_body_data = 4 * max_frame_size;
+  static constexpr std::uint32_t max_stream_id         = 0x7fffffff;
+
+  struct stream_request
+  {
+    std::uint32_t                                    m_id;
+    http_method                                      m_method;
+    url                                              m_url;
+    std::vector<std::pair<std::string, std::string>> m_headers;
+  };
+
+  struct stream
+  {
+    std::uint32_t m_id;  // Identifier of the request in the upper layer
+    bool          m_sending_body;
+    bool          m_headers_received;
+    std::int64_t  m_send_window;
+    std::uint32_t m_received;  // Since the last window update
+  };
+
+  void        reset_state();
+  void        open_streams();
+  void        open_stream(stream_request request);
+  void        send_body_data();
+  void        write_frame(http2_frame_type    type,
+                          std::uint8_t        flags,
+                          std::uint32_t       stream_id,
+                          const std::uint8_t* payload,
+                          std::size_t         size);
+  void        write_window_update(std::uint32_t stream_id, std::uint32_t increment);
+  void        write_rst_stream(std::uint32_t stream_id, http2_error error);
+  void        flush();
+  void        start_reading();
+  http2_error process_frame(std::uint8_t        type,
+                            std::uint8_t        flags,
+                            std::uint32_t       stream_id,
+                            const std::uint8_t* payload,
+                            std::size_t         size);
+  http2_error process_data(std::uint8_t flags, std::uint32_t stream_id, const std::uint8_t* payload, std::size_t size);
+  http2_error
+  process_headers(std::uint8_t flags, std::uint32_t stream_id, const std::uint8_t* payload, std::size_t size);
+  http2_error process_header_block();
+  http2_error process_settings(std::uint8_t flags, const std::uint8_t* payload, std::size_t size);
+  http2_error process_goaway(const std::uint8_t* payload, std::size_t size);
+  http2_error process_window_update(std::uint32_t stream_id, const std::uint8_t* payload, std::size_t size);
+  void        close_stream(std::uint32_t stream_id, const boost::system::error_code& ec);
+  void        retire();
+  void        close_if_drained();
+
+  static std::uint32_t read_uint32(const std::uint8_t* p)
+  {
+    return (std::uint32_t(p[0]) << 24) | (std::uint32_t(p[1]) << 16) | (std::uint32_t(p[2]) << 8) | p[3];
+  }
+
+  std::shared_ptr<http_stack_shared> m_shared_data;
+
+  hpack_decoder                   m_decoder;
+  std::map<std::uint32_t, stream> m_streams;
+  std::deque<stream_request>      m_pending_streams;
+  std::vector<std::uint8_t>       m_input;
+  std::vector<std::uint8_t>       m_write_queue;
+  std::vector<std::uint8_t>       m_body_buffer;
+
+  // Header block split in HEADERS and CONTINUATION frames
+  std::vector<std::uint8_t> m_header_block;
+  std::uint32_t             m_header_block_stream;
+  bool                      m_header_block_end_stream;
+
+  std::uint32_t m_next_stream_id;
+  std::uint32_t m_max_concurrent_streams;
+  std::uint32_t m_max_frame_size;
+  std::int64_t  m_initial_window_size;
+  std::int64_t  m_send_window;
+  std::uint32_t m_received;
+
+  bool              m_connecting;
+  bool              m_connected;
+  bool              m_writing;
+  bool              m_reading;
+  std::atomic<bool> m_goaway;  // No new streams may be opened
+};
+
+template<std::size_t N, typename Ls>
+inline http2_client_connection<N, Ls>::http2_client_connection(std::shared_ptr<http_stack_shared> shared_data)
+    : m_shared_data(shared_data)
+    , m_header_block_stream(0)
+    , m_header_block_end_stream(false)
+    , m_next_stream_id(1)
+    , m_max_concurrent_streams(default_max_streams)
+    , m_max_frame_size(max_frame_size)
+    , m_initial_window_size(default_window_size)
+    , m_send_window(default_window_size)
+    , m_received(0)
+    , m_connecting(false)
+    , m_connected(false)
+    , m_writing(false)
+    , m_reading(false)
+    , m_goaway(false)
+{
+}
+
+template<std::size_t N, typename Ls>
+inline void http2_client_connection<N, Ls>::write_headers(std::uint32_t                                    id,
+                                                          http_method                                      method,
+                                                          url                                              url,
+                                                          std::vector<std::pair<std::string, std::string>> headers,
+                                                          std::shared_ptr<const prepared_headers>          prepared)
+{
+  if (m_goaway && m_connected)
+  {
+    // The connection is draining its last streams, it may be sent again on another connection
+    upper_layer->on_stream_error(id, make_error_code(http2_error::refused_stream));
+    return;
+  }
+
+  // HPACK encodes every header, prepared or not
+  if (prepared)
+  {
+    headers.insert(headers.begin(), prepared->m_headers.begin(), prepared->m_headers.end());
+  }
+  m_pending_streams.push_back({ id, method, std::move(url), std::move(headers) });
+
+  if (m_connected)
+  {
+    open_streams();
+    start_reading();
+  }
+  else if (!m_connecting)
+  {
+    reset_state();
+    m_connecting = true;
+    lower_layer->connect(m_pending_streams.front().m_url.host,
+                         std::to_string(m_pending_streams.front().m_url.port));
+  }
+}
+
+template<std::size_t N, typename Ls>
+inline bool http2_client_connection<N, Ls>::reset(std::uint32_t id)
+{
+  m_pending_streams.erase(
+    std::remove_if(m_pending_streams.begin(),
+                   m_pending_streams.end(),
+                   [id](const stream_request& request) { return request.m_id == id; }),
+    m_pending_streams.end());
+
+  const auto it = std::find_if(
+    m_streams.begin(), m_streams.end(), [id](const auto& stream) { return stream.second.m_id == id; });
+  if (it != m_streams.end())
+  {
+    write_rst_stream(it->first, http2_error::cancel);
+    m_streams.erase(it);
+    open_streams();
+  }
+  return true;
+}
+
+template<std::size_t N, typename Ls>
+inline void http2_client_connection<N, Ls>::resume_body(std::uint32_t id)
+{
+  const auto it = std::find_if(
+    m_streams.begin(), m_streams.end(), [id](const auto& stream) { return stream.second.m_id == id; });
+  if (it != m_streams.end() && it->second.m_received >= local_stream_window / 2)
+  {
+    write_window_update(it->first, it->second.m_received);
+    it->second.m_received = 0;
+    flush();
+  }
+}
+
+template<std::size_t N, typename Ls>
+inline void http2_client_connection<N, Ls>::close()
+{
+  m_streams.clear();
+  m_pending_streams.clear();
+  m_input.clear();
+  m_write_queue.clear();
+  m_connecting = false;
+  m_connected  = false;
+  lower_layer->close();
+}
+
+template<std::size_t N, typename Ls>
+inline void http2_client_connection<N, Ls>::reset_state()
+{
+  m_decoder = hpack_decoder();
+  m_input.clear();
+  m_header_block_stream    = 0;
+  m_next_stream_id         = 1;
+  m_max_concurrent_streams = default_max_streams;
+  m_max_frame_size         = max_frame_size;
+  m_initial_window_size    = default_window_size;
+  m_send_window            = default_window_size;
+  m_received               = 0;
+  m_goaway                 = false;
+}
+
+template<std::size_t N, typename Ls>
+inline void http2_client_connection<N, Ls>::on_connected(const boost::system::error_code& ec)
+{
+  m_connecting = false;
+  if (m_pending_streams.empty())
+  {
+    // Closed while connecting
+    return;
+  }
+  if (ec)
+  {
+    upper_layer->on_error(ec);
+    return;
+  }
+
+  // Cleartext connections use prior knowledge, otherwise h2 must have been selected through ALPN
+  const auto protocol = lower_layer->get_application_protocol();
+  if (!protocol.empty() && protocol != "h2")
+  {
+    upper_layer->on_error(make_error_code(http2_error::http_1_1_required));
+    return;
+  }
+  m_connected = true;
+
+  static const std::string preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+  m_write_queue.insert(m_write_queue.end(), preface.begin(), preface.end());
+
+  // Disable server push, and enlarge the flow control windows
+  const std::uint8_t settings[] = {
+    0x0, 0x2, 0x0, 0x0, 0x0, 0x0,  // SETTINGS_ENABLE_PUSH
+    0x0, 0x4, 0x0, 0x10, 0x0, 0x0  // SETTINGS_INITIAL_WINDOW_SIZE, local_stream_window
+  };
+  write_frame(http2_frame_type::settings, 0, 0, settings, sizeof(settings));
+  write_window_update(0, local_session_window - default_window_size);
+
+  open_streams();
+  start_reading();
+}
+
+template<std::size_t N, typename Ls>
+inline void http2_client_connection<N, Ls>::open_streams()
+{
+  while (!m_pending_streams.empty() && m_streams.size() < m_max_concurrent_streams)
+  {
+    if (m_next_stream_id > max_stream_id)
+    {
+      retire();
+      break;
+    }
+    auto request = std::move(m_pending_streams.front());
+    m_pending_streams.pop_front();
+    open_stream(std::move(request));
+  }
+  send_body_data();
+  flush();
+  close_if_drained();
+}
+
+template<std::size_t N, typename Ls>
+inline void http2_client_connection<N, Ls>::open_stream(stream_request request)
+{
+  const auto stream_id = m_next_stream_id;
+  m_next_stream_id += 2;
+
+  const auto& url   = request.m_url;
+  const bool  https = url.protocol == "https";
+
+  std::vector<std::pair<std::string, std::string>> headers{
+    { ":method", std::string(http_method_to_string(request.m_method)) },
+    { ":scheme", https ? "https" : "http" },
+    { ":authority", url.get_authority() },
+    { ":path", (url.path.empty() ? "/" : url.path) + url.query }
+  };
+
+  bool has_body = false;
+  for (auto& header : request.m_headers)
+  {
+    std::transform(header.first.begin(), header.first.end(), header.first.begin(), [](unsigned char c) {
+      return static_cast<char>(std::tolower(c));
+    });
+
+    // A body of unknown size is sent in DATA frames until it ends
+    if (header.first == "transfer-encoding")
+    {
+      has_body = true;
+    }
+    // Connection specific headers are not allowed, and the authority replaces Host
+    if (header.first == "host" || header.first == "connection" || header.first == "keep-alive" ||
+        header.first == "proxy-connection" || header.first == "transfer-encoding" || header.first == "upgrade")
+    {
+      continue;
+    }
+    if (header.first == "content-length")
+    {
+      has_body = header.second != "0";
+    }
+    headers.push_back(std::move(header));
+  }
+
+  std::vector<std::uint8_t> block;
+  hpack_encode(headers, block);
+
+  // Header blocks larger than a frame continue in CONTINUATION frames
+  std::size_t offset = 0;
+  do
+  {
+    const auto   size  = std::min<std::size_t>(block.size() - offset, m_max_frame_size);
+    const bool   last  = offset + size == block.size();
+    std::uint8_t flags = last ? flag_end_headers : 0;
+    if (offset == 0 && !has_body)
+    {
+      flags |= flag_end_stream;
+    }
+    write_frame(offset == 0 ? http2_frame_type::headers : http2_frame_type::continuation,
+                flags,
+                stream_id,
+                block.data() + offset,
+                size);
+    offset += size;
+  } while (offset != block.size());
+
+  m_streams.emplace(stream_id, stream{ request.m_id, has_body, false, m_initial_window_size, 0 });
+}
+
+template<std::size_t N, typename Ls>
+inline void http2_client_connection<N, Ls>::send_body_data()
+{
+  for (auto& [stream_id, stream] : m_streams)
+  {
+    while (stream.m_sending_body && m_send_window > 0 && stream.m_send_window > 0 &&
+           m_write_queue.size() < max_pending_body_data)
+    {
+      const auto size = static_cast<std::size_t>(
+        std::min<std::int64_t>({ m_send_window, stream.m_send_window, std::int64_t(m_max_frame_size) }));
+      m_body_buffer.resize(size);
+
+      const auto count = upper_layer->get_body_data(stream.m_id, reinterpret_cast<char*>(m_body_buffer.data()), size);
+      if (!count)
+      {
+        // The body failed, the stream is reset without ending it
+        stream.m_sending_body = false;
+      }
+      else if (*count == 0)
+      {
+        write_frame(http2_frame_type::data, flag_end_stream, stream_id, nullptr, 0);
+        stream.m_sending_body = false;
+      }
+      else
+      {
+        write_frame(http2_frame_type::data, 0, stream_id, m_body_buffer.data(), *count);
+        m_send_window -= *count;
+        stream.m_send_window -= *count;
+      }
+    }
+  }
+}
+
+template<std::size_t N, typename Ls>
+inline void http2_client_connection<N, Ls>::write_frame(http2_frame_type    type,
+                                                        std::uint8_t        flags,
+                                                        std::uint32_t       stream_id,
+                                                        const std::uint8_t* payload,
+                                                        std::size_t         size)
+{
+  const std::uint8_t header[frame_header_size] = { std::uint8_t(size >> 16),      std::uint8_t(size >> 8),
+                                                   std::uint8_t(size),            static_cast<std::uint8_t>(type),
+                                                   flags,                         std::uint8_t(stream_id >> 24),
+                                                   std::uint8_t(stream_id >> 16), std::uint8_t(stream_id >> 8),
+                                                   std::uint8_t(stream_id) };
+  m_write_queue.insert(m_write_queue.end(), header, header + frame_header_size);
+  if (size != 0)
+  {
+    m_write_queue.insert(m_write_queue.end(), payload, payload + size);
+  }
+}
+
+template<std::size_t N, typename Ls>
+inline void http2_client_connection<N, Ls>::write_window_update(std::uint32_t stream_id, std::uint32_t increment)
+{
+  const std::uint8_t payload[] = { std::uint8_t(increment >> 24),
+                                   std::uint8_t(increment >> 16),
+                                   std::uint8_t(increment >> 8),
+                                   std::uint8_t(increment) };
+  write_frame(http2_frame_type::window_update, 0, stream_id, payload, sizeof(payload));
+}
+
+template<std::size_t N, typename Ls>
+inline void http2_client_connection<N, Ls>::write_rst_stream(std::uint32_t stream_id, http2_error error)
+{
+  const auto         code      = static_cast<std::uint32_t>(error);
+  const std::uint8_t payload[] = {
+    std::uint8_t(code >> 24), std::uint8_t(code >> 16), std::uint8_t(code >> 8), std::uint8_t(code)
+  };
+  write_frame(http2_frame_type::rst_stream, 0, stream_id, payload, sizeof(payload));
+  flush();
+}
+
+template<std::size_t N, typename Ls>
+inline void http2_client_connection<N, Ls>::flush()
+{
+  if (m_connected && !m_writing && !m_write_queue.empty())
+  {
+    m_writing     = true;
+    m_write_queue = lower_layer->write(std::move(m_write_queue));
+  }
+}
+
+// Idle connections are read as well, so the PING and GOAWAY frames of the server are processed as they arrive
+template<std::size_t N, typename Ls>
+inline void http2_client_connection<N, Ls>::start_reading()
+{
+  if (m_connected && !m_reading)
+  {
+    m_reading = true;
+    lower_layer->read();
+  }
+}
+
+template<std::size_t N, typename Ls>
+inline void http2_client_connection<N, Ls>::on_write(const boost::system::error_code& ec)
+{
+  m_writing = false;
+  if (!m_connected)
+  {
+    return;
+  }
+  if (ec == boost::asio::error::operation_aborted)
+  {
+    // Started before the connection was closed and opened again
+    flush();
+    return;
+  }
+  if (ec)
+  {
+    upper_layer->on_error(ec);
+    return;
+  }
+  send_body_data();
+  flush();
+}
+
+template<std::size_t N, typename Ls>
+inline void
+http2_client_connection<N, Ls>::on_read(const std::uint8_t* data, std::size_t size, boost::system::error_code ec)
+{
+  m_reading = false;
+  if (!m_connected)
+  {
+    return;
+  }
+  if (ec == boost::asio::error::operation_aborted)
+  {
+    // Started before the connection was closed and opened again
+    start_reading();
+    return;
+  }
+
+  m_input.insert(m_input.end(), data, data + size);
+
+  std::size_t offset = 0;
+  while (m_connected && m_input.size() >= offset + frame_header_size)
+  {
+    const std::uint8_t* header = m_input.data() + offset;
+    const std::size_t   length = (std::size_t(header[0]) << 16) | (std::size_t(header[1]) << 8) | header[2];
+    if (length > max_frame_size)
+    {
+      upper_layer->on_error(make_error_code(http2_error::frame_size_error));
+      return;
+    }
+    if (m_input.size() < offset + frame_header_size + length)
+    {
+      break;
+    }
+    offset += frame_header_size + length;
+
+    const auto error = process_frame(
+      header[3], header[4], read_uint32(header + 5) & 0x7fffffff, header + frame_header_size, length);
+    if (error != http2_error::no_error)
+    {
+      upper_layer->on_error(make_error_code(error));
+      return;
+    }
+  }
+
+  // Closed by the upper layer
+  if (!m_connected)
+  {
+    return;
+  }
+
+  m_input.erase(m_input.begin(), m_input.begin() + offset);
+  flush();
+
+  if (ec)
+  {
+    if (!m_streams.empty() || !m_pending_streams.empty())
+    {
+      upper_layer->on_error(ec);
+    }
+    else
+    {
+      // Closed by the server while idle, the next request opens it again
+      close();
+    }
+    return;
+  }
+  start_reading();
+}
+
+template<std::size_t N, typename Ls>
+inline http2_error http2_client_connection<N, Ls>::process_frame(std::uint8_t        type,
+                                                                std::uint8_t        flags,
+                                                                std::uint32_t       stream_id,
+                                                                const std::uint8_t* payload,
+                                                                std::size_t         size)
+{
+  const auto frame_type = static_cast<http2_frame_type>(type);
+
+  // Nothing may be interleaved with a header block
+  if (m_header_block_stream != 0 && frame_type != http2_frame_type::continuation)
+  {
+    return http2_error::protocol_error;
+  }
+
+  switch (frame_type)
+  {
+    case http2_frame_type::data:
+      return process_data(flags, stream_id, payload, size);
+
+    case http2_frame_type::headers:
+      return process_headers(flags, stream_id, payload, size);
+
+    case http2_frame_type::continuation:
+      if (stream_id == 0 || stream_id != m_header_block_stream)
+      {
+        return http2_error::protocol_error;
+      }
+      m_header_block.insert(m_header_block.end(), payload, payload + size);
+      return (flags & flag_end_headers) ? process_header_block() : http2_error::no_error;
+
+    case http2_frame_type::rst_stream:
+    {
+      if (size != 4)
+      {
+        return http2_error::frame_size_error;
+      }
+      const auto error = static_cast<http2_error>(read_uint32(payload));
+      close_stream(stream_id,
+                   make_error_code(error == http2_error::no_error ? http2_error::stream_closed : error));
+      return http2_error::no_error;
+    }
+
+    case http2_frame_type::settings:
+      return stream_id == 0 ? process_settings(flags, payload, size) : http2_error::protocol_error;
+
+    case http2_frame_type::push_promise:
+      // Disabled through SETTINGS_ENABLE_PUSH
+      return http2_error::protocol_error;
+
+    case http2_frame_type::ping:
+      if (stream_id != 0 || size != 8)
+      {
+        return http2_error::frame_size_error;
+      }
+      if ((flags & flag_ack) == 0)
+      {
+        write_frame(http2_frame_type::ping, flag_ack, 0, payload, size);
+      }
+      return http2_error::no_error;
+
+    case http2_frame_type::goaway:
+      return process_goaway(payload, size);
+
+    case http2_frame_type::window_update:
+      return process_window_update(stream_id, payload, size);
+
+    default:
+      // PRIORITY and unknown frames are ignored
+      return http2_error::no_error;
+  }
+}
+
+template<std::size_t N, typename Ls>
+inline http2_error http2_client_connection<N, Ls>::process_data(std::uint8_t        flags,
+                                                               std::uint32_t       stream_id,
+                                                               const std::uint8_t* payload,
+                                                               std::size_t         size)
+{
+  if (stream_id == 0)
+  {
+    return http2_error::protocol_error;
+  }
+
+  // Flow control accounts for the whole frame payload, padding included
+  const auto frame_size = static_cast<std::uint32_t>(size);
+  if (flags & flag_padded)
+  {
+    if (size == 0 || payload[0] >= size)
+    {
+      return http2_error::protocol_error;
+    }
+    size -= payload[0] + 1;
+    payload++;
+  }
+
+  m_received += frame_size;
+  if (m_received >= local_session_window / 2)
+  {
+    write_window_update(0, m_received);
+    m_received = 0;
+  }
+
+  // Frames of reset streams are discarded
+  const auto it = m_streams.find(stream_id);
+  if (it == m_streams.end())
+  {
+    return http2_error::no_error;
+  }
+
+  upper_layer->on_body(it->second.m_id, reinterpret_cast<const char*>(payload), size);
+
+  if (flags & flag_end_stream)
+  {
+    close_stream(stream_id, {});
+  }
+  else
+  {
+    // The stream stalls, without blocking the others, while its body handler is behind
+    it->second.m_received += frame_size;
+    if (it->second.m_received >= local_stream_window / 2 && !upper_layer->is_body_backlogged(it->second.m_id))
+    {
+      write_window_update(stream_id, it->second.m_received);
+      it->second.m_received = 0;
+    }
+  }
+  return http2_error::no_error;
+}
+
+template<std::size_t N, typename Ls>
+inline http2_error http2_client_connection<N, Ls>::process_headers(std::uint8_t        flags,
+                                                                  std::uint32_t       stream_id,
+                                                                  const std::uint8_t* payload,
+                                                                  std::size_t         size)
+{
+  if (stream_id == 0)
+  {
+    return http2_error::protocol_error;
+  }
+
+  std::size_t padding = 0;
+  if (flags & flag_padded)
+  {
+    if (size == 0)
+    {
+      return http2_error::protocol_error;
+    }
+    padding = payload[0];
+    payload++;
+    size--;
+  }
+  if (flags & flag_priority)
+  {
+    if (size < 5)
+    {
+      return http2_error::protocol_error;
+    }
+    payload += 5;
+    size -= 5;
+  }
+  if (padding > size)
+  {
+    return http2_error::protocol_error;
+  }
+
+  m_header_block.assign(payload, payload + size - padding);
+  m_header_block_stream     = stream_id;
+  m_header_block_end_stream = (flags & flag_end_stream) != 0;
+
+  return (flags & flag_end_headers) ? process_header_block() : http2_error::no_error;
+}
+
+template<std::size_t N, typename Ls>
+inline http2_error http2_client_connection<N, Ls>::process_header_block()
+{
+  const auto stream_id = m_header_block_stream;
+  m_header_block_stream = 0;
+
+  // Blocks of reset streams are decoded too, to keep the compression state in sync with the server
+  std::vector<std::pair<std::string, std::string>> headers;
+  if (!m_decoder.decode(m_header_block.data(), m_header_block.size(), headers))
+  {
+    return http2_error::compression_error;
+  }
+
+  const auto it = m_streams.find(stream_id);
+  if (it == m_streams.end())
+  {
+    return http2_error::no_error;
+  }
+
+  // Trailers are ignored
+  if (!it->second.m_headers_received)
+  {
+    const auto status = std::find_if(headers.begin(), headers.end(), [](const auto& h) { return h.first == ":status"; });
+    if (status == headers.end() || status->second.size() != 3 ||
+        !std::all_of(status->second.begin(), status->second.end(), [](unsigned char c) { return std::isdigit(c); }))
+    {
+      return http2_error::protocol_error;
+    }
+    const auto status_code = static_cast<unsigned int>(std::stoul(status->second));
+
+    // Informational responses are followed by the final one
+    if (status_code < 200)
+    {
+      return m_header_block_end_stream ? http2_error::protocol_error : http2_error::no_error;
+    }
+
+    http_headers response_headers;
+    for (const auto& header : headers)
+    {
+      if (header.first[0] != ':')
+      {
+        response_headers.add(header.first, header.second);
+      }
+    }
+    it->second.m_headers_received = true;
+    upper_layer->on_headers(it->second.m_id, status_code, std::move(response_headers));
+  }
+
+  if (m_header_block_end_stream)
+  {
+    close_stream(stream_id, {});
+  }
+  return http2_error::no_error;
+}
+
+template<std::size_t N, typename Ls>
+inline http2_error
+http2_client_connection<N, Ls>::process_settings(std::uint8_t flags, const std::uint8_t* payload, std::size_t size)
+{
+  if (flags & flag_ack)
+  {
+    return size == 0 ? http2_error::no_error : http2_error::frame_size_error;
+  }
+  if (size % 6 != 0)
+  {
+    return http2_error::frame_size_error;
+  }
+
+  for (std::size_t i = 0; i < size; i += 6)
+  {
+    const std::uint16_t identifier = (std::uint16_t(payload[i]) << 8) | payload[i + 1];
+    const std::uint32_t value      = read_uint32(payload + i + 2);
+    switch (identifier)
+    {
+      case 0x3:
+        m_max_concurrent_streams = value;
+        break;
+
+      case 0x4:
+      {
+        if (value > max_window_size)
+        {
+          return http2_error::flow_control_error;
+        }
+        // The change applies to the windows of all the open streams, none of which may grow too large
+        const std::int64_t delta = std::int64_t(value) - m_initial_window_size;
+        for (auto& stream : m_streams)
+        {
+          stream.second.m_send_window += delta;
+          if (stream.second.m_send_window > max_window_size)
+          {
+            return http2_error::flow_control_error;
+          }
+        }
+        m_initial_window_size = value;
+        break;
+      }
+
+      case 0x5:
+        if (value < max_frame_size || value > 0xffffff)
+        {
+          return http2_error::protocol_error;
+        }
+        m_max_frame_size = value;
+        break;
+
+      default:
+        // The header table size is not relevant, as the dynamic table is not used to encode
+        break;
+    }
+  }
+
+  write_frame(http2_frame_type::settings, flag_ack, 0, nullptr, 0);
+  open_streams();
+  return http2_error::no_error;
+}
+
+template<std::size_t N, typename Ls>
+inline http2_error http2_client_connection<N, Ls>::process_goaway(const std::uint8_t* payload, std::size_t size)
+{
+  if (size < 8)
+  {
+    return http2_error::frame_size_error;
+  }
+
+  // Streams after the last one processed by the server may be sent again on another connection, the others
+  // are completed before the connection is closed
+  retire();
+  const auto last_stream_id = read_uint32(payload) & 0x7fffffff;
+  while (!m_streams.empty() && m_streams.rbegin()->first > last_stream_id)
+  {
+    close_stream(m_streams.rbegin()->first, make_error_code(http2_error::refused_stream));
+  }
+  close_if_drained();
+  return http2_error::no_error;
+}
+
+template<std::size_t N, typename Ls>
+inline http2_error http2_client_connection<N, Ls>::process_window_update(std::uint32_t       stream_id,
+                                                                        const std::uint8_t* payload,
+                                                                        std::size_t         size)
+{
+  if (size != 4)
+  {
+    return http2_error::frame_size_error;
+  }
+  const auto increment = read_uint32(payload) & 0x7fffffff;
+  if (increment == 0)
+  {
+    return http2_error::protocol_error;
+  }
+
+  if (stream_id == 0)
+  {
+    m_send_window += increment;
+    if (m_send_window > max_window_size)
+    {
+      return http2_error::flow_control_error;
+    }
+  }
+  else
+  {
+    const auto it = m_streams.find(stream_id);
+    if (it != m_streams.end())
+    {
+      it->second.m_send_window += increment;
+    }
+  }
+  send_body_data();
+  return http2_error::no_error;
+}
+
+template<std::size_t N, typename Ls>
+inline void http2_client_connection<N, Ls>::close_stream(std::uint32_t stream_id, const boost::system::error_code& ec)
+{
+  const auto it = m_streams.find(stream_id);
+  if (it == m_streams.end())
+  {
+    return;
+  }
+
+  // The response is complete before the request body, there is no need to send the rest
+  if (!ec && it->second.m_sending_body)
+  {
+    write_rst_stream(stream_id, http2_error::no_error);
+  }
+
+  const auto id = it->second.m_id;
+  m_streams.erase(it);
+  if (ec)
+  {
+    upper_layer->on_stream_error(id, ec);
+  }
+  else
+  {
+    upper_layer->message_complete(id);
+  }
+  open_streams();
+}
+
+// No new streams may be opened on the connection. The requests not sent yet are refused, so that they are sent
+// again on another connection
+template<std::size_t N, typename Ls>
+inline void http2_client_connection<N, Ls>::retire()
+{
+  m_goaway             = true;
+  auto pending_streams = std::move(m_pending_streams);
+  m_pending_streams.clear();
+  for (const auto& request : pending_streams)
+  {
+    upper_layer->on_stream_error(request.m_id, make_error_code(http2_error::refused_stream));
+  }
+}
+
+template<std::size_t N, typename Ls>
+inline void http2_client_connection<N, Ls>::close_if_drained()
+{
+  if (m_goaway && m_connected && m_streams.empty() && m_pending_streams.empty())
+  {
+    close();
+  }
+}
+}  // namespace internal
+}  // namespace asio_http
+
+#endif
@@ -8,6 +8,7 @@
 #define ASIO_HTTP_CLIENT_CONNECTION_H
 
 #include "asio_http/error.h"
+#include "asio_http/http_headers.h"
 #include "asio_http/http_request.h"
 #include "asio_http/http_request_result.h"
 #include "asio_http/internal/connection_pool.h"
@@ -18,11 +19,14 @@
 #include "http_parser.h"
 
 #include <algorithm>
+#include <atomic>
 #include <boost/asio.hpp>
+#include <charconv>
+#include <deque>
 #include <memory>
 #include <set>
-#include <sstream>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <utility>
 #include <vector>
@@ -31,64 +35,87 @@ namespace asio_http
 {
 namespace internal
 {
-enum class connection_state
+inline std::string_view http_method_to_string(http_method method)
 {
-  in_progress,
-  writing_body,
-  done
-};
-inline std::string http_method_to_string(http_method method)
-{
-  static const std::map<http_method, std::string> map{ { http_method::GET, "GET" },
-                                                       { http_method::HEAD, "HEAD" },
-                                                       { http_method::PUT, "PUT" },
-                                                       { http_method::POST, "POST" } };
-
-  return map.at(method);
+  switch (method)
+  {
+    case http_method::GET:
+      return "GET";
+    case http_method::HEAD:
+      return "HEAD";
+    case http_method::PUT:
+      return "PUT";
+    case http_method::POST:
+      return "POST";
+  }
+  return {};
 }
 
 struct request_buffers
 {
-  request_buffers(http_method method_, std::vector<std::pair<std::string, std::string>> request_headers_, url url)
-      : method(method_)
+  request_buffers(std::uint32_t                                    id,
+                  http_method                                      method_,
+                  std::vector<std::pair<std::string, std::string>> request_headers_,
+                  std::shared_ptr<const prepared_headers>          prepared,
+                  url                                              url)
+      : m_id(id)
+      , method(method_)
       , request_headers(std::move(request_headers_))
+      , m_prepared_headers(std::move(prepared))
       , m_url(std::move(url))
-      , m_state(connection_state::in_progress)
+      , m_chunked(std::any_of(request_headers.begin(), request_headers.end(), [](const auto& header) {
+        return iequals(header.first, "Transfer-Encoding") && iequals(header.second, "chunked");
+      }))
+      , m_body_sent(false)
   {
   }
   request_buffers()        = default;
   request_buffers& operator=(request_buffers&&) = default;
 
+  std::uint32_t                                    m_id;
   http_method                                      method;
   std::vector<std::pair<std::string, std::string>> request_headers;
-  std::vector<std::pair<std::string, std::string>> headers;
+  std::shared_ptr<const prepared_headers>          m_prepared_headers;
+  http_headers                                     headers;
   url                                              m_url;
-  std::pair<std::string, std::string>              m_current_header;
-  connection_state                                 m_state;
+  bool                                             m_chunked;
+  bool                                             m_body_sent;
 
-  void push_current_header()
+  // Appends the request line and the headers to buffer, which grows once at most. The query keeps its '?', and
+  // prepared headers are copied as they are
+  void serialize_request_headers(std::vector<std::uint8_t>& buffer) const
   {
-    // Trim trailing whitespaces
-    m_current_header.second.erase(m_current_header.second.find_last_not_of("\n\r\t ") + 1);
-    headers.push_back(std::move(m_current_header));
-    m_current_header.first.clear();
-    m_current_header.second.clear();
-  }
-
-  std::vector<std::uint8_t> print_request_headers()
-  {
-    std::stringstream request_headers_string;
-    request_headers_string << http_method_to_string(method) << " " << m_url.path << " HTTP/1.1\r\n";
+    const std::string_view method_name = http_method_to_string(method);
+    const std::string_view path        = m_url.path.empty() ? std::string_view("/") : std::string_view(m_url.path);
+    const std::string_view version     = " HTTP/1.1\r\n";
+    const std::string_view prepared    = m_prepared_headers ? std::string_view(m_prepared_headers->m_serialized) : "";
 
+    std::size_t size =
+      method_name.size() + 1 + path.size() + m_url.query.size() + version.size() + prepared.size() + 2;
     for (const auto& header : request_headers)
     {
-      request_headers_string << header.first << ": " << header.second << "\r\n";
+      size += header.first.size() + 2 + header.second.size() + 2;
     }
-    request_headers_string << "\r\n";
 
-    const std::string headers = request_headers_string.str();
-
-    return std::vector<std::uint8_t>(headers.begin(), headers.end());
+    const auto offset = buffer.size();
+    buffer.resize(offset + size);
+    auto out    = reinterpret_cast<char*>(buffer.data() + offset);
+    auto append = [&out](std::string_view piece) { out = std::copy(piece.begin(), piece.end(), out); };
+
+    append(method_name);
+    append(" ");
+    append(path);
+    append(m_url.query);
+    append(version);
+    append(prepared);
+    for (const auto& header : request_headers)
+    {
+      append(header.first);
+      append(": ");
+      append(header.second);
+      append("\r\n");
+    }
+    append("\r\n");
   }
 };
 
@@ -107,32 +134,56 @@ public:
   typename Ls::template type<N - 1>*    upper_layer;
   typename Ls::template type<N + 1>*    lower_layer;
 
-  void write_headers(http_method method, url url, std::vector<std::pair<std::string, std::string>> headers);
-  void close() override { lower_layer->close(); }
+  void write_headers(std::uint32_t                                    id,
+                     http_method                                      method,
+                     url                                              url,
+                     std::vector<std::pair<std::string, std::string>> headers,
+                     std::shared_ptr<const prepared_headers>          prepared);
+  // Responses arrive in order, so the connection must be closed to abandon a request
+  bool reset(std::uint32_t id);
+  void close() override;
+  // False once the server closes the connection, or asks to, so no more requests are queued behind it
+  bool is_reusable() const { return !m_not_reusable; }
+  // The body handler caught up, reading goes on
+  void resume_body(std::uint32_t) { start_reading(); }
 
 private:
-  void       write_headers_read();
-  void       write_handler(const boost::system::error_code& error, std::size_t bytes_transferred);
-  void       write_body_handler(const boost::system::error_code& error, std::size_t bytes_transferred);
-  void       read_handler(const boost::system::error_code& error, std::size_t bytes_transferred);
-  static int on_header_field(http_parser* parser, const char* at, size_t length);
-  static int on_header_value(http_parser* parser, const char* at, size_t length);
-  static int on_body(http_parser* parser, const char* at, size_t length);
-  static int on_message_complete(http_parser* parser);
-  static int on_headers_complete(http_parser* parser);
-  static int on_status(http_parser* parser, const char* at, size_t length);
-  void       write_body();
-  void       send_headers();
+  static int                on_message_begin(http_parser* parser);
+  static int                on_header_field(http_parser* parser, const char* at, size_t length);
+  static int                on_header_value(http_parser* parser, const char* at, size_t length);
+  static int                on_body(http_parser* parser, const char* at, size_t length);
+  static int                on_message_complete(http_parser* parser);
+  static int                on_headers_complete(http_parser* parser);
+  static int                on_status(http_parser* parser, const char* at, size_t length);
+  void                      send_headers();
+  void                      start_reading();
+  bool                      get_body_data(request_buffers& request);
+
+  // Bytes of the body pulled at a time
+  static constexpr std::size_t body_piece_size = 1024;
+  // Longest chunk size line, the size in hex followed by CRLF
+  static constexpr std::size_t size_line_length = 2 * sizeof(std::size_t) + 2;
 
   std::shared_ptr<http_stack_shared>                           m_shared_data;
   boost::asio::strand<boost::asio::io_context::executor_type>& m_strand;
 
-  http_parser_settings                  m_settings;
-  http_parser                           m_parser;
-
-  request_buffers m_current_request;
-
-  bool m_not_reusable;
+  http_parser_settings m_settings;
+  http_parser          m_parser;
+
+  // Requests written to the connection, in order. Responses are parsed for the first one, the others are
+  // pipelined requests waiting for their response
+  std::deque<request_buffers> m_requests;
+  // Serialized requests waiting to be written. Its storage is swapped with that of the transport on every write,
+  // so it is reused from one request to the next
+  std::vector<std::uint8_t> m_write_queue;
+  // The next piece of the body, reused in the same way
+  std::vector<std::uint8_t> m_body_buffer;
+
+  bool m_connecting;
+  bool m_writing;
+  bool m_reading;
+  // Read by the connection pool, outside the strand
+  std::atomic<bool> m_not_reusable;
 };
 
 template<std::size_t N, typename Ls>
@@ -141,10 +192,14 @@ inline http_client_connection<N, Ls>::http_client_connection(std::shared_ptr<htt
     , m_strand(shared_data->strand)
     , m_settings()
     , m_parser()
+    , m_connecting(false)
+    , m_writing(false)
+    , m_reading(false)
     , m_not_reusable(false)
 {
   http_parser_init(&m_parser, HTTP_RESPONSE);
   m_parser.data                  = this;
+  m_settings.on_message_begin    = &http_client_connection::on_message_begin;
   m_settings.on_body             = &http_client_connection::on_body;
   m_settings.on_message_complete = &http_client_connection::on_message_complete;
   m_settings.on_status           = &http_client_connection::on_status;
@@ -154,33 +209,86 @@ inline http_client_connection<N, Ls>::http_client_connection(std::shared_ptr<htt
 }
 
 template<std::size_t N, typename Ls>
-inline void http_client_connection<N, Ls>::write_headers(http_method                              method,
-                                                 url                                              url,
-                                                 std::vector<std::pair<std::string, std::string>> headers)
+inline void http_client_connection<N, Ls>::write_headers(std::uint32_t                                    id,
+                                                         http_method                                      method,
+                                                         url                                              url,
+                                                         std::vector<std::pair<std::string, std::string>> headers,
+                                                         std::shared_ptr<const prepared_headers>          prepared)
 {
-  m_current_request         = request_buffers(method, std::move(headers), std::move(url));
-  m_current_request.m_state = connection_state::in_progress;
+  m_requests.emplace_back(id, method, std::move(headers), std::move(prepared), std::move(url));
+  m_requests.back().serialize_request_headers(m_write_queue);
 
-  if (lower_layer->is_open())
+  if (m_connecting)
+  {
+    // Headers are sent once connected
+  }
+  else if (lower_layer->is_open())
   {
     send_headers();
   }
   else
   {
-    lower_layer->connect(m_current_request.m_url.host, std::to_string(m_current_request.m_url.port));
+    m_connecting = true;
+    http_parser_init(&m_parser, HTTP_RESPONSE);
+    lower_layer->connect(m_requests.front().m_url.host, std::to_string(m_requests.front().m_url.port));
   }
 }
 
 template<std::size_t N, typename Ls>
 inline void http_client_connection<N, Ls>::send_headers()
 {
-  lower_layer->write(m_current_request.print_request_headers());
+  // Pipelined requests are written back to back, but never in the middle of a previous request. The last one
+  // may have a body, which is written along with the headers unless it has to be sent in chunks
+  if (!m_writing && !m_write_queue.empty())
+  {
+    auto&        request = m_requests.back();
+    request_body body;
+    if (!request.m_chunked && !request.m_body_sent)
+    {
+      body                = upper_layer->take_body_buffer(request.m_id);
+      request.m_body_sent = body != nullptr;
+    }
+    m_writing     = true;
+    m_write_queue = lower_layer->write(std::move(m_write_queue), std::move(body));
+  }
+}
+
+template<std::size_t N, typename Ls>
+inline void http_client_connection<N, Ls>::start_reading()
+{
+  // Suspended while the body handler of the response is behind
+  if (!m_reading && !m_requests.empty() && !upper_layer->is_body_backlogged(m_requests.front().m_id))
+  {
+    m_reading = true;
+    lower_layer->read();
+  }
+}
+
+template<std::size_t N, typename Ls>
+inline bool http_client_connection<N, Ls>::reset(std::uint32_t)
+{
+  close();
+  return false;
+}
+
+template<std::size_t N, typename Ls>
+inline void http_client_connection<N, Ls>::close()
+{
+  m_requests.clear();
+  m_write_queue.clear();
+  m_connecting = false;
+  lower_layer->close();
 }
 
 template<std::size_t N, typename Ls>
 inline void http_client_connection<N, Ls>::on_connected(const boost::system::error_code& ec)
 {
-  if (!ec)
+  m_connecting = false;
+  if (m_requests.empty())
+  {
+    // Closed while connecting
+  }
+  else if (!ec)
   {
     send_headers();
   }
@@ -189,54 +297,114 @@ inline void http_client_connection<N, Ls>::on_connected(const boost::system::err
     upper_layer->on_error(ec);
   }
 }
+
 template<std::size_t N, typename Ls>
 inline void http_client_connection<N, Ls>::on_write(const boost::system::error_code& ec)
 {
+  m_writing = false;
+  if (m_requests.empty())
+  {
+    return;
+  }
   if (ec)
   {
     upper_layer->on_error(ec);
+    return;
   }
-  std::vector<std::uint8_t> buf(1024);
-  auto                      count = upper_layer->get_body_data(reinterpret_cast<char*>(buf.data()), buf.size());
-  if (count == 0)
+  if (!get_body_data(m_requests.back()))
   {
-    lower_layer->read();
+    // The body failed, the connection is closed once this returns
+    return;
+  }
+  if (m_body_buffer.empty())
+  {
+    send_headers();
+    start_reading();
   }
   else
   {
-    buf.resize(count);
-    lower_layer->write(buf);
+    m_writing     = true;
+    m_body_buffer = lower_layer->write(std::move(m_body_buffer));
   }
 }
 
+// Fills m_body_buffer with the next piece of the body, which is empty once it has been sent. False if the
+// body failed
+template<std::size_t N, typename Ls>
+inline bool http_client_connection<N, Ls>::get_body_data(request_buffers& request)
+{
+  m_body_buffer.clear();
+  if (request.m_body_sent)
+  {
+    return true;
+  }
+
+  // Chunks are read after room for their size line, and followed by CRLF
+  const std::size_t offset = request.m_chunked ? size_line_length : 0;
+  m_body_buffer.resize(offset + body_piece_size + 2);
+  const auto count =
+    upper_layer->get_body_data(request.m_id, reinterpret_cast<char*>(m_body_buffer.data() + offset), body_piece_size);
+  if (!count)
+  {
+    m_body_buffer.clear();
+    return false;
+  }
+  request.m_body_sent = *count == 0;
+  if (!request.m_chunked)
+  {
+    m_body_buffer.resize(*count);
+    return true;
+  }
+
+  // Every chunk is preceded by its size, and the body ends with an empty chunk
+  char       digits[size_line_length - 2];
+  const auto digits_end = std::to_chars(std::begin(digits), std::end(digits), *count, 16).ptr;
+  const auto line_start = offset - (digits_end - digits) - 2;
+  std::copy(digits, digits_end, m_body_buffer.begin() + line_start);
+  m_body_buffer[offset - 2]          = '\r';
+  m_body_buffer[offset - 1]          = '\n';
+  m_body_buffer[offset + *count]     = '\r';
+  m_body_buffer[offset + *count + 1] = '\n';
+  m_body_buffer.resize(offset + *count + 2);
+  m_body_buffer.erase(m_body_buffer.begin(), m_body_buffer.begin() + line_start);
+  return true;
+}
+
 template<std::size_t N, typename Ls>
 inline void
 http_client_connection<N, Ls>::on_read(const std::uint8_t* data, std::size_t size, boost::system::error_code ec)
 {
+  m_reading = false;
   if (ec)
   {
     m_not_reusable = true;
   }
 
-  std::size_t nsize;
+  // Closed, or cancelled, while reading
+  if (m_requests.empty())
+  {
+    return;
+  }
+
+  std::size_t nsize = size;
 
   // If there is available data, try to parse response, and ignore errors
-  if (size != 0 && m_current_request.m_state != connection_state::done)
+  if (size != 0)
   {
     const char* d = reinterpret_cast<const char*>(data);
     nsize         = http_parser_execute(&m_parser, &m_settings, d, size);
   }
 
-  // connection_state may have changed after call to http_parser_execute
-  if (m_current_request.m_state != connection_state::done)
+  // m_requests may have changed after call to http_parser_execute
+  if (!m_requests.empty())
   {
-    if (nsize != size && size != 0)
+    if (nsize != size)
     {
       upper_layer->on_error(HTTP_PARSER_ERRNO(&m_parser));
     }
     else if (!ec)
     {
-      lower_layer->read();
+      start_reading();
     }
     else
     {
@@ -245,11 +413,19 @@ http_client_connection<N, Ls>::on_read(const std::uint8_t* data, std::size_t siz
   }
 }
 
+template<std::size_t N, typename Ls>
+inline int http_client_connection<N, Ls>::on_message_begin(http_parser* parser)
+{
+  // A response nobody asked for is a protocol error
+  http_client_connection* obj = static_cast<http_client_connection*>(parser->data);
+  return obj->m_requests.empty() ? 1 : 0;
+}
+
 template<std::size_t N, typename Ls>
 inline int http_client_connection<N, Ls>::on_body(http_parser* parser, const char* at, size_t length)
 {
   http_client_connection* obj = static_cast<http_client_connection*>(parser->data);
-  obj->upper_layer->on_body(at, length);
+  obj->upper_layer->on_body(obj->m_requests.front().m_id, at, length);
   return 0;
 }
 
@@ -261,8 +437,9 @@ inline int http_client_connection<N, Ls>::on_message_complete(http_parser* parse
   {
     obj->m_not_reusable = true;
   }
-  obj->m_current_request.m_state = connection_state::done;
-  obj->upper_layer->message_complete();
+  const auto id = obj->m_requests.front().m_id;
+  obj->m_requests.pop_front();
+  obj->upper_layer->message_complete(id);
 
   return 0;
 }
@@ -270,15 +447,12 @@ inline int http_client_connection<N, Ls>::on_message_complete(http_parser* parse
 template<std::size_t N, typename Ls>
 inline int http_client_connection<N, Ls>::on_headers_complete(http_parser* parser)
 {
-  http_client_connection* obj = static_cast<http_client_connection*>(parser->data);
-  if (!obj->m_current_request.m_current_header.first.empty())
-  {
-    obj->m_current_request.push_current_header();
-  }
+  http_client_connection* obj     = static_cast<http_client_connection*>(parser->data);
+  auto&                   current = obj->m_requests.front();
 
-  obj->upper_layer->on_headers(parser->status_code, obj->m_current_request.headers);
+  obj->upper_layer->on_headers(current.m_id, parser->status_code, std::move(current.headers));
 
-  if (obj->m_current_request.method == http_method::HEAD)
+  if (current.method == http_method::HEAD)
   {
     return 1;
   }
@@ -293,26 +467,16 @@ inline int http_client_connection<N, Ls>::on_status(http_parser*, const char*, s
 template<std::size_t N, typename Ls>
 inline int http_client_connection<N, Ls>::on_header_field(http_parser* parser, const char* at, size_t length)
 {
-  http_client_connection* obj     = static_cast<http_client_connection*>(parser->data);
-  auto&                   current = obj->m_current_request.m_current_header;
-  if (!current.second.empty())
-  {
-    obj->m_current_request.push_current_header();
-  }
-  current.first.append(at, length);
+  http_client_connection* obj = static_cast<http_client_connection*>(parser->data);
+  obj->m_requests.front().headers.append_name({ at, length });
   return 0;
 }
 
 template<std::size_t N, typename Ls>
 inline int http_client_connection<N, Ls>::on_header_value(http_parser* parser, const char* at, size_t length)
 {
-  http_client_connection* obj     = static_cast<http_client_connection*>(parser->data);
-  auto&                   current = obj->m_current_request.m_current_header;
-  current.second.append(at, length);
-  if (current.second.empty())
-  {
-    obj->m_current_request.push_current_header();
-  }
+  http_client_connection* obj = static_cast<http_client_connection*>(parser->data);
+  obj->m_requests.front().headers.append_value({ at, length });
   return 0;
 }
 }  // namespace internal
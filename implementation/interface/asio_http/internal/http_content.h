@@ -4,18 +4,24 @@
 #include "asio_http/error.h"
 #include "asio_http/http_request.h"
 #include "asio_http/http_request_result.h"
+#include "asio_http/internal/compression.h"
 #include "asio_http/internal/connection_pool.h"
 #include "asio_http/internal/data_sink.h"
 #include "asio_http/internal/data_source.h"
 #include "asio_http/internal/http_client_connection.h"
 #include "asio_http/internal/http_stack_shared.h"
+#include "asio_http/internal/recycling_allocator.h"
 #include "asio_http/internal/socket.h"
 #include "asio_http/internal/tuple_ptr.h"
 
 #include "http_parser.h"
 
+#include <algorithm>
+#include <atomic>
 #include <boost/asio.hpp>
+#include <deque>
 #include <memory>
+#include <optional>
 #include <set>
 #include <sstream>
 #include <string>
@@ -29,46 +35,94 @@ namespace internal
 {
 struct http_result_data
 {
-  std::shared_ptr<const http_request>              m_request;
-  std::vector<std::pair<std::string, std::string>> m_headers;
-  unsigned int                                     m_status_code;
-  std::vector<uint8_t>                             data;
+  std::shared_ptr<const http_request> m_request;
+  http_headers                        m_headers;
+  unsigned int                        m_status_code;
+  http_body                           data;
+  // False once part of a body was streamed or generated, as the exchange cannot be repeated
+  bool                                m_retryable = true;
 };
 
+// Redirections are followed, so their body is never handed to a body handler
+inline bool is_redirection(unsigned int status_code)
+{
+  switch (status_code)
+  {
+    case 301:
+    case 302:
+    case 303:
+    case 305:
+    case 306:
+    case 307:
+    case 308:
+      return true;
+    default:
+      return false;
+  }
+}
+
 struct http_stack_interface
 {
   virtual void start_async(std::shared_ptr<const http_request>                                request,
+                           chunk_handler                                                      body_handler,
                            std::function<void(http_result_data&&, boost::system::error_code)> callback) = 0;
 
-  virtual void cancel_async() = 0;
+  virtual void cancel_async(std::shared_ptr<const http_request> request) = 0;
 
   virtual std::pair<std::string, std::uint16_t> get_host_and_port() const = 0;
 
+  virtual bool is_reusable() const = 0;
+
+  // Closes the connection unless it has requests in progress
+  virtual void close_idle_async() = 0;
+
   virtual ~http_stack_interface() {}
 };
 
+// A request and its response; a connection has several of them when requests are pipelined or multiplexed
+struct http_exchange
+{
+  http_exchange(boost::asio::io_context& context, std::uint32_t id)
+      : m_id(id)
+      , m_timer(context)
+  {
+  }
+
+  std::uint32_t                                                      m_id;
+  std::shared_ptr<const http_request>                                m_request;
+  chunk_handler                                                      m_body_handler;
+  std::function<void(http_result_data&&, boost::system::error_code)> m_completed_request_callback;
+  boost::asio::deadline_timer                                        m_timer;
+  http_result_data                                                   m_result;
+  std::unique_ptr<data_sink>                                         m_body_sink;
+  std::unique_ptr<data_source>                                       m_body_source;
+};
+
 template<std::size_t N, typename Ls>
 class http_content
     : public http_stack_interface
     , public shared_tuple_base<http_content<N, Ls>>
 {
 public:
-  std::shared_ptr<const http_request>                                m_request;
-  std::function<void(http_result_data&&, boost::system::error_code)> m_completed_request_callback;
-  std::shared_ptr<http_stack_shared>                                 m_shared_data;
-  boost::asio::deadline_timer                                        m_timer;
-  http_result_data                                                   m_result;
+  std::shared_ptr<http_stack_shared> m_shared_data;
+  boost::asio::io_context&           m_context;
 
-  typename Ls::template type<N + 1>* lower_layer;
+  // In the same order the requests were written
+  std::deque<http_exchange> m_exchanges;
+  std::uint32_t             m_next_exchange_id;
+
+  // Set once the connection has been closed with requests in flight, it must not be used again
+  std::atomic<bool> m_aborted;
 
-  std::unique_ptr<data_sink>   m_body_sink;
-  std::unique_ptr<data_source> m_body_source;
+  typename Ls::template type<N + 1>* lower_layer;
 
   boost::asio::strand<boost::asio::io_context::executor_type>& m_strand;
 
   http_content(std::shared_ptr<http_stack_shared> shared_data, boost::asio::io_context& context, std::pair<std::string, std::uint16_t> host)
       : m_shared_data(shared_data)
-      , m_timer(context)
+      , m_context(context)
+      , m_next_exchange_id(0)
+      , m_aborted(false)
       , m_strand(shared_data->strand)
       , m_host(host)
   {
@@ -76,76 +130,246 @@ public:
 
   std::pair<std::string, std::uint16_t> get_host_and_port() const override { return m_host; }
 
+  bool is_reusable() const override { return !m_aborted && lower_layer->is_reusable(); }
+
   void start(std::shared_ptr<const http_request>                                request,
+             chunk_handler                                                      body_handler,
              std::function<void(http_result_data&&, boost::system::error_code)> callback)
   {
-    m_request = request;
-    m_body_sink.reset();
-    m_body_source.reset(new data_source(request->get_post_data(), request->get_compress_post_data_policy()));
-    m_body_sink.reset(new data_sink());
+    if (m_aborted)
+    {
+      // Dispatched to this connection while it was being closed, it can be retried on another one
+      http_result_data result;
+      result.m_request = std::move(request);
+      callback(std::move(result), boost::asio::error::connection_aborted);
+      return;
+    }
+
+    auto& exchange = m_exchanges.emplace_back(m_context, m_next_exchange_id++);
+
+    exchange.m_request      = request;
+    exchange.m_body_handler = std::move(body_handler);
+    if (request->get_body_generator())
+    {
+      exchange.m_body_source.reset(new data_source(request->get_body_generator(), request->get_body_size()));
+    }
+    else
+    {
+      exchange.m_body_source.reset(new data_source(request->get_post_data_buffer()));
+    }
+    exchange.m_body_sink.reset(new data_sink());
 
-    m_completed_request_callback = std::move(callback);
+    exchange.m_completed_request_callback = std::move(callback);
 
-    m_timer.expires_from_now(boost::posix_time::millisec(request->get_timeout_msec()));
-    m_timer.async_wait([ptr = this->shared_from_this()](auto&& ec) {
+    exchange.m_timer.expires_from_now(boost::posix_time::millisec(request->get_timeout_msec()));
+    exchange.m_timer.async_wait(make_recycling_handler([ptr = this->shared_from_this(), request](auto&& ec) {
       if (!ec)
       {
-        ptr->complete_request(boost::asio::error::timed_out);
+        ptr->abort(request, boost::asio::error::timed_out);
       }
-    });
+    }));
 
-    auto headers = request->get_http_headers();
-    headers.emplace_back("Host", m_request->get_url().host);
-    if (m_body_source->get_size() != 0)
+    // Host and the headers of prepared requests are already serialized
+    const auto& prepared = request->get_prepared_headers();
+    auto        headers  = request->get_http_headers();
+    if (!prepared)
+    {
+      headers.emplace_back("Host", request->get_url().get_authority());
+    }
+    if (request->get_auto_accept_encoding() && get_header(headers, "Accept-Encoding").empty() &&
+        (!prepared || get_header(prepared->m_headers, "Accept-Encoding").empty()))
+    {
+      headers.emplace_back("Accept-Encoding", get_accept_encoding());
+    }
+    if (!exchange.m_body_source->has_size())
+    {
+      headers.emplace_back("Transfer-Encoding", "chunked");
+    }
+    else if (exchange.m_body_source->get_size() != 0)
     {
-      headers.emplace_back("Content-Length", std::to_string(m_body_source->get_size()));
+      headers.emplace_back("Content-Length", std::to_string(exchange.m_body_source->get_size()));
     }
 
-    lower_layer->write_headers(request->get_http_method(), request->get_url(), std::move(headers));
+    lower_layer->write_headers(
+      exchange.m_id, request->get_http_method(), request->get_url(), std::move(headers), prepared);
   }
 
-  void complete_request(const boost::system::error_code& ec)
+  void complete_request(http_exchange& exchange, const boost::system::error_code& ec)
   {
-    if (m_completed_request_callback != nullptr)
+    exchange.m_timer.cancel();
+    if (!exchange.m_body_source->is_replayable())
     {
-      m_timer.cancel();
-      m_result.data      = m_body_sink->get_data();
-      m_result.m_request = m_request;
-      m_completed_request_callback(std::move(m_result), ec);
-      m_result = {};  // After cancellation or timeout it may happen request still running
+      exchange.m_result.m_retryable = false;
+    }
+    exchange.m_result.data      = exchange.m_body_sink->take_data();
+    exchange.m_result.m_request = exchange.m_request;
+    exchange.m_completed_request_callback(std::move(exchange.m_result), ec);
+  }
+
+  // Completes the given request with an error. Multiplexed connections just reset its stream, otherwise the
+  // connection is closed and the requests pipelined with it are sent again on another connection
+  void abort(const std::shared_ptr<const http_request>& request, const boost::system::error_code& ec)
+  {
+    auto it = std::find_if(
+      m_exchanges.begin(), m_exchanges.end(), [&request](const auto& exchange) { return exchange.m_request == request; });
+    if (it == m_exchanges.end())
+    {
+      return;
+    }
+
+    if (lower_layer->reset(it->m_id))
+    {
+      complete_request(*it, ec);
+      m_exchanges.erase(it);
+    }
+    else
+    {
+      abort_all(it, ec);
+    }
+  }
+
+  void abort_all(std::deque<http_exchange>::iterator failed, const boost::system::error_code& ec)
+  {
+    m_aborted = true;
 
-      m_completed_request_callback = nullptr;
+    auto exchanges = std::move(m_exchanges);
+    m_exchanges.clear();
+    for (auto& exchange : exchanges)
+    {
+      complete_request(exchange, &exchange == &*failed ? ec : boost::asio::error::connection_aborted);
     }
+
+    lower_layer->close();
+  }
+
+  std::deque<http_exchange>::iterator find_exchange(std::uint32_t id)
+  {
+    return std::find_if(
+      m_exchanges.begin(), m_exchanges.end(), [id](const auto& exchange) { return exchange.m_id == id; });
   }
 
   void start_async(std::shared_ptr<const http_request>                                request,
+                   chunk_handler                                                      body_handler,
                    std::function<void(http_result_data&&, boost::system::error_code)> callback) override
   {
-    async<&http_content::start>(std::move(request), std::move(callback));
+    async<&http_content::start>(std::move(request), std::move(body_handler), std::move(callback));
   }
 
-  auto get_body_data(char* at, std::size_t length) { return m_body_source->read_callback(at, length); }
+  // Empty if the body failed. The exchange is then aborted, once the lower layer is done with it
+  std::optional<std::size_t> get_body_data(std::uint32_t id, char* at, std::size_t length)
+  {
+    const auto it = find_exchange(id);
+    if (it == m_exchanges.end())
+    {
+      return 0;
+    }
 
-  void on_error(const boost::system::error_code& ec) { complete_request(ec); }
+    boost::system::error_code ec;
+    const auto                count = it->m_body_source->read_callback(at, length, ec);
+    if (ec)
+    {
+      async<&http_content::abort>(it->m_request, ec);
+      return {};
+    }
+    return count;
+  }
 
-  void on_headers(unsigned int status_code, std::vector<std::pair<std::string, std::string>> headers)
+  request_body take_body_buffer(std::uint32_t id)
   {
-    m_result.m_status_code = status_code;
-    m_result.m_headers     = std::move(headers);
+    const auto it = find_exchange(id);
+    return it != m_exchanges.end() ? it->m_body_source->take_buffer() : request_body{};
+  }
 
-    m_body_sink->header_callback(m_result.m_headers);
+  // The connection failed, the first request gets the error
+  void on_error(const boost::system::error_code& ec)
+  {
+    if (!m_exchanges.empty())
+    {
+      abort_all(m_exchanges.begin(), ec);
+    }
   }
 
-  void on_body(const char* at, size_t length) { m_body_sink->write_callback(at, length, 1); }
+  // Only this request failed, the connection is still usable
+  void on_stream_error(std::uint32_t id, const boost::system::error_code& ec)
+  {
+    const auto it = find_exchange(id);
+    if (it != m_exchanges.end())
+    {
+      complete_request(*it, ec);
+      m_exchanges.erase(it);
+    }
+  }
 
-  void message_complete() { complete_request({}); }
+  // Frames of requests which already completed, e.g. timed out, are discarded
+  void on_headers(std::uint32_t id, unsigned int status_code, http_headers headers)
+  {
+    const auto it = find_exchange(id);
+    if (it == m_exchanges.end())
+    {
+      return;
+    }
+    auto& exchange = *it;
 
-  void cancel()
+    exchange.m_result.m_status_code = status_code;
+    exchange.m_result.m_headers     = std::move(headers);
+
+    exchange.m_body_sink->header_callback(exchange.m_result.m_headers);
+    if (exchange.m_body_handler && !is_redirection(status_code))
+    {
+      auto backlog = std::make_shared<body_backlog>(
+        [ptr = this->shared_from_this(), id]() { ptr->template async<&http_content::resume_body>(id); });
+      exchange.m_body_sink->set_chunk_handler(exchange.m_body_handler, std::move(backlog));
+      exchange.m_result.m_retryable = false;
+    }
+  }
+
+  void on_body(std::uint32_t id, const char* at, size_t length)
   {
-    complete_request(make_error_code(boost::asio::error::operation_aborted));
-    lower_layer->close();
+    const auto it = find_exchange(id);
+    if (it != m_exchanges.end())
+    {
+      it->m_body_sink->write_callback(at, length, 1);
+    }
+  }
+
+  bool is_body_backlogged(std::uint32_t id)
+  {
+    const auto it = find_exchange(id);
+    return it != m_exchanges.end() && it->m_body_sink->is_backlogged();
+  }
+
+  void resume_body(std::uint32_t id)
+  {
+    if (find_exchange(id) != m_exchanges.end())
+    {
+      lower_layer->resume_body(id);
+    }
+  }
+
+  void message_complete(std::uint32_t id)
+  {
+    const auto it = find_exchange(id);
+    if (it != m_exchanges.end())
+    {
+      complete_request(*it, {});
+      m_exchanges.erase(it);
+    }
+  }
+
+  void cancel(std::shared_ptr<const http_request> request) { abort(request, boost::asio::error::operation_aborted); }
+  void cancel_async(std::shared_ptr<const http_request> request) override
+  {
+    async<&http_content::cancel>(std::move(request));
+  }
+
+  void close_idle()
+  {
+    if (m_exchanges.empty())
+    {
+      lower_layer->close();
+    }
   }
-  void cancel_async() override { async<&http_content::cancel>(); }
+  void close_idle_async() override { async<&http_content::close_idle>(); }
 
 private:
   std::pair<std::string, std::uint16_t> m_host;
@@ -153,10 +377,12 @@ private:
   template<auto F, typename... Args>
   void async(Args&&... args)
   {
-    boost::asio::post(
-      m_strand, [ptr = this->shared_from_this(), args = std::make_tuple(std::forward<Args>(args)...)]() mutable {
-        return std::apply([ptr = ptr.get()](auto&&... args) { (ptr->*F)(std::move(args)...); }, std::move(args));
-      });
+    boost::asio::post(m_strand,
+                      make_recycling_handler(
+                        [ptr = this->shared_from_this(), args = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+                          return std::apply([ptr = ptr.get()](auto&&... args) { (ptr->*F)(std::move(args)...); },
+                                            std::move(args));
+                        }));
   }
 };
 
@@ -1,7 +1,10 @@
 #ifndef ASIO_HTTP_HTTP_STACK_SHARED_H
 #define ASIO_HTTP_HTTP_STACK_SHARED_H
 
+#include <atomic>
 #include <boost/asio.hpp>
+#include <cstdint>
+#include <memory>
 
 namespace asio_http
 {
@@ -9,11 +12,21 @@ namespace internal
 {
 struct http_stack_shared
 {
-  http_stack_shared(boost::asio::io_context& context)
+  http_stack_shared(boost::asio::io_context&                    context,
+                    boost::asio::executor                       worker,
+                    std::size_t                                 threshold,
+                    std::shared_ptr<std::atomic<std::uint64_t>> connection_count)
       : strand(context.get_executor())
+      , worker_executor(std::move(worker))
+      , offload_threshold(threshold)
+      , connections(std::move(connection_count))
   {
   }
   boost::asio::strand<boost::asio::io_context::executor_type> strand;
+  boost::asio::executor                                       worker_executor;  // Empty when not offloading
+  std::size_t                                                 offload_threshold;
+  // Connections opened by all the stacks of the pool, shared as stacks may outlive it
+  std::shared_ptr<std::atomic<std::uint64_t>>                 connections;
 };
 }  // namespace internal
 }  // namespace asio_http
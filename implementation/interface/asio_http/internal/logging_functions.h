@@ -17,7 +17,9 @@ class http_request_result;
 namespace internal
 {
 void               http_request_stats_logging(const http_request_result& result, const std::string& name);
-http_request_stats get_request_stats(std::chrono::steady_clock::time_point creation_time);
+// Completes the stats gathered while executing the request
+http_request_stats get_request_stats(std::chrono::steady_clock::time_point creation_time,
+                                     http_request_stats                    stats = {});
 }  // namespace internal
 }  // namespace asio_http
 #endif
@@ -0,0 +1,102 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#ifndef ASIO_HTTP_RECYCLING_ALLOCATOR_H
+#define ASIO_HTTP_RECYCLING_ALLOCATOR_H
+
+#include <boost/asio/bind_executor.hpp>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace asio_http
+{
+namespace internal
+{
+// Thread local cache of the memory blocks of asynchronous operations. Blocks of up to 1 KiB are kept, in size
+// classes of 64 bytes, when released, and handed out again to the next operation of the same class on that
+// thread. Blocks may be released on a different thread than the one they were allocated on
+class recycling_memory
+{
+public:
+  static void* allocate(std::size_t size);
+  static void  deallocate(void* pointer, std::size_t size) noexcept;
+};
+
+template<typename T>
+class recycling_allocator
+{
+public:
+  using value_type = T;
+
+  recycling_allocator() noexcept = default;
+  template<typename U>
+  recycling_allocator(const recycling_allocator<U>&) noexcept
+  {
+  }
+
+  T* allocate(std::size_t n)
+  {
+    static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "Over-aligned types are not supported");
+    return static_cast<T*>(recycling_memory::allocate(n * sizeof(T)));
+  }
+  void deallocate(T* pointer, std::size_t n) noexcept { recycling_memory::deallocate(pointer, n * sizeof(T)); }
+};
+
+template<typename T, typename U>
+bool operator==(const recycling_allocator<T>&, const recycling_allocator<U>&) noexcept
+{
+  return true;
+}
+
+template<typename T, typename U>
+bool operator!=(const recycling_allocator<T>&, const recycling_allocator<U>&) noexcept
+{
+  return false;
+}
+
+// Handler whose associated allocator is the recycling one, so Asio allocates the operation (e.g. a post to a
+// strand or a socket read) from recycled memory. It must be the innermost wrapper, e.g. inside bind_executor
+template<typename Handler>
+class recycling_handler
+{
+public:
+  using allocator_type = recycling_allocator<void>;
+
+  explicit recycling_handler(Handler handler)
+      : m_handler(std::move(handler))
+  {
+  }
+
+  allocator_type get_allocator() const noexcept { return {}; }
+
+  template<typename... Args>
+  void operator()(Args&&... args)
+  {
+    m_handler(std::forward<Args>(args)...);
+  }
+
+private:
+  Handler m_handler;
+};
+
+template<typename Handler>
+recycling_handler<std::decay_t<Handler>> make_recycling_handler(Handler&& handler)
+{
+  return recycling_handler<std::decay_t<Handler>>(std::forward<Handler>(handler));
+}
+
+// Handler run on the given executor, e.g. the strand of a connection, allocated from recycled memory
+template<typename Executor, typename Handler>
+auto bind_recycling_handler(const Executor& executor, Handler&& handler)
+{
+  return boost::asio::bind_executor(executor, make_recycling_handler(std::forward<Handler>(handler)));
+}
+}  // namespace internal
+}  // namespace asio_http
+
+#endif
@@ -9,7 +9,10 @@
 
 #include "asio_http/http_request.h"
 #include "asio_http/http_request_result.h"
+#include "asio_http/internal/completion_handler.h"
 #include "asio_http/internal/connection_pool.h"
+#include "asio_http/internal/data_sink.h"
+#include "asio_http/internal/response_cache.h"
 
 #include <boost/asio.hpp>
 #include <chrono>
@@ -25,11 +28,11 @@ enum class request_state
 {
   waiting_retry = 0,  // Waiting to retry after error or redirection
   waiting       = 1,  // Waiting in the requests queue
-  in_progress   = 2   // Request being executed
+  in_progress   = 2,  // Request being executed
+  coalesced     = 3,  // Waiting for the result of an identical request in progress
+  compressing   = 4   // Waiting for its body to be compressed on the worker executor
 };
 
-using completion_handler = std::function<void(http_request_result)>;
-
 struct request_data
 {
   request_data(std::shared_ptr<const http_request> web_request,
@@ -44,16 +47,26 @@ struct request_data
       , m_cancellation_token(std::move(cancellation_token))
       , m_creation_time(std::chrono::steady_clock::now())
       , m_retries(0)
+      , m_coalescing_key()
+      , m_cache_key()
+      , m_cached_response()
+      , m_body_handler()
+      , m_stats()
   {
   }
-  request_state                         m_request_state;
-  http_stack                            m_connection;
-  std::shared_ptr<const http_request>   m_http_request;
-  completion_handler                    m_completion_handler;
-  boost::asio::executor                 m_completion_executor;
-  std::string                           m_cancellation_token;
-  std::chrono::steady_clock::time_point m_creation_time;
-  std::uint32_t                         m_retries;
+  request_state                          m_request_state;
+  http_stack                             m_connection;
+  std::shared_ptr<const http_request>    m_http_request;
+  mutable completion_handler             m_completion_handler;  // Consumed when the request completes
+  boost::asio::executor                  m_completion_executor;
+  std::string                            m_cancellation_token;
+  std::chrono::steady_clock::time_point  m_creation_time;
+  std::uint32_t                          m_retries;
+  std::string                            m_coalescing_key;   // Empty if the request cannot be coalesced
+  std::string                            m_cache_key;        // Empty if the request bypasses the cache
+  std::shared_ptr<const cached_response> m_cached_response;  // Stale response being revalidated
+  chunk_handler                          m_body_handler;     // Delivers the body chunks on the completion executor
+  http_request_stats                     m_stats;            // Of the compression, done once per request
 };
 }  // namespace internal
 }  // namespace asio_http
@@ -8,9 +8,13 @@
 #define ASIO_HTTP_REQUEST_MANAGER_H
 
 #include "asio_http/http_client_settings.h"
+#include "asio_http/http_client_stats.h"
+#include "asio_http/internal/compression.h"
 #include "asio_http/internal/connection_pool.h"
 #include "asio_http/internal/http_content.h"
+#include "asio_http/internal/recycling_allocator.h"
 #include "asio_http/internal/request_data.h"
+#include "asio_http/internal/response_cache.h"
 
 #include <boost/asio.hpp>
 #include <boost/multi_index/composite_key.hpp>
@@ -20,6 +24,8 @@
 #include <boost/multi_index/sequenced_index.hpp>
 #include <boost/multi_index_container.hpp>
 #include <boost/thread.hpp>
+#include <atomic>
+#include <map>
 #include <memory>
 #include <system_error>
 
@@ -35,26 +41,39 @@ public:
   request_manager(const http_client_settings& settings, boost::asio::io_context& io_context);
   ~request_manager();
 
-  void execute_request_async(request_data request) { async<&request_manager::execute_request>(request); }
+  void execute_request_async(request_data&& request)
+  {
+    async<&request_manager::execute_request>(std::move(request));
+  }
   void cancel_requests_async(std::string cancellation_token)
   {
-    async<&request_manager::cancel_requests>(cancellation_token);
+    async<&request_manager::cancel_requests>(std::move(cancellation_token));
   }
   void
   on_request_completed_async(http_result_data&& http_result_data, http_stack&& handle, boost::system::error_code ec)
   {
     async<&request_manager::on_request_completed>(std::move(http_result_data), std::move(handle), std::move(ec));
   }
+  http_client_stats get_stats() const
+  {
+    return { m_requests_count.load(),
+             m_coalesced_requests_count.load(),
+             m_cache_hits_count.load(),
+             m_cache_revalidations_count.load(),
+             m_connection_pool.get_connections() };
+  }
 
 private:
   // This is a work-around as we don't have C++20 lambdas perfect capture in C++17
   template<auto F, typename... Args>
   void async(Args&&... args)
   {
-    boost::asio::post(
-      m_strand, [ptr = shared_from_this(), args = std::make_tuple(std::forward<Args>(args)...)]() mutable {
-        return std::apply([ptr = ptr.get()](auto&&... args) { (ptr->*F)(std::move(args)...); }, std::move(args));
-      });
+    boost::asio::post(m_strand,
+                      make_recycling_handler(
+                        [ptr = shared_from_this(), args = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+                          return std::apply([ptr = ptr.get()](auto&&... args) { (ptr->*F)(std::move(args)...); },
+                                            std::move(args));
+                        }));
   }
   struct index_connection
   {
@@ -65,6 +84,9 @@ private:
   struct index_cancellation
   {
   };
+  struct index_coalescing
+  {
+  };
 
   using request_list = boost::multi_index::multi_index_container<
     request_data,
@@ -81,7 +103,10 @@ private:
         boost::multi_index::member<request_data, http_stack, &request_data::m_connection>>,
       boost::multi_index::ordered_non_unique<
         boost::multi_index ::tag<index_cancellation>,
-        boost::multi_index::member<request_data, std::string, &request_data::m_cancellation_token>>>>;
+        boost::multi_index::member<request_data, std::string, &request_data::m_cancellation_token>>,
+      boost::multi_index::ordered_non_unique<
+        boost::multi_index ::tag<index_coalescing>,
+        boost::multi_index::member<request_data, std::string, &request_data::m_coalescing_key>>>>;
 
   void execute_request(request_data&& request);
   void cancel_requests(const std::string& cancellation_token);
@@ -91,11 +116,30 @@ private:
   void handle_completed_request(Index& index, const Iterator& iterator, http_request_result&& result);
   template<typename Iterator, typename Index>
   void cancel_request(Index& index, const Iterator& it);
+  bool has_coalescing_leader(const std::string& coalescing_key) const;
+  bool promote_coalesced_request(const request_data& leader);
+  void complete_coalesced_requests(const std::string& coalescing_key, const http_request_result& result);
+  bool serve_from_cache(request_data& request);
+  bool should_offload_compression(const http_request& request) const;
+  std::shared_ptr<const compression_dictionary> get_compression_dictionary(const http_request& request) const;
+  void compress_body_async(std::shared_ptr<const http_request> request);
+  void on_body_compressed(std::shared_ptr<const http_request> request,
+                          std::shared_ptr<const http_request> compressed_request,
+                          http_request_stats                  stats);
+  std::uint32_t get_pipeline_depth(const http_request& request) const;
+  http_request_result
+  create_result(const request_data& request, http_result_data&& http_result_data, boost::system::error_code ec);
 
-  const http_client_settings                                  m_settings;
-  boost::asio::strand<boost::asio::io_context::executor_type> m_strand;
-  connection_pool                                             m_connection_pool;
-  request_list                                                m_requests;
+  const http_client_settings                                             m_settings;
+  boost::asio::strand<boost::asio::io_context::executor_type>            m_strand;
+  connection_pool                                                        m_connection_pool;
+  request_list                                                           m_requests;
+  response_cache                                                         m_response_cache;
+  std::map<std::uint32_t, std::shared_ptr<const compression_dictionary>> m_compression_dictionaries;
+  std::atomic<std::uint64_t>                                             m_requests_count;
+  std::atomic<std::uint64_t>                                             m_coalesced_requests_count;
+  std::atomic<std::uint64_t>                                             m_cache_hits_count;
+  std::atomic<std::uint64_t>                                             m_cache_revalidations_count;
 };
 }  // namespace internal
 }  // namespace asio_http
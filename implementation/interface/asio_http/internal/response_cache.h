@@ -0,0 +1,97 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#ifndef ASIO_HTTP_RESPONSE_CACHE_H
+#define ASIO_HTTP_RESPONSE_CACHE_H
+
+#include "asio_http/http_body.h"
+#include "asio_http/http_request.h"
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace asio_http
+{
+namespace internal
+{
+class disk_cache;
+
+struct cached_response
+{
+  unsigned int                                     m_status_code;
+  std::vector<std::pair<std::string, std::string>> m_headers;
+  std::shared_ptr<const std::uint8_t>              m_body;  // Either a heap buffer or a memory-mapped file region
+  std::size_t                                      m_body_size;
+  std::chrono::system_clock::time_point            m_expiration_time;
+  std::string                                      m_etag;
+  std::string                                      m_last_modified;
+
+  bool                      is_fresh() const { return std::chrono::system_clock::now() < m_expiration_time; }
+  std::size_t               get_size() const;
+  // Shares the entry, unless the body is small enough to be copied
+  http_body get_body() const { return http_body(m_body, m_body_size); }
+
+  // Sets validators and expiration time according to the response headers
+  void update_freshness();
+};
+
+// In-memory private HTTP cache (RFC 7234) with LRU eviction, optionally backed by a persistent disk tier.
+// Not thread safe, it is meant to be used from the request manager strand only
+class response_cache
+{
+public:
+  response_cache(std::size_t max_size, std::shared_ptr<disk_cache> disk_tier);
+
+  // Returns the key identifying the request in the cache, empty if the request must bypass it
+  static std::string get_cache_key(const http_request& request);
+
+  bool is_enabled() const { return m_max_size != 0 || m_disk_tier; }
+
+  // Returns the entry for the key, fresh or stale, or nullptr
+  std::shared_ptr<const cached_response> find(const std::string& key);
+
+  // Stores the response if it is cacheable
+  void store(const std::string&                                      key,
+             unsigned int                                            status_code,
+             const std::vector<std::pair<std::string, std::string>>& headers,
+             const http_body&                                        body);
+
+  // Updates a stale entry after a 304 Not Modified response, returning the updated entry
+  std::shared_ptr<const cached_response>
+  refresh(const std::string&                                      key,
+          const cached_response&                                  stale_response,
+          const std::vector<std::pair<std::string, std::string>>& not_modified_headers);
+
+  // Copy of the request, carrying the validators of the stale entry
+  static std::shared_ptr<const http_request> create_conditional_request(const http_request&    request,
+                                                                        const cached_response& stale_response);
+
+  // True if the request asks not to be served from cache without revalidation
+  static bool requires_validation(const http_request& request);
+
+private:
+  using lru_list = std::list<std::pair<std::string, std::shared_ptr<const cached_response>>>;
+
+  // Refreshed responses are those revalidated with a 304 Not Modified, their body is already stored
+  void insert(const std::string& key, std::shared_ptr<const cached_response> response, bool refreshed);
+  void erase(const std::string& key);
+
+  const std::size_t                                   m_max_size;
+  const std::shared_ptr<disk_cache>                   m_disk_tier;
+  std::size_t                                         m_size;
+  lru_list                                            m_lru;
+  std::unordered_map<std::string, lru_list::iterator> m_entries;
+};
+}  // namespace internal
+}  // namespace asio_http
+
+#endif
@@ -9,8 +9,10 @@
 
 #include "asio_http/http_request.h"
 #include "asio_http/internal/http_stack_shared.h"
+#include "asio_http/internal/recycling_allocator.h"
 #include "asio_http/internal/tuple_ptr.h"
 
+#include <array>
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 #include <memory>
@@ -30,10 +32,17 @@ public:
   virtual void on_connected(const boost::system::error_code&) {}
   virtual void read() {}
   virtual void on_read(const std::uint8_t*, std::size_t, boost::system::error_code) {}
-  virtual void write(std::vector<std::uint8_t>) {}
+  // Returns the empty buffer of the previous write, whose storage may be reused
+  std::vector<std::uint8_t> write(std::vector<std::uint8_t> data) { return write(std::move(data), {}); }
+
+  // The body, if any, is written right after the data, without being copied
+  virtual std::vector<std::uint8_t> write(std::vector<std::uint8_t>, request_body) { return {}; }
   virtual void on_write(const boost::system::error_code&) {}
   virtual void close() {}
   virtual bool is_open() { return false; }
+
+  // Protocol negotiated through ALPN, empty for cleartext connections
+  virtual std::string get_application_protocol() { return {}; }
 };
 
 template<std::size_t N, typename Ls, typename Socket, typename Executor>
@@ -57,28 +66,38 @@ public:
     boost::asio::ip::tcp::resolver::query q(host, port);
 
     m_resolver.async_resolve(
-      q, boost::asio::bind_executor(m_executor, [ptr = this->shared_from_this()](auto&& ec, auto&& it) {
+      q, bind_recycling_handler(m_executor, [ptr = this->shared_from_this()](auto&& ec, auto&& it) {
         ptr->resolve_handler(ec, it);
       }));
   }
 
   virtual bool is_open() override { return m_socket.is_open(); }
 
-  virtual void write(std::vector<std::uint8_t> data) override
+  using protocol_layer::write;
+
+  virtual std::vector<std::uint8_t> write(std::vector<std::uint8_t> data, request_body body) override
   {
     std::swap(m_write_buffer, data);
+    m_write_body = std::move(body);
+    const std::array<boost::asio::const_buffer, 2> buffers{
+      boost::asio::const_buffer(m_write_buffer.data(), m_write_buffer.size()),
+      m_write_body ? boost::asio::const_buffer(m_write_body->data(), m_write_body->size())
+                   : boost::asio::const_buffer()
+    };
     boost::asio::async_write(
       m_socket,
-      boost::asio::const_buffer(m_write_buffer.data(), m_write_buffer.size()),
-      boost::asio::bind_executor(
+      buffers,
+      bind_recycling_handler(
         m_executor, [ptr = this->shared_from_this()](auto&& ec, auto&& bytes) { ptr->write_handler(ec, bytes); }));
+    data.clear();
+    return data;
   }
 
   virtual void read() override
   {
     m_socket.async_read_some(
       boost::asio::buffer(m_read_buffer),
-      boost::asio::bind_executor(
+      bind_recycling_handler(
         m_executor, [ptr = this->shared_from_this()](auto&& ec, auto&& bytes) { ptr->read_handler(ec, bytes); }));
   }
 
@@ -98,6 +117,7 @@ private:
   std::shared_ptr<http_stack_shared> m_shared_data;
   Socket                             m_socket;
   std::vector<std::uint8_t>          m_write_buffer;
+  request_body                       m_write_body;
   std::vector<std::uint8_t>          m_read_buffer;
   boost::asio::ip::tcp::resolver     m_resolver;
   Executor                           m_executor;
@@ -111,28 +131,35 @@ private:
     }
     boost::asio::ip::tcp::endpoint ep = *it++;
 
-    m_socket.async_connect(ep, boost::asio::bind_executor(m_executor, [ptr = this->shared_from_this(), it](auto&& ec) {
-                             ptr->connect_handler(ec, it);
-                           }));
+    m_socket.async_connect(ep, bind_recycling_handler(m_executor, [ptr = this->shared_from_this(), it](auto&& ec) {
+                         ptr->connect_handler(ec, it);
+                       }));
   }
 
   void connect_handler(const boost::system::error_code& ec, boost::asio::ip::tcp::resolver::iterator it)
   {
     if (!ec || it == boost::asio::ip::tcp::resolver::iterator())
     {
+      if (!ec)
+      {
+        (*m_shared_data->connections)++;
+      }
       upper_layer->on_connected(ec);
     }
     else
     {
       boost::asio::ip::tcp::endpoint ep = *it++;
-      m_socket.async_connect(ep,
-                             boost::asio::bind_executor(m_executor, [ptr = this->shared_from_this(), it](auto&& ec) {
-                               ptr->connect_handler(ec, it);
-                             }));
+      m_socket.async_connect(ep, bind_recycling_handler(m_executor, [ptr = this->shared_from_this(), it](auto&& ec) {
+                           ptr->connect_handler(ec, it);
+                         }));
     }
   }
 
-  void write_handler(const boost::system::error_code& ec, std::size_t) { upper_layer->on_write(ec); }
+  void write_handler(const boost::system::error_code& ec, std::size_t)
+  {
+    m_write_body.reset();
+    upper_layer->on_write(ec);
+  }
 
   void read_handler(const boost::system::error_code& ec, std::size_t bytes_transferred)
   {
@@ -152,7 +179,8 @@ public:
   ssl_socket(std::shared_ptr<http_stack_shared> shared_data,
              boost::asio::io_context&           context,
              const std::string&                 host,
-             const ssl_settings&                ssl)
+             const ssl_settings&                ssl,
+             const std::vector<std::string>&    application_protocols = {})
       : protocol_layer()
       , m_shared_data(shared_data)
       , m_context(boost::asio::ssl::context::sslv23)
@@ -176,6 +204,17 @@ public:
     }
     m_socket.set_verify_mode(boost::asio::ssl::verify_peer);
     m_socket.set_verify_callback(boost::asio::ssl::rfc2818_verification(host));
+
+    if (!application_protocols.empty())
+    {
+      std::vector<unsigned char> protocols;
+      for (const auto& protocol : application_protocols)
+      {
+        protocols.push_back(static_cast<unsigned char>(protocol.size()));
+        protocols.insert(protocols.end(), protocol.begin(), protocol.end());
+      }
+      SSL_set_alpn_protos(m_socket.native_handle(), protocols.data(), static_cast<unsigned int>(protocols.size()));
+    }
   }
 
   virtual void connect(const std::string& host, const std::string& port) override
@@ -183,28 +222,47 @@ public:
     boost::asio::ip::tcp::resolver::query q(host, port);
 
     m_resolver.async_resolve(
-      q, boost::asio::bind_executor(m_executor, [ptr = this->shared_from_this()](auto&& ec, auto&& it) {
+      q, bind_recycling_handler(m_executor, [ptr = this->shared_from_this()](auto&& ec, auto&& it) {
         ptr->resolve_handler(ec, it);
       }));
   }
 
   virtual bool is_open() override { return m_socket.lowest_layer().is_open(); }
 
-  virtual void write(std::vector<std::uint8_t> data) override
+  // Servers without ALPN support speak HTTP/1.1
+  virtual std::string get_application_protocol() override
+  {
+    const unsigned char* protocol = nullptr;
+    unsigned int         size     = 0;
+    SSL_get0_alpn_selected(m_socket.native_handle(), &protocol, &size);
+    return size != 0 ? std::string(reinterpret_cast<const char*>(protocol), size) : "http/1.1";
+  }
+
+  using protocol_layer::write;
+
+  virtual std::vector<std::uint8_t> write(std::vector<std::uint8_t> data, request_body body) override
   {
     std::swap(m_write_buffer, data);
+    m_write_body = std::move(body);
+    const std::array<boost::asio::const_buffer, 2> buffers{
+      boost::asio::const_buffer(m_write_buffer.data(), m_write_buffer.size()),
+      m_write_body ? boost::asio::const_buffer(m_write_body->data(), m_write_body->size())
+                   : boost::asio::const_buffer()
+    };
     boost::asio::async_write(
       m_socket,
-      boost::asio::const_buffer(m_write_buffer.data(), m_write_buffer.size()),
-      boost::asio::bind_executor(
+      buffers,
+      bind_recycling_handler(
         m_executor, [ptr = this->shared_from_this()](auto&& ec, auto&& bytes) { ptr->write_handler(ec, bytes); }));
+    data.clear();
+    return data;
   }
 
   virtual void read() override
   {
     m_socket.async_read_some(
       boost::asio::buffer(m_read_buffer),
-      boost::asio::bind_executor(
+      bind_recycling_handler(
         m_executor, [ptr = this->shared_from_this()](auto&& ec, auto&& bytes) { ptr->read_handler(ec, bytes); }));
   }
 
@@ -225,6 +283,7 @@ private:
   boost::asio::ssl::context                              m_context;
   boost::asio::ssl::stream<boost::asio::ip::tcp::socket> m_socket;
   std::vector<std::uint8_t>                              m_write_buffer;
+  request_body                                           m_write_body;
   std::vector<std::uint8_t>                              m_read_buffer;
   boost::asio::ip::tcp::resolver                         m_resolver;
   Executor&                                              m_executor;
@@ -239,7 +298,7 @@ private:
     boost::asio::ip::tcp::endpoint ep = *it++;
 
     m_socket.lowest_layer().async_connect(
-      ep, boost::asio::bind_executor(m_executor, [ptr = this->shared_from_this(), it](auto&& ec) {
+      ep, bind_recycling_handler(m_executor, [ptr = this->shared_from_this(), it](auto&& ec) {
         ptr->connect_handler(ec, it);
       }));
   }
@@ -248,16 +307,16 @@ private:
   {
     if (!ec)
     {
-      m_socket.async_handshake(boost::asio::ssl::stream<boost::asio::ip::tcp::socket>::handshake_type::client,
-                               boost::asio::bind_executor(m_executor, [ptr = this->shared_from_this()](auto&& ec) {
-                                 ptr->handshake_handler(ec);
-                               }));
+      (*m_shared_data->connections)++;
+      m_socket.async_handshake(
+        boost::asio::ssl::stream<boost::asio::ip::tcp::socket>::handshake_type::client,
+        bind_recycling_handler(m_executor, [ptr = this->shared_from_this()](auto&& ec) { ptr->handshake_handler(ec); }));
     }
     else if (it != boost::asio::ip::tcp::resolver::iterator())
     {
       boost::asio::ip::tcp::endpoint ep = *it++;
       m_socket.lowest_layer().async_connect(
-        ep, boost::asio::bind_executor(m_executor, [ptr = this->shared_from_this(), it](auto&& ec) {
+        ep, bind_recycling_handler(m_executor, [ptr = this->shared_from_this(), it](auto&& ec) {
           ptr->connect_handler(ec, it);
         }));
     }
@@ -269,7 +328,11 @@ private:
 
   void handshake_handler(const boost::system::error_code& ec) { upper_layer->on_connected(ec); }
 
-  void write_handler(const boost::system::error_code& ec, std::size_t) { upper_layer->on_write(ec); }
+  void write_handler(const boost::system::error_code& ec, std::size_t)
+  {
+    m_write_body.reset();
+    upper_layer->on_write(ec);
+  }
 
   void read_handler(const boost::system::error_code& ec, std::size_t bytes_transferred)
   {
@@ -8,8 +8,10 @@
 #define ASIO_HTTP_TUPLE_PTR_H
 #include <atomic>
 #include <memory>
+#include <new>
 #include <tuple>
 #include <type_traits>
+#include <utility>
 
 namespace asio_http
 {
@@ -136,6 +138,65 @@ private:
   }
 };
 
+// Control block holding the objects themselves, so they and their counts take a single allocation
+template<template<typename> class Alloc, class... Tp>
+class shared_tuple_emplace : public shared_weak_count
+{
+  std::tuple<std::aligned_storage_t<sizeof(Tp), alignof(Tp)>...> storage;
+
+public:
+  template<std::size_t N>
+  auto get()
+  {
+    using T = std::tuple_element_t<N, std::tuple<Tp...>>;
+    return std::launder(reinterpret_cast<T*>(std::addressof(std::get<N>(storage))));
+  }
+
+  // Objects are constructed in order, each from its tuple of arguments
+  template<typename Args, std::size_t... I>
+  void construct(Args&& args, std::index_sequence<I...>)
+  {
+    std::size_t constructed = 0;
+    try
+    {
+      ((construct<I>(std::get<I>(std::forward<Args>(args))), constructed++), ...);
+    }
+    catch (...)
+    {
+      ((I < constructed ? std::destroy_at(get<I>()) : void()), ...);
+      throw;
+    }
+  }
+
+private:
+  template<std::size_t N, typename Args>
+  void construct(Args&& args)
+  {
+    using T = std::tuple_element_t<N, std::tuple<Tp...>>;
+    std::apply(
+      [this](auto&&... args) {
+        ::new (static_cast<void*>(std::addressof(std::get<N>(storage)))) T(std::forward<decltype(args)>(args)...);
+      },
+      std::forward<Args>(args));
+  }
+
+  template<std::size_t... I>
+  void destroy(std::index_sequence<I...>)
+  {
+    (std::destroy_at(get<I>()), ...);
+  }
+
+  virtual void on_zero_shared() { destroy(std::index_sequence_for<Tp...>()); }
+  virtual void on_zero_shared_weak()
+  {
+    using Al = Alloc<shared_tuple_emplace>;
+
+    Al a{};
+    this->~shared_tuple_emplace();
+    a.deallocate(this, 1);
+  }
+};
+
 template<class Tp>
 class shared_tuple_base;
 template<class... Tp>
@@ -252,6 +313,17 @@ public:
 
   void reset() { tuple_ptr().swap(*this); }
 
+  // Takes the initial reference of a control block which holds the objects
+  template<typename... Y>
+  static tuple_ptr adopt(shared_weak_count* cntrl_, Y*... p)
+  {
+    tuple_ptr r;
+    r.ptrs  = element_type(p...);
+    r.cntrl = cntrl_;
+    (r.enable_weak_this(p, p), ...);
+    return r;
+  }
+
   operator bool() const { return cntrl != nullptr; }
 
   template<typename T>
@@ -287,6 +359,37 @@ public:
   void enable_weak_this(...) {}
 };
 
+template<typename... Tp, typename CntrlBlk, std::size_t... I>
+tuple_ptr<Tp...> adopt_tuple(CntrlBlk* cntrl, std::index_sequence<I...>)
+{
+  return tuple_ptr<Tp...>::adopt(cntrl, cntrl->template get<I>()...);
+}
+
+// Allocates the objects and their control block as a single block with Alloc, constructing each object from the
+// tuple of arguments at its position in args
+template<template<typename> class Alloc, typename... Tp, typename Args>
+tuple_ptr<Tp...> allocate_tuple(Args&& args)
+{
+  using CntrlBlk = shared_tuple_emplace<Alloc, Tp...>;
+  using Al       = Alloc<CntrlBlk>;
+  using seq      = std::index_sequence_for<Tp...>;
+
+  Al    a{};
+  auto* cntrl = ::new (static_cast<void*>(a.allocate(1))) CntrlBlk();
+  try
+  {
+    cntrl->construct(std::forward<Args>(args), seq());
+  }
+  catch (...)
+  {
+    cntrl->~CntrlBlk();
+    a.deallocate(cntrl, 1);
+    throw;
+  }
+
+  return adopt_tuple<Tp...>(cntrl, seq());
+}
+
 class bad_ptr : public std::exception
 {
 public:
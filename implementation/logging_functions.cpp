@@ -54,10 +54,8 @@ void log_data(const std::string& url, const char* msg, size_t size, const std::s
 #endif
 }  // namespace
 
-http_request_stats get_request_stats(std::chrono::steady_clock::time_point creation_time)
+http_request_stats get_request_stats(std::chrono::steady_clock::time_point creation_time, http_request_stats stats_ret)
 {
-  http_request_stats stats_ret = {};
-
   stats_ret.total_time_s = std::chrono::steady_clock::now() - creation_time;
 
   return stats_ret;
@@ -72,6 +70,8 @@ void http_request_stats_logging(const http_request_result& result, const std::st
   DLOG_F(INFO, "  Request execution time: %.5f s", result.stats.total_time_s.count());
   DLOG_F(INFO, "  Download speed: %" PRId64, result.stats.avg_download_speed_bps);
   DLOG_F(INFO, "  Upload speed: %" PRId64, result.stats.avg_upload_speed_bps);
+  DLOG_F(INFO, "  Compressed upload bytes: %" PRId64, result.stats.compressed_upload_bytes);
+  DLOG_F(INFO, "  Compression time: %.5f s", result.stats.compression_time_s.count());
 }
 }  // namespace internal
 }  // namespace asio_http
@@ -0,0 +1,70 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#include "asio_http/prepared_request.h"
+
+#include "asio_http/http_request_result.h"
+
+namespace asio_http
+{
+namespace
+{
+std::shared_ptr<const prepared_headers> prepare_headers(const url&                                       url,
+                                                        std::vector<std::pair<std::string, std::string>> headers)
+{
+  if (get_header(headers, "Host").empty())
+  {
+    headers.emplace(headers.begin(), "Host", url.get_authority());
+  }
+
+  auto prepared = std::make_shared<prepared_headers>();
+  for (const auto& header : headers)
+  {
+    prepared->m_serialized.append(header.first).append(": ").append(header.second).append("\r\n");
+  }
+  prepared->m_headers = std::move(headers);
+  return prepared;
+}
+}  // namespace
+
+prepared_request::prepared_request(const std::string&                               base_url,
+                                   std::vector<std::pair<std::string, std::string>> headers,
+                                   ssl_settings                                     certificates,
+                                   std::uint32_t                                    timeout_msec)
+    : m_url(base_url)
+    , m_certificates(std::move(certificates))
+    , m_timeout_msec(timeout_msec)
+    , m_headers(prepare_headers(m_url, std::move(headers)))
+{
+}
+
+http_request prepared_request::make_request(http_method                                      method,
+                                            const std::string&                               target,
+                                            std::vector<std::uint8_t>                        post_data,
+                                            compression_policy                               policy,
+                                            std::vector<std::pair<std::string, std::string>> headers) const
+{
+  // The target is split as the url parser would, with the query keeping its '?'
+  auto       request_url = m_url;
+  const auto query       = target.find('?');
+  request_url.path       = target.substr(0, query);
+  request_url.query      = query != std::string::npos ? target.substr(query) : std::string{};
+  if (request_url.path.empty())
+  {
+    request_url.path = "/";
+  }
+
+  http_request request(method,
+                       std::move(request_url),
+                       m_timeout_msec,
+                       m_certificates,
+                       std::move(headers),
+                       std::move(post_data),
+                       policy);
+  request.m_prepared_headers = m_headers;
+  return request;
+}
+}  // namespace asio_http
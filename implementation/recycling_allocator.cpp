@@ -0,0 +1,106 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#include "asio_http/internal/recycling_allocator.h"
+
+#include <array>
+
+namespace asio_http
+{
+namespace internal
+{
+namespace
+{
+constexpr std::size_t granularity      = 64;
+constexpr std::size_t size_classes     = 16;
+constexpr std::size_t blocks_per_class = 8;
+
+// Set once the cache of the thread is destroyed, as operations may still be released afterwards, e.g. by the
+// destructors of other thread local objects
+thread_local bool cache_destroyed = false;
+
+class thread_cache
+{
+public:
+  ~thread_cache()
+  {
+    for (auto block : m_free_blocks)
+    {
+      while (block)
+      {
+        ::operator delete(std::exchange(block, block->m_next));
+      }
+    }
+    cache_destroyed = true;
+  }
+
+  void* pop(std::size_t size_class)
+  {
+    auto& block = m_free_blocks[size_class];
+    if (!block)
+    {
+      return nullptr;
+    }
+    m_counts[size_class]--;
+    return std::exchange(block, block->m_next);
+  }
+
+  bool push(void* pointer, std::size_t size_class)
+  {
+    if (m_counts[size_class] == blocks_per_class)
+    {
+      return false;
+    }
+    m_counts[size_class]++;
+    m_free_blocks[size_class] = new (pointer) free_block{ m_free_blocks[size_class] };
+    return true;
+  }
+
+private:
+  struct free_block
+  {
+    free_block* m_next;
+  };
+
+  std::array<free_block*, size_classes> m_free_blocks{};
+  std::array<std::size_t, size_classes> m_counts{};
+};
+
+thread_local thread_cache cache;
+
+// Zero for sizes which are not recycled
+std::size_t get_size_class(std::size_t size)
+{
+  const auto size_class = (size + granularity - 1) / granularity;
+  return size_class <= size_classes ? size_class : 0;
+}
+}  // namespace
+
+void* recycling_memory::allocate(std::size_t size)
+{
+  const auto size_class = get_size_class(size);
+  if (size_class == 0 || cache_destroyed)
+  {
+    return ::operator new(size);
+  }
+  if (auto pointer = cache.pop(size_class - 1))
+  {
+    return pointer;
+  }
+  // Rounded up, so the block fits any size of its class once recycled
+  return ::operator new(size_class * granularity);
+}
+
+void recycling_memory::deallocate(void* pointer, std::size_t size) noexcept
+{
+  const auto size_class = get_size_class(size);
+  if (size_class == 0 || cache_destroyed || !cache.push(pointer, size_class - 1))
+  {
+    ::operator delete(pointer);
+  }
+}
+}  // namespace internal
+}  // namespace asio_http
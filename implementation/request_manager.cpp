@@ -10,12 +10,15 @@
 #include "asio_http/http_request.h"
 #include "asio_http/http_request_result.h"
 #include "asio_http/internal/completion_handler_invoker.h"
+#include "asio_http/internal/compression.h"
+#include "asio_http/internal/disk_cache.h"
 #include "asio_http/internal/http_client_connection.h"
 #include "asio_http/internal/http_error_handling.h"
 #include "asio_http/internal/logging_functions.h"
 
 #include "loguru.hpp"
 
+#include <algorithm>
 #include <boost/asio.hpp>
 #include <cinttypes>
 #include <memory>
@@ -35,31 +38,225 @@ create_request_result(const request_data& request, http_result_data&& http_resul
                              std::move(http_result_data.m_headers),
                              std::move(http_result_data.data),
                              ec,
+                             get_request_stats(request.m_creation_time, request.m_stats));
+
+  http_request_stats_logging(result, request.m_http_request->get_url().to_string());
+
+  return result;
+}
+
+http_request_result create_cached_result(const request_data& request, const cached_response& response)
+{
+  http_request_result result(response.m_status_code,
+                             http_headers(response.m_headers),
+                             response.get_body(),
+                             {},
                              get_request_stats(request.m_creation_time));
 
   http_request_stats_logging(result, request.m_http_request->get_url().to_string());
 
   return result;
 }
+
+// Only requests without side effects may share their result. The key contains everything that
+// might make the server reply differently, or that determines the connection to be used
+std::string get_coalescing_key(const http_request& request)
+{
+  const auto method = request.get_http_method();
+  if (method != http_method::GET && method != http_method::HEAD)
+  {
+    return {};
+  }
+
+  const auto& ssl = request.get_ssl_settings();
+  std::string key = (method == http_method::GET ? "GET " : "HEAD ") + request.get_url().to_string();
+  if (const auto& prepared = request.get_prepared_headers())
+  {
+    key.append("\n").append(prepared->m_serialized);
+  }
+  for (const auto& header : request.get_http_headers())
+  {
+    key.append("\n").append(header.first).append(": ").append(header.second);
+  }
+  key.append("\n")
+    .append(ssl.client_private_key_file)
+    .append("\n")
+    .append(ssl.client_certificate_file)
+    .append("\n")
+    .append(ssl.certificate_authority_bundle_file);
+
+  return key;
+}
+
+// The body is compressed once, and the compressed request is the one retried or redirected from then on
+std::shared_ptr<const http_request> create_compressed_request(const http_request&           request,
+                                                              const compression_dictionary* dictionary,
+                                                              http_request_stats&           stats)
+{
+  auto compressed_data = compress_body(*request.get_post_data_buffer(),
+                                       request.get_compress_post_data_policy(),
+                                       request.get_compression_settings(),
+                                       dictionary,
+                                       stats.compression_time_s);
+
+  auto compressed_request                  = std::make_shared<http_request>(request);
+  compressed_request->m_compression_policy = compression_policy::never;
+  if (!compressed_data.empty())
+  {
+    stats.compressed_upload_bytes = compressed_data.size();
+    compressed_request->m_post_data = std::make_shared<const std::vector<std::uint8_t>>(std::move(compressed_data));
+    compressed_request->m_http_headers.emplace_back("Content-Encoding",
+                                                    get_upload_content_encoding(request.get_compression_settings()));
+  }
+  return compressed_request;
+}
 }  // namespace
 request_manager::request_manager(const http_client_settings& settings, boost::asio::io_context& io_context)
     : m_settings(settings)
     , m_strand(io_context.get_executor())
-    , m_connection_pool(io_context)
+    , m_connection_pool(io_context,
+                        settings.http2 ? settings.http2_max_concurrent_streams : 0,
+                        settings.worker_executor,
+                        settings.offload_threshold)
+    , m_response_cache(settings.cache_max_size,
+                       settings.disk_cache_path.empty() ?
+                         nullptr :
+                         disk_cache::open(settings.disk_cache_path, settings.disk_cache_max_size))
+    , m_requests_count(0)
+    , m_coalesced_requests_count(0)
+    , m_cache_hits_count(0)
+    , m_cache_revalidations_count(0)
 {
+  for (const auto& data : settings.compression_dictionaries)
+  {
+    auto dictionary = std::make_shared<const compression_dictionary>(data);
+    if (dictionary->get_id() == 0)
+    {
+      LOG_F(ERROR, "Ignored compression dictionary, it is not a zstd dictionary");
+      continue;
+    }
+    m_compression_dictionaries[dictionary->get_id()] = std::move(dictionary);
+  }
 }
 
 request_manager::~request_manager()
 {
+  DLOG_F(INFO,
+         "Destroyed request manager after requests: %" PRIu64 ", coalesced: %" PRIu64,
+         m_requests_count.load(),
+         m_coalesced_requests_count.load());
 }
 
 void request_manager::execute_request(request_data&& request)
 {
+  m_requests_count++;
+
+  if (const auto& handler = request.m_http_request->get_body_handler())
+  {
+    // The chunks and the result go through the same strand, so they are delivered in order. The connection
+    // stops reading while the handler is behind
+    request.m_completion_executor = boost::asio::strand<boost::asio::executor>(request.m_completion_executor);
+    request.m_body_handler        = [executor = request.m_completion_executor, handler](
+                               std::vector<std::uint8_t> chunk, std::shared_ptr<body_backlog> backlog) {
+      boost::asio::dispatch(
+        executor, make_recycling_handler([handler, chunk = std::move(chunk), backlog = std::move(backlog)]() mutable {
+          handler(std::move(chunk));
+          backlog->pop();
+        }));
+    };
+  }
+
+  // The body of streamed responses is not kept, so they can neither be cached nor shared
+  if (!request.m_body_handler && m_response_cache.is_enabled() && serve_from_cache(request))
+  {
+    DLOG_F(INFO, "New request served from cache");
+    return;
+  }
+
+  if (m_settings.coalesce_requests && !request.m_body_handler)
+  {
+    request.m_coalescing_key = get_coalescing_key(*request.m_http_request);
+    if (!request.m_coalescing_key.empty() && has_coalescing_leader(request.m_coalescing_key))
+    {
+      request.m_request_state = request_state::coalesced;
+      m_coalesced_requests_count++;
+      m_requests.insert(std::move(request));
+      DLOG_F(INFO, "New request coalesced");
+      return;
+    }
+  }
+
+  if (request.m_http_request->get_compress_post_data_policy() != compression_policy::never)
+  {
+    if (should_offload_compression(*request.m_http_request))
+    {
+      request.m_request_state = request_state::compressing;
+      compress_body_async(request.m_http_request);
+      m_requests.insert(std::move(request));
+      DLOG_F(INFO, "New request waiting for its body to be compressed");
+      return;
+    }
+    request.m_http_request = create_compressed_request(
+      *request.m_http_request, get_compression_dictionary(*request.m_http_request).get(), request.m_stats);
+  }
+
   m_requests.insert(std::move(request));
   execute_waiting_requests();
   DLOG_F(INFO, "New request added");
 }
 
+bool request_manager::should_offload_compression(const http_request& request) const
+{
+  return m_settings.worker_executor && request.get_post_data_buffer()->size() >= m_settings.offload_threshold;
+}
+
+// Requests tagged with an unknown dictionary are compressed without one
+std::shared_ptr<const compression_dictionary>
+request_manager::get_compression_dictionary(const http_request& request) const
+{
+  const auto id = request.get_compression_settings().dictionary_id;
+  const auto it = m_compression_dictionaries.find(id);
+  if (it == m_compression_dictionaries.end())
+  {
+    if (id != 0)
+    {
+      LOG_F(WARNING, "Unknown compression dictionary: %" PRIu32, id);
+    }
+    return nullptr;
+  }
+  return it->second;
+}
+
+void request_manager::compress_body_async(std::shared_ptr<const http_request> request)
+{
+  auto dictionary = get_compression_dictionary(*request);
+  boost::asio::post(m_settings.worker_executor, [ptr = this->shared_from_this(), request, dictionary]() {
+    http_request_stats stats{};
+    auto               compressed_request = create_compressed_request(*request, dictionary.get(), stats);
+    ptr->async<&request_manager::on_body_compressed>(request, std::move(compressed_request), stats);
+  });
+}
+
+void request_manager::on_body_compressed(std::shared_ptr<const http_request> request,
+                                         std::shared_ptr<const http_request> compressed_request,
+                                         http_request_stats                  stats)
+{
+  // The request might have been cancelled in the meantime
+  auto&      index = m_requests.get<index_state>();
+  const auto range = index.equal_range(std::make_tuple(request_state::compressing));
+  const auto it =
+    std::find_if(range.first, range.second, [&request](const request_data& r) { return r.m_http_request == request; });
+  if (it != range.second)
+  {
+    index.modify(it, [&compressed_request, &stats](request_data& request) {
+      request.m_http_request  = compressed_request;
+      request.m_request_state = request_state::waiting;
+      request.m_stats         = stats;
+    });
+    execute_waiting_requests();
+  }
+}
+
 void request_manager::cancel_requests(const std::string& cancellation_token)
 {
   auto& index = m_requests.get<index_cancellation>();
@@ -73,9 +270,14 @@ void request_manager::cancel_requests(const std::string& cancellation_token)
 template<typename Iterator, typename Index>
 void request_manager::cancel_request(Index& index, const Iterator& it)
 {
-  if (it->m_connection)
+  if (promote_coalesced_request(*it))
   {
-    it->m_connection->cancel_async();
+    // The upstream request keeps running on behalf of the remaining waiters
+    handle_completed_request(index, it, http_request_result(make_error_code(boost::asio::error::operation_aborted)));
+  }
+  else if (it->m_connection)
+  {
+    it->m_connection->cancel_async(it->m_http_request);
   }
   else
   {
@@ -88,40 +290,174 @@ void request_manager::handle_completed_request(Index& index, const Iterator& ite
 {
   completion_handler_invoker::invoke_handler(*iterator, std::move(result));
   index.erase(iterator);
-  boost::asio::post(m_strand, ([ptr = this->shared_from_this()]() { ptr->execute_waiting_requests(); }));
+  boost::asio::post(m_strand,
+                    make_recycling_handler([ptr = this->shared_from_this()]() { ptr->execute_waiting_requests(); }));
 }
 
 void request_manager::on_request_completed(http_result_data&&        http_result_data,
                                            http_stack&&              handle,
                                            boost::system::error_code ec)
 {
-  m_connection_pool.release_connection(handle, static_cast<bool>(ec));
+  m_connection_pool.release_connection(handle, ec);
 
+  // Pipelined requests share the connection
   auto&      index = m_requests.get<index_connection>();
-  const auto it    = index.find(handle);
-  if (it != m_requests.get<index_connection>().end())
+  const auto range = index.equal_range(handle);
+  const auto it    = std::find_if(range.first, range.second, [&http_result_data](const request_data& r) {
+    return r.m_http_request == http_result_data.m_request;
+  });
+  if (it != range.second)
   {
     const auto error_handling = process_errors(ec, http_result_data);
-    if (error_handling.first && it->m_retries < m_settings.max_attempts)
+    if (error_handling.first && it->m_retries < m_settings.max_attempts && http_result_data.m_retryable)
     {
       index.modify(it, [newrequest = std::move(error_handling.second)](request_data& request) {
         if (newrequest)
         {
+          // Only the response to the original url may be stored
           request.m_http_request = newrequest;
+          request.m_cache_key.clear();
         }
         request.m_connection.reset();
         request.m_request_state = request_state::waiting_retry;
         request.m_retries++;
       });
-      boost::asio::post(m_strand, [ptr = this->shared_from_this()]() { ptr->execute_waiting_requests(); });
+      boost::asio::post(m_strand,
+                        make_recycling_handler([ptr = this->shared_from_this()]() { ptr->execute_waiting_requests(); }));
+    }
+    else
+    {
+      auto result = create_result(*it, std::move(http_result_data), ec);
+      complete_coalesced_requests(it->m_coalescing_key, result);
+      handle_completed_request(index, it, std::move(result));
+    }
+  }
+}
+
+bool request_manager::has_coalescing_leader(const std::string& coalescing_key) const
+{
+  const auto range = m_requests.get<index_coalescing>().equal_range(coalescing_key);
+  return std::any_of(
+    range.first, range.second, [](const request_data& r) { return r.m_request_state != request_state::coalesced; });
+}
+
+// Hands the upstream request over to one of the requests waiting for it
+bool request_manager::promote_coalesced_request(const request_data& leader)
+{
+  if (leader.m_coalescing_key.empty() || leader.m_request_state == request_state::coalesced)
+  {
+    return false;
+  }
+
+  auto&      index = m_requests.get<index_coalescing>();
+  const auto range = index.equal_range(leader.m_coalescing_key);
+  const auto it    = std::find_if(
+    range.first, range.second, [](const request_data& r) { return r.m_request_state == request_state::coalesced; });
+  if (it == range.second)
+  {
+    return false;
+  }
+
+  index.modify(it, [&leader](request_data& request) {
+    request.m_http_request    = leader.m_http_request;
+    request.m_connection      = leader.m_connection;
+    request.m_request_state   = leader.m_request_state;
+    request.m_retries         = leader.m_retries;
+    request.m_cache_key       = leader.m_cache_key;
+    request.m_cached_response = leader.m_cached_response;
+  });
+  return true;
+}
+
+void request_manager::complete_coalesced_requests(const std::string& coalescing_key, const http_request_result& result)
+{
+  if (coalescing_key.empty())
+  {
+    return;
+  }
+
+  auto& index = m_requests.get<index_coalescing>();
+  auto  range = index.equal_range(coalescing_key);
+  for (auto it = range.first; it != range.second;)
+  {
+    if (it->m_request_state == request_state::coalesced)
+    {
+      completion_handler_invoker::invoke_handler(*it, result);
+      it = index.erase(it);
     }
     else
     {
-      handle_completed_request(index, it, create_request_result(*it, std::move(http_result_data), ec));
+      ++it;
     }
   }
 }
 
+bool request_manager::serve_from_cache(request_data& request)
+{
+  request.m_cache_key = response_cache::get_cache_key(*request.m_http_request);
+  if (request.m_cache_key.empty())
+  {
+    return false;
+  }
+
+  const auto response = m_response_cache.find(request.m_cache_key);
+  if (!response)
+  {
+    return false;
+  }
+
+  if (response->is_fresh() && !response_cache::requires_validation(*request.m_http_request))
+  {
+    m_cache_hits_count++;
+    completion_handler_invoker::invoke_handler(request, create_cached_result(request, *response));
+    return true;
+  }
+
+  if (!response->m_etag.empty() || !response->m_last_modified.empty())
+  {
+    request.m_cached_response = response;
+    request.m_http_request    = response_cache::create_conditional_request(*request.m_http_request, *response);
+  }
+  return false;
+}
+
+http_request_result request_manager::create_result(const request_data&       request,
+                                                   http_result_data&&        http_result_data,
+                                                   boost::system::error_code ec)
+{
+  if (!ec && request.m_cached_response && http_result_data.m_status_code == 304)
+  {
+    m_cache_revalidations_count++;
+    const auto response = request.m_cache_key.empty() ?
+      request.m_cached_response :
+      m_response_cache.refresh(
+        request.m_cache_key, *request.m_cached_response, http_result_data.m_headers.to_vector());
+    return create_cached_result(request, *response);
+  }
+
+  if (!ec && !request.m_cache_key.empty())
+  {
+    m_response_cache.store(request.m_cache_key,
+                           http_result_data.m_status_code,
+                           http_result_data.m_headers.to_vector(),
+                           http_result_data.data);
+  }
+  return create_request_result(request, std::move(http_result_data), ec);
+}
+
+// Requests with a body, or with side effects, are never pipelined
+std::uint32_t request_manager::get_pipeline_depth(const http_request& request) const
+{
+  const auto method = request.get_http_method();
+  if (method != http_method::GET && method != http_method::HEAD)
+  {
+    return 1;
+  }
+
+  const auto it = m_settings.pipeline_depth_per_host.find(request.get_url().host);
+  return it != m_settings.pipeline_depth_per_host.end() ? it->second : m_settings.pipeline_depth;
+}
+
 void request_manager::execute_waiting_requests()
 {
   auto& index = m_requests.get<index_state>();
@@ -129,17 +465,19 @@ void request_manager::execute_waiting_requests()
   const auto active_requests = index.count(request_state::in_progress);
   const auto it              = index.begin();
   if (active_requests < m_settings.max_parallel_requests && it != index.end() &&
-      it->m_request_state != request_state::in_progress)
+      it->m_request_state < request_state::in_progress)
   {
-    auto handle =
-      m_connection_pool.get_connection(it->m_http_request->get_url(), it->m_http_request->get_ssl_settings());
-    const auto request = it->m_http_request;
+    auto handle = m_connection_pool.get_connection(it->m_http_request->get_url(),
+                                                   it->m_http_request->get_ssl_settings(),
+                                                   get_pipeline_depth(*it->m_http_request));
+    const auto request      = it->m_http_request;
+    const auto body_handler = it->m_body_handler;
     index.modify(it, [&handle](request_data& request) {
       request.m_connection    = handle;
       request.m_request_state = request_state::in_progress;
     });
     handle->start_async(
-      request, [ptr = this->shared_from_this(), h = std::move(handle)](auto&& http_result_data, auto&& ec) mutable {
+      request, body_handler, [ptr = this->shared_from_this(), h = std::move(handle)](auto&& http_result_data, auto&& ec) mutable {
         ptr->on_request_completed_async(std::forward<decltype(http_result_data)>(http_result_data), std::move(h), ec);
       });
   }
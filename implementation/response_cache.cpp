@@ -0,0 +1,386 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#include "asio_http/internal/response_cache.h"
+
+#include "asio_http/http_request_result.h"
+#include "asio_http/internal/disk_cache.h"
+
+#include "loguru.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+
+namespace asio_http
+{
+namespace internal
+{
+namespace
+{
+using std::chrono::system_clock;
+
+struct cache_control
+{
+  bool                        no_store = false;
+  bool                        no_cache = false;
+  std::optional<std::int64_t> max_age;
+};
+
+std::string trim(const std::string& str)
+{
+  const auto begin = str.find_first_not_of(" \t");
+  return begin == std::string::npos ? std::string{} : str.substr(begin, str.find_last_not_of(" \t") - begin + 1);
+}
+
+// delta-seconds (RFC 7234, section 1.2.1), greater values are taken as 2^31
+std::optional<std::int64_t> parse_seconds(const std::string& value)
+{
+  constexpr std::int64_t max_delta_seconds = std::int64_t(1) << 31;
+
+  if (value.empty() || !std::all_of(value.begin(), value.end(), [](char c) { return c >= '0' && c <= '9'; }))
+  {
+    return {};
+  }
+  std::int64_t seconds;
+  const auto   result = std::from_chars(value.data(), value.data() + value.size(), seconds);
+  return result.ec == std::errc::result_out_of_range ? max_delta_seconds : std::min(seconds, max_delta_seconds);
+}
+
+cache_control parse_cache_control(const std::string& value)
+{
+  cache_control result;
+
+  std::size_t begin = 0;
+  while (begin < value.size())
+  {
+    auto end = value.find(',', begin);
+    if (end == std::string::npos)
+    {
+      end = value.size();
+    }
+
+    const auto directive = trim(value.substr(begin, end - begin));
+    const auto equal     = directive.find('=');
+    const auto name      = trim(directive.substr(0, equal));
+
+    if (iequals(name, "no-store"))
+    {
+      result.no_store = true;
+    }
+    else if (iequals(name, "no-cache"))
+    {
+      result.no_cache = true;
+    }
+    else if (iequals(name, "max-age") && equal != std::string::npos)
+    {
+      auto argument = trim(directive.substr(equal + 1));
+      argument.erase(std::remove(argument.begin(), argument.end(), '"'), argument.end());
+      result.max_age = parse_seconds(argument);
+      if (!result.max_age)
+      {
+        result.max_age = 0;
+      }
+    }
+    begin = end + 1;
+  }
+
+  return result;
+}
+
+// Days since 1970-01-01 of a date in the proleptic Gregorian calendar
+std::int64_t days_from_civil(std::int64_t y, unsigned m, unsigned d)
+{
+  y -= m <= 2;
+  const std::int64_t era = (y >= 0 ? y : y - 399) / 400;
+  const unsigned     yoe = static_cast<unsigned>(y - era * 400);
+  const unsigned     doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const unsigned     doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + static_cast<std::int64_t>(doe) - 719468;
+}
+
+// Parses an IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT", the only format that must be generated
+// by HTTP/1.1 servers
+std::optional<system_clock::time_point> parse_http_date(const std::string& value)
+{
+  static const char* const months = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+  int  day, year, hour, minute, second;
+  char month[4] = {};
+  if (std::sscanf(value.c_str(), "%*[^,], %2d %3s %4d %2d:%2d:%2d GMT", &day, month, &year, &hour, &minute, &second) !=
+      6)
+  {
+    return {};
+  }
+
+  const char* const month_position = std::strstr(months, month);
+  if (std::strlen(month) != 3 || month_position == nullptr || (month_position - months) % 3 != 0)
+  {
+    return {};
+  }
+
+  const auto days = days_from_civil(year, static_cast<unsigned>(month_position - months) / 3 + 1, day);
+  return system_clock::time_point(std::chrono::seconds(days * 86400 + hour * 3600 + minute * 60 + second));
+}
+
+system_clock::time_point get_expiration_time(const std::vector<std::pair<std::string, std::string>>& headers,
+                                             const cache_control&                                    directives)
+{
+  if (directives.no_cache)
+  {
+    return {};
+  }
+
+  const auto             now = system_clock::now();
+  system_clock::duration lifetime{};
+
+  if (directives.max_age)
+  {
+    lifetime = std::chrono::seconds(*directives.max_age);
+  }
+  else
+  {
+    const auto expires = get_header(headers, "Expires");
+    if (!expires.empty())
+    {
+      // Invalid dates, like "0", mean already expired
+      const auto expiration = parse_http_date(expires);
+      const auto date       = parse_http_date(get_header(headers, "Date"));
+      lifetime              = expiration ? *expiration - date.value_or(now) : system_clock::duration{};
+    }
+  }
+
+  const auto age = parse_seconds(trim(get_header(headers, "Age"))).value_or(0);
+
+  return now + lifetime - std::chrono::seconds(age);
+}
+
+std::size_t get_entry_size(const std::string& key, const cached_response& response)
+{
+  return sizeof(cached_response) + key.size() + response.get_size();
+}
+
+// Prepared headers are sent first
+std::string get_request_header(const http_request& request, const std::string& name)
+{
+  const auto& prepared = request.get_prepared_headers();
+  auto        value    = prepared ? get_header(prepared->m_headers, name) : std::string{};
+  return value.empty() ? get_header(request.get_http_headers(), name) : value;
+}
+}  // namespace
+
+std::size_t cached_response::get_size() const
+{
+  std::size_t size = m_body_size + m_etag.size() + m_last_modified.size();
+  for (const auto& header : m_headers)
+  {
+    size += header.first.size() + header.second.size();
+  }
+  return size;
+}
+
+void cached_response::update_freshness()
+{
+  m_expiration_time = get_expiration_time(m_headers, parse_cache_control(get_header(m_headers, "Cache-Control")));
+  m_etag            = get_header(m_headers, "ETag");
+  m_last_modified   = get_header(m_headers, "Last-Modified");
+}
+
+response_cache::response_cache(std::size_t max_size, std::shared_ptr<disk_cache> disk_tier)
+    : m_max_size(max_size)
+    , m_disk_tier(std::move(disk_tier))
+    , m_size(0)
+{
+}
+
+std::string response_cache::get_cache_key(const http_request& request)
+{
+  if (request.get_http_method() != http_method::GET ||
+      parse_cache_control(get_request_header(request, "Cache-Control")).no_store ||
+      !get_request_header(request, "If-None-Match").empty() ||
+      !get_request_header(request, "If-Modified-Since").empty() || !get_request_header(request, "Range").empty())
+  {
+    return {};
+  }
+
+  // Request headers are part of the key, which makes Vary handling trivially correct
+  std::string key = request.get_url().to_string();
+  if (const auto& prepared = request.get_prepared_headers())
+  {
+    key.append("\n").append(prepared->m_serialized);
+  }
+  const auto& headers = request.get_http_headers();
+  for (const auto& header : headers)
+  {
+    key.append("\n").append(header.first).append(": ").append(header.second);
+  }
+  // Responses fetched with one client identity are not served to another one
+  const auto& ssl = request.get_ssl_settings();
+  key.append("\n")
+    .append(ssl.client_private_key_file)
+    .append("\n")
+    .append(ssl.client_certificate_file)
+    .append("\n")
+    .append(ssl.certificate_authority_bundle_file);
+  return key;
+}
+
+bool response_cache::requires_validation(const http_request& request)
+{
+  const auto directives = parse_cache_control(get_request_header(request, "Cache-Control"));
+  return directives.no_cache || (directives.max_age && *directives.max_age == 0) ||
+    iequals(get_request_header(request, "Pragma"), "no-cache");
+}
+
+std::shared_ptr<const cached_response> response_cache::find(const std::string& key)
+{
+  const auto it = m_entries.find(key);
+  if (it == m_entries.end())
+  {
+    return m_disk_tier ? m_disk_tier->find(key) : nullptr;
+  }
+
+  m_lru.splice(m_lru.begin(), m_lru, it->second);
+  return it->second->second;
+}
+
+void response_cache::store(const std::string&                                      key,
+                           unsigned int                                            status_code,
+                           const std::vector<std::pair<std::string, std::string>>& headers,
+                           const http_body&                                        body)
+{
+  const auto directives = parse_cache_control(get_header(headers, "Cache-Control"));
+  if (status_code != 200 || directives.no_store || trim(get_header(headers, "Vary")) == "*")
+  {
+    return;
+  }
+
+  const auto buffer   = std::make_shared<const std::vector<std::uint8_t>>(body.to_vector());
+  auto       response = std::make_shared<cached_response>();
+  response->m_status_code = status_code;
+  response->m_headers     = headers;
+  response->m_body        = std::shared_ptr<const std::uint8_t>(buffer, buffer->data());
+  response->m_body_size   = buffer->size();
+  response->update_freshness();
+
+  // An entry which is already stale and cannot be revalidated is useless
+  if (response->is_fresh() || !response->m_etag.empty() || !response->m_last_modified.empty())
+  {
+    insert(key, std::move(response), false);
+  }
+}
+
+std::shared_ptr<const cached_response>
+response_cache::refresh(const std::string&                                      key,
+                        const cached_response&                                  stale_response,
+                        const std::vector<std::pair<std::string, std::string>>& not_modified_headers)
+{
+  auto response = std::make_shared<cached_response>(stale_response);
+
+  for (const auto& header : not_modified_headers)
+  {
+    if (iequals(header.first, "Content-Length"))
+    {
+      continue;
+    }
+    const auto it = std::find_if(response->m_headers.begin(), response->m_headers.end(), [&header](const auto& h) {
+      return iequals(h.first, header.first);
+    });
+    if (it != response->m_headers.end())
+    {
+      it->second = header.second;
+    }
+    else
+    {
+      response->m_headers.push_back(header);
+    }
+  }
+
+  response->update_freshness();
+
+  if (parse_cache_control(get_header(response->m_headers, "Cache-Control")).no_store)
+  {
+    erase(key);
+    if (m_disk_tier)
+    {
+      m_disk_tier->erase(key);
+    }
+  }
+  else
+  {
+    insert(key, response, true);
+  }
+  return response;
+}
+
+std::shared_ptr<const http_request> response_cache::create_conditional_request(const http_request&    request,
+                                                                              const cached_response& stale_response)
+{
+  auto conditional_request = std::make_shared<http_request>(request);
+  if (!stale_response.m_etag.empty())
+  {
+    conditional_request->m_http_headers.emplace_back("If-None-Match", stale_response.m_etag);
+  }
+  if (!stale_response.m_last_modified.empty())
+  {
+    conditional_request->m_http_headers.emplace_back("If-Modified-Since", stale_response.m_last_modified);
+  }
+  return conditional_request;
+}
+
+void response_cache::insert(const std::string& key, std::shared_ptr<const cached_response> response, bool refreshed)
+{
+  erase(key);
+
+  if (m_disk_tier)
+  {
+    // The body of a revalidated response did not change, it is not written again
+    if (refreshed)
+    {
+      m_disk_tier->refresh(key, response);
+    }
+    else
+    {
+      m_disk_tier->store(key, response);
+    }
+  }
+
+  const auto size = get_entry_size(key, *response);
+  if (size > m_max_size)
+  {
+    // Without a memory tier, every response is only on disk
+    if (m_max_size != 0)
+    {
+      DLOG_F(INFO, "Response too large to be cached in memory: %zu", size);
+    }
+    return;
+  }
+
+  m_lru.emplace_front(key, std::move(response));
+  m_entries.emplace(key, m_lru.begin());
+  m_size += size;
+
+  while (m_size > m_max_size)
+  {
+    const auto least_recently_used = m_lru.back().first;
+    erase(least_recently_used);
+  }
+}
+
+void response_cache::erase(const std::string& key)
+{
+  const auto it = m_entries.find(key);
+  if (it != m_entries.end())
+  {
+    m_size -= get_entry_size(key, *it->second->second);
+    m_lru.erase(it->second);
+    m_entries.erase(it);
+  }
+}
+}  // namespace internal
+}  // namespace asio_http
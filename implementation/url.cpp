@@ -6,8 +6,7 @@
 
 #include "asio_http/url.h"
 
-#include <boost/lexical_cast.hpp>
-#include <regex>
+#include <stdexcept>
 
 namespace asio_http
 {
@@ -21,46 +20,43 @@ const uint16_t DEFAULT_PORT_HTTPS = 443;
 const char* const PROTOCOL_HTTP  = "http";
 const char* const PROTOCOL_HTTPS = "https";
 
-auto get_url_components(const std::string& url)
+url_components get_url_components(const std::string& url)
 {
-  static const std::regex r("^((.+):\\/\\/)?([A-Za-z0-9\\-\\.]+)(:([0-9]+))?(\\/[^?]*)?(\\?.*)?$");
-  std::smatch             what;
-  if (!std::regex_match(url, what, r))
+  const auto components = parse_url(url);
+  if (!components.valid)
   {
     throw std::runtime_error("Failed to parse url: '" + url + "'");
   }
+  return components;
+}
 
-  const std::string protocol = (what[2].matched ? what[2].str() : std::string(PROTOCOL_HTTP));
-
-  uint16_t port = 0;
-  if (what[5].length() > 0)
-  {
-    port = boost::lexical_cast<uint16_t>(what[5].str());
-  }
-  else if (protocol == PROTOCOL_HTTP)
-  {
-    port = DEFAULT_PORT_HTTP;
-  }
-  else if (protocol == PROTOCOL_HTTPS)
-  {
-    port = DEFAULT_PORT_HTTPS;
-  }
-
-  const std::string host  = what[3];
-  const std::string path  = what[6].str().empty() ? "/" : what[6].str();
-  const std::string query = what[7];
-
-  return std::make_tuple(protocol, host, port, path, query);
+bool is_default_port(const url& url)
+{
+  return (url.protocol == PROTOCOL_HTTP && url.port == DEFAULT_PORT_HTTP) ||
+    (url.protocol == PROTOCOL_HTTPS && url.port == DEFAULT_PORT_HTTPS) || url.port == 0;
 }
 }  // namespace
 
 url::url(const std::tuple<std::string, std::string, uint16_t, std::string, std::string>& tuple)
     : protocol(std::get<0>(tuple))
     , host(std::get<1>(tuple))
-    , port(std::get<2>(tuple))
     , path(std::get<3>(tuple))
     , query(std::get<4>(tuple))
+    , port(std::get<2>(tuple))
+{
+}
+
+url::url(const url_components& components)
+    : protocol(components.protocol.empty() ? std::string_view(PROTOCOL_HTTP) : components.protocol)
+    , host(components.host)
+    , path(components.path.empty() ? std::string_view("/") : components.path)
+    , query(components.query)
+    , port(components.port)
 {
+  if (!components.has_port)
+  {
+    port = protocol == PROTOCOL_HTTP ? DEFAULT_PORT_HTTP : protocol == PROTOCOL_HTTPS ? DEFAULT_PORT_HTTPS : 0;
+  }
 }
 
 url::url(const std::string& url_string)
@@ -70,16 +66,17 @@ url::url(const std::string& url_string)
 
 std::string url::to_string() const
 {
-  std::stringstream stream;
-  stream << protocol << "://" << host;
+  return protocol + "://" + get_authority() + path + query;
+}
 
-  if (!(protocol == PROTOCOL_HTTP && port == DEFAULT_PORT_HTTP) &&
-      !(protocol == PROTOCOL_HTTPS && port == DEFAULT_PORT_HTTPS) && (port != 0))
+std::string url::get_authority() const
+{
+  std::string authority = host.find(':') != std::string::npos ? "[" + host + "]" : host;
+  if (!is_default_port(*this))
   {
-    stream << ":" << port;
+    authority.append(":").append(std::to_string(port));
   }
-  stream << path << query;
-  return stream.str();
+  return authority;
 }
 
 bool operator==(const url& url1, const url& url2)
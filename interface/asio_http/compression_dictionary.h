@@ -0,0 +1,26 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#ifndef ASIO_HTTP_COMPRESSION_DICTIONARY_H
+#define ASIO_HTTP_COMPRESSION_DICTIONARY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace asio_http
+{
+// Trains a zstd dictionary from sample request bodies, which should be many and representative. The result is
+// empty if training fails or zstd is not available
+std::vector<std::uint8_t> train_compression_dictionary(const std::vector<std::vector<std::uint8_t>>& samples,
+                                                       std::size_t max_size = 16 * 1024);
+
+// Id embedded in the dictionary, which is the one for compression_settings::dictionary_id. It is carried by
+// the bodies compressed with it, so the server can pick the same dictionary. Zero if it is not a dictionary
+std::uint32_t get_compression_dictionary_id(const std::vector<std::uint8_t>& dictionary);
+}  // namespace asio_http
+
+#endif
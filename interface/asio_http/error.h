@@ -12,10 +12,38 @@
 #include <boost/asio.hpp>
 #include <boost/system/system_error.hpp>
 
+#include <iterator>
+#include <string>
 #include <system_error>
 
 namespace asio_http
 {
+// HTTP/2 error codes (RFC 7540, section 7), either received from the server or detected by the client
+enum class http2_error
+{
+  no_error            = 0x0,
+  protocol_error      = 0x1,
+  internal_error      = 0x2,
+  flow_control_error  = 0x3,
+  settings_timeout    = 0x4,
+  stream_closed       = 0x5,
+  frame_size_error    = 0x6,
+  refused_stream      = 0x7,
+  cancel              = 0x8,
+  compression_error   = 0x9,
+  connect_error       = 0xa,
+  enhance_your_calm   = 0xb,
+  inadequate_security = 0xc,
+  http_1_1_required   = 0xd
+};
+
+// Errors detected by the client itself
+enum class client_error
+{
+  body_size_mismatch = 1,  // the body generator produced fewer or more bytes than the given size
+  decoding_error          // the response body could not be decompressed
+};
+
 namespace internal
 {
 struct http_parser_category : public boost::system::error_category
@@ -35,7 +63,70 @@ public:
     return singleton;
   }
 };
+
+struct http2_category : public boost::system::error_category
+{
+  virtual const char* name() const noexcept override { return "HTTP/2 error"; }
+  virtual std::string message(int value) const override
+  {
+    static const char* const names[] = {
+      "NO_ERROR",
+      "PROTOCOL_ERROR",
+      "INTERNAL_ERROR",
+      "FLOW_CONTROL_ERROR",
+      "SETTINGS_TIMEOUT",
+      "STREAM_CLOSED",
+      "FRAME_SIZE_ERROR",
+      "REFUSED_STREAM",
+      "CANCEL",
+      "COMPRESSION_ERROR",
+      "CONNECT_ERROR",
+      "ENHANCE_YOUR_CALM",
+      "INADEQUATE_SECURITY",
+      "HTTP_1_1_REQUIRED"
+    };
+    return value >= 0 && value < static_cast<int>(std::size(names)) ? names[value] : "UNKNOWN_ERROR";
+  }
+
+  static const http2_category& get_singleton()
+  {
+    static const http2_category singleton;
+    return singleton;
+  }
+};
+
+struct client_category : public boost::system::error_category
+{
+  virtual const char* name() const noexcept override { return "asio_http client error"; }
+  virtual std::string message(int value) const override
+  {
+    switch (static_cast<client_error>(value))
+    {
+      case client_error::body_size_mismatch:
+        return "Body size mismatch";
+      case client_error::decoding_error:
+        return "Content decoding error";
+    }
+    return "Unknown error";
+  }
+
+  static const client_category& get_singleton()
+  {
+    static const client_category singleton;
+    return singleton;
+  }
+};
 }  // namespace internal
+
+inline boost::system::error_code make_error_code(http2_error e)
+{
+  return boost::system::error_code(static_cast<int>(e), internal::http2_category::get_singleton());
+}
+
+inline boost::system::error_code make_error_code(client_error e)
+{
+  return boost::system::error_code(static_cast<int>(e), internal::client_category::get_singleton());
+}
 }  // namespace asio_http
 
 inline boost::system::error_code make_error_code(http_errno e)
@@ -52,6 +143,18 @@ struct is_error_code_enum<http_errno>
 {
   static const bool value = true;
 };
+
+template<>
+struct is_error_code_enum<asio_http::http2_error>
+{
+  static const bool value = true;
+};
+
+template<>
+struct is_error_code_enum<asio_http::client_error>
+{
+  static const bool value = true;
+};
 }  // namespace system
 }  // namespace boost
 #endif
@@ -0,0 +1,66 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#ifndef ASIO_HTTP_HTTP_BODY_H
+#define ASIO_HTTP_HTTP_BODY_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace asio_http
+{
+// Body of a response, which never changes. Copies share larger bodies, so the same response may be handed to
+// several consumers without copying it, whereas small ones (e.g. health checks or short JSON documents) are
+// kept inline, without any heap allocation
+class http_body
+{
+public:
+  static constexpr std::size_t inline_capacity = 256;
+
+  http_body()
+      : m_size(0)
+  {
+  }
+  explicit http_body(std::vector<std::uint8_t>&& data);
+  http_body(const std::uint8_t* data, std::size_t size);
+  // Shares data, e.g. a cached response, unless it is small enough to be copied inline
+  http_body(std::shared_ptr<const std::uint8_t> data, std::size_t size);
+
+  // Only the bytes in use of inline bodies are copied
+  http_body(const http_body& other);
+  http_body(http_body&& other) noexcept;
+  http_body& operator=(const http_body& other);
+  http_body& operator=(http_body&& other) noexcept;
+
+  const std::uint8_t* data() const { return m_shared ? m_shared.get() : m_inline.data(); }
+  std::size_t         size() const { return m_size; }
+  bool                empty() const { return m_size == 0; }
+  const std::uint8_t* begin() const { return data(); }
+  const std::uint8_t* end() const { return data() + m_size; }
+
+  // Valid as long as the body
+  std::string_view view() const { return { reinterpret_cast<const char*>(data()), m_size }; }
+
+  std::vector<std::uint8_t> to_vector() const { return { begin(), end() }; }
+
+private:
+  void assign(const std::uint8_t* data, std::size_t size);
+
+  std::size_t                               m_size;
+  std::shared_ptr<const std::uint8_t>       m_shared;  // Null when inline
+  std::array<std::uint8_t, inline_capacity> m_inline;
+};
+
+bool operator==(const http_body& body, const std::vector<std::uint8_t>& data);
+bool operator==(const std::vector<std::uint8_t>& data, const http_body& body);
+}  // namespace asio_http
+
+#endif
@@ -8,6 +8,7 @@
 #define ASIO_HTTP_HTTP_CLIENT_H
 
 #include "asio_http/http_client_settings.h"
+#include "asio_http/http_client_stats.h"
 #include "asio_http/internal/request_data.h"
 #include "asio_http/internal/request_manager.h"
 #include <asio_http/http_request.h>
@@ -30,13 +31,13 @@ public:
   {
     boost::asio::async_completion<CompletionToken, void(http_request_result)> init{ completion_token };
 
-    internal::request_data new_request(
-      std::make_shared<http_request>(std::move(request)),
-      init.completion_handler,
-      boost::asio::get_associated_executor(init.completion_handler, boost::asio::system_executor()),
-      std::move(cancellation_token));
+    auto executor = boost::asio::get_associated_executor(init.completion_handler, boost::asio::system_executor());
+    internal::request_data new_request(std::make_shared<http_request>(std::move(request)),
+                                       std::move(init.completion_handler),
+                                       std::move(executor),
+                                       std::move(cancellation_token));
 
-    m_request_manager->execute_request_async(new_request);
+    m_request_manager->execute_request_async(std::move(new_request));
 
     return init.result.get();
   }
@@ -55,7 +56,8 @@ public:
                           std::vector<std::uint8_t>(),
                           compression_policy::never };
 
-    return execute_request(std::forward<CompletionToken>(completion_token), request, std::move(cancellation_token));
+    return execute_request(
+      std::forward<CompletionToken>(completion_token), std::move(request), std::move(cancellation_token));
   }
 
   template<typename CompletionToken>
@@ -66,17 +68,22 @@ public:
             std::string               cancellation_token = {},
             ssl_settings              ssl                = {})
   {
-    http_request request{
-      http_method::POST,        url(std::move(url_string)),           http_request::DEFAULT_TIMEOUT_MSEC,
-      std::move(ssl),           { { "Content-Type", content_type } }, std::move(data),
-      compression_policy::never
-    };
+    http_request request{ http_method::POST,
+                          url(std::move(url_string)),
+                          http_request::DEFAULT_TIMEOUT_MSEC,
+                          std::move(ssl),
+                          { { "Content-Type", std::move(content_type) } },
+                          std::move(data),
+                          compression_policy::never };
 
-    return execute_request(std::forward<CompletionToken>(completion_token), request, std::move(cancellation_token));
+    return execute_request(
+      std::forward<CompletionToken>(completion_token), std::move(request), std::move(cancellation_token));
   }
 
   void cancel_requests(std::string cancellation_token);
 
+  http_client_stats get_stats() const;
+
 private:
   // Declaration (initialization) order is relevant for the members below
   boost::asio::io_context&                   m_io_context;
@@ -7,7 +7,12 @@
 #ifndef ASIO_HTTP_HTTP_REQUEST_MANAGER_SETTINGS_H
 #define ASIO_HTTP_HTTP_REQUEST_MANAGER_SETTINGS_H
 
+#include <boost/asio/executor.hpp>
 #include <cinttypes>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
 
 namespace asio_http
 {
@@ -16,15 +21,68 @@ struct http_client_settings
   http_client_settings()
       : max_parallel_requests(25)
       , max_attempts(5)
+      , coalesce_requests(false)
+      , cache_max_size(0)
+      , disk_cache_path()
+      , disk_cache_max_size(1024 * 1024 * 1024)
+      , pipeline_depth(1)
+      , pipeline_depth_per_host()
+      , http2(false)
+      , http2_max_concurrent_streams(100)
+      , worker_executor()
+      , offload_threshold(256 * 1024)
+      , compression_dictionaries()
   {
   }
   http_client_settings(std::uint32_t max_parallel_requests_, std::uint32_t max_attempts_)
       : max_parallel_requests(max_parallel_requests_)
       , max_attempts(max_attempts_)
+      , coalesce_requests(false)
+      , cache_max_size(0)
+      , disk_cache_path()
+      , disk_cache_max_size(1024 * 1024 * 1024)
+      , pipeline_depth(1)
+      , pipeline_depth_per_host()
+      , http2(false)
+      , http2_max_concurrent_streams(100)
+      , worker_executor()
+      , offload_threshold(256 * 1024)
+      , compression_dictionaries()
   {
   }
   const std::uint32_t max_parallel_requests;
   const std::uint32_t max_attempts;
+
+  // Concurrent GET/HEAD requests with identical url, headers and SSL settings share a single
+  // upstream request, whose result is delivered to every waiting completion handler
+  bool coalesce_requests;
+
+  // Memory budget in bytes of the in-memory HTTP response cache, zero disables it
+  std::size_t cache_max_size;
+
+  // Directory of the persistent response cache, empty disables it. Several clients may share it
+  std::string disk_cache_path;
+  std::size_t disk_cache_max_size;
+
+  // Maximum number of GET/HEAD requests written to a keep-alive connection before their responses
+  // are received. One disables HTTP pipelining. The per host value, if any, takes precedence
+  std::uint32_t                        pipeline_depth;
+  std::map<std::string, std::uint32_t> pipeline_depth_per_host;
+
+  // Use HTTP/2, negotiated through ALPN for https and with prior knowledge for http. Requests to a host are
+  // multiplexed as streams of a single connection, and max_parallel_requests limits the streams in progress
+  bool          http2;
+  std::uint32_t http2_max_concurrent_streams;
+
+  // Executor where request bodies are compressed, and response bodies decompressed, when they are at least
+  // offload_threshold bytes long (or of unknown size), so the I/O threads keep serving other requests.
+  // Smaller bodies, or all of them if no executor is given, are processed on the connection strand
+  boost::asio::executor worker_executor;
+  std::size_t           offload_threshold;
+
+  // zstd dictionaries for request bodies, e.g. made with train_compression_dictionary. Requests select one
+  // through the id embedded in it. The server must know the dictionary as well
+  std::vector<std::vector<std::uint8_t>> compression_dictionaries;
 };
 }  // namespace asio_http
 #endif
@@ -0,0 +1,27 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#ifndef ASIO_HTTP_HTTP_CLIENT_STATS_H
+#define ASIO_HTTP_HTTP_CLIENT_STATS_H
+
+#include <cstdint>
+
+namespace asio_http
+{
+// Aggregated counters for all the requests executed by an http_client
+struct http_client_stats
+{
+  std::uint64_t requests;             // Requests submitted by the user
+  std::uint64_t coalesced_requests;   // Requests completed by an identical in-flight request
+  std::uint64_t cache_hits;           // Requests completed from cache, without network access
+  std::uint64_t cache_revalidations;  // Requests completed from cache after a 304 Not Modified response
+  std::uint64_t connections;          // TCP connections established, reconnections included
+
+  double coalesce_ratio() const { return requests != 0 ? static_cast<double>(coalesced_requests) / requests : 0.0; }
+};
+}  // namespace asio_http
+
+#endif
@@ -0,0 +1,138 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#ifndef ASIO_HTTP_HTTP_HEADERS_H
+#define ASIO_HTTP_HTTP_HEADERS_H
+
+#include <array>
+#include <boost/container/small_vector.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace asio_http
+{
+// Headers which the library and most applications look for, resolved once as they are received
+enum class http_header : std::uint8_t
+{
+  age,
+  cache_control,
+  connection,
+  content_encoding,
+  content_length,
+  content_type,
+  date,
+  etag,
+  expires,
+  keep_alive,
+  last_modified,
+  location,
+  pragma,
+  retry_after,
+  transfer_encoding,
+  vary,
+  other
+};
+
+// Headers of a response. Names and values are stored back to back in a single buffer, so receiving them takes
+// a single allocation in most cases. They are handed out as views into the buffer, which are valid as long as
+// the headers are neither modified nor destroyed
+class http_headers
+{
+public:
+  using value_type = std::pair<std::string_view, std::string_view>;
+
+  class const_iterator
+  {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type        = http_headers::value_type;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = void;
+    using reference         = value_type;
+
+    const_iterator(const http_headers* headers, std::size_t index)
+        : m_headers(headers)
+        , m_index(index)
+    {
+    }
+
+    value_type      operator*() const { return (*m_headers)[m_index]; }
+    const_iterator& operator++()
+    {
+      ++m_index;
+      return *this;
+    }
+    const_iterator operator++(int) { return { m_headers, m_index++ }; }
+    const_iterator& operator--()
+    {
+      --m_index;
+      return *this;
+    }
+    const_iterator  operator+(difference_type n) const { return { m_headers, m_index + n }; }
+    difference_type operator-(const const_iterator& other) const
+    {
+      return static_cast<difference_type>(m_index) - static_cast<difference_type>(other.m_index);
+    }
+    bool operator==(const const_iterator& other) const { return m_index == other.m_index; }
+    bool operator!=(const const_iterator& other) const { return m_index != other.m_index; }
+
+  private:
+    const http_headers* m_headers;
+    std::size_t         m_index;
+  };
+
+  http_headers() = default;
+  explicit http_headers(const std::vector<std::pair<std::string, std::string>>& headers);
+
+  void add(std::string_view name, std::string_view value);
+
+  // Pieces of the header being parsed, as the parser delivers them: first its name, then its value
+  void append_name(std::string_view piece);
+  void append_value(std::string_view piece);
+
+  std::size_t    size() const { return m_entries.size(); }
+  bool           empty() const { return m_entries.empty(); }
+  value_type     operator[](std::size_t index) const;
+  const_iterator begin() const { return { this, 0 }; }
+  const_iterator end() const { return { this, m_entries.size() }; }
+
+  // Value of the first header with the given name, which is case insensitive. Empty if there is none.
+  // Well-known headers are found in constant time, the others by comparing the hashes of their names
+  std::string_view get(std::string_view name) const;
+  std::string_view get(http_header header) const;
+
+  // Copies which do not depend on the buffer
+  std::vector<std::pair<std::string, std::string>> to_vector() const;
+
+private:
+  static constexpr std::size_t header_count = static_cast<std::size_t>(http_header::other);
+
+  // The value follows the name in the buffer. The hash is of the lowercase name
+  struct entry
+  {
+    std::uint32_t m_offset;
+    std::uint32_t m_name_size;
+    std::uint32_t m_value_size;
+    std::uint32_t m_hash;
+  };
+
+  entry& start_entry();
+  void   end_name();
+
+  std::string                               m_buffer;
+  boost::container::small_vector<entry, 24> m_entries;
+  bool                                      m_parsing_value = false;
+  // One past the first entry of every well-known header, zero if there is none
+  std::array<std::uint16_t, header_count>   m_well_known{};
+};
+}  // namespace asio_http
+
+#endif
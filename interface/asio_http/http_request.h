@@ -9,6 +9,11 @@
 
 #include "asio_http/url.h"
 
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace asio_http
@@ -47,6 +52,57 @@ enum class compression_policy
   always        // always compress, even when not smaller
 };
 
+enum class compression_strategy
+{
+  default_strategy,
+  filtered,      // for data produced by a filter or predictor
+  huffman_only,  // no string matching, fastest
+  rle            // matches limited to runs of one byte, as in image data
+};
+
+// Content coding of compressed request bodies. zstd requires the library, otherwise gzip is used
+enum class upload_encoding
+{
+  gzip,
+  zstd
+};
+
+// How request bodies are compressed, as allowed by the compression_policy. Compression is skipped for small
+// bodies and, unless the policy is always, for data whose sample looks incompressible
+struct compression_settings
+{
+  int                  level         = 6;  // from 1 (fastest) to 9 (smallest)
+  compression_strategy strategy      = compression_strategy::default_strategy;  // gzip only
+  std::size_t          min_size      = 1024;
+  bool                 entropy_check = true;
+  upload_encoding      encoding      = upload_encoding::gzip;
+  // zstd dictionary, out of http_client_settings::compression_dictionaries, or zero for none. Small and similar
+  // bodies, which hardly compress on their own, compress well with a dictionary trained from samples of them
+  std::uint32_t dictionary_id = 0;
+};
+
+// Request bodies are immutable, and shared by every copy of the request, its retries and redirections, down to
+// the socket
+using request_body = std::shared_ptr<const std::vector<std::uint8_t>>;
+
+// Receives the response body in chunks as it is downloaded, already decoded
+using body_handler = std::function<void(std::vector<std::uint8_t> chunk)>;
+
+// Produces the request body as it is sent, writing up to size bytes to the buffer. It returns the number of
+// bytes written, zero meaning the end of the body. It runs on the thread of the connection, which it blocks
+// until it returns, so it must not wait for data which is not available yet; such bodies are better sent once
+// complete. When the size of the body is given, the request fails with client_error::body_size_mismatch if the
+// generator produces fewer or more bytes
+using body_generator = std::function<std::size_t(std::uint8_t* buffer, std::size_t size)>;
+
+// Headers shared by the requests made from a prepared_request, Host included. They never change, and are
+// serialized once
+struct prepared_headers
+{
+  std::vector<std::pair<std::string, std::string>> m_headers;
+  std::string                                      m_serialized;  // "Name: value\r\n" for each of them
+};
+
 class http_request
 {
 public:
@@ -60,21 +116,64 @@ public:
                std::vector<std::uint8_t>                        post_data,
                compression_policy                               compression_policy);
 
-  http_method                                      get_http_method() const { return m_http_method; }
-  url                                              get_url() const { return m_url; }
-  uint32_t                                         get_timeout_msec() const { return m_timeout_msec; }
-  std::vector<std::pair<std::string, std::string>> get_http_headers() const { return m_http_headers; }
-  std::vector<uint8_t>                             get_post_data() const { return m_post_data; }
-  compression_policy get_compress_post_data_policy() const { return m_compression_policy; }
-  ssl_settings       get_ssl_settings() const { return m_certificates; }
+  http_method                                             get_http_method() const { return m_http_method; }
+  const url&                                              get_url() const { return m_url; }
+  uint32_t                                                get_timeout_msec() const { return m_timeout_msec; }
+  const std::vector<std::pair<std::string, std::string>>& get_http_headers() const { return m_http_headers; }
+  const std::vector<uint8_t>&                             get_post_data() const { return *m_post_data; }
+  compression_policy          get_compress_post_data_policy() const { return m_compression_policy; }
+  const compression_settings& get_compression_settings() const { return m_compression_settings; }
+  const ssl_settings&         get_ssl_settings() const { return m_certificates; }
+  const body_handler& get_body_handler() const { return m_body_handler; }
+  const body_generator& get_body_generator() const { return m_body_generator; }
+  std::optional<std::uint64_t> get_body_size() const { return m_body_size; }
+  bool get_auto_accept_encoding() const { return m_auto_accept_encoding; }
+
+  // Copies of the request share the post data, which is never modified
+  const request_body& get_post_data_buffer() const { return m_post_data; }
+
+  // Replaces the post data, or the body generator, with a body which may be shared with other requests, without
+  // copying it
+  void set_post_data(request_body data)
+  {
+    m_post_data      = data ? std::move(data) : std::make_shared<const std::vector<std::uint8_t>>();
+    m_body_generator = nullptr;
+    m_body_size.reset();
+  }
+
+  // Sent before the headers of the request, if it was made from a prepared_request
+  const std::shared_ptr<const prepared_headers>& get_prepared_headers() const { return m_prepared_headers; }
+
+  // The body is not kept in the result when set, nor are the responses cached
+  void set_body_handler(body_handler handler) { m_body_handler = std::move(handler); }
+
+  // Replaces the post data. The body is sent with chunked transfer encoding when its size is unknown
+  void set_body_generator(body_generator generator, std::optional<std::uint64_t> size = {})
+  {
+    m_body_generator = std::move(generator);
+    m_body_size      = size;
+    m_post_data      = std::make_shared<const std::vector<std::uint8_t>>();
+  }
+
+  void set_compression_settings(compression_settings settings) { m_compression_settings = settings; }
+
+  // By default, the request advertises every content encoding the client can decode, unless it already
+  // has an Accept-Encoding header
+  void set_auto_accept_encoding(bool enabled) { m_auto_accept_encoding = enabled; }
 
   http_method                                      m_http_method;
   url                                              m_url;
   std::uint32_t                                    m_timeout_msec;
   ssl_settings                                     m_certificates;
   std::vector<std::pair<std::string, std::string>> m_http_headers;
-  std::vector<std::uint8_t>                        m_post_data;
+  std::shared_ptr<const prepared_headers>          m_prepared_headers;
+  request_body                                     m_post_data;
   compression_policy                               m_compression_policy;
+  compression_settings                             m_compression_settings;
+  body_handler                                     m_body_handler;
+  body_generator                                   m_body_generator;
+  std::optional<std::uint64_t>                     m_body_size;
+  bool                                             m_auto_accept_encoding;
 };
 }  // namespace asio_http
 
@@ -7,6 +7,9 @@
 #ifndef ASIO_HTTP_HTTP_REQUEST_RESULT_H
 #define ASIO_HTTP_HTTP_REQUEST_RESULT_H
 
+#include "asio_http/http_body.h"
+#include "asio_http/http_headers.h"
+
 #include <algorithm>
 #include <cassert>
 #include <cctype>  // tolower
@@ -19,21 +22,21 @@
 
 namespace asio_http
 {
-namespace
-{
-bool iequals(const std::string& a, const std::string& b)
+inline bool iequals(const std::string& a, const std::string& b)
 {
   return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](char a, char b) { return tolower(a) == tolower(b); });
 }
 
-std::string get_header(const std::vector<std::pair<std::string, std::string>>& headers, const std::string& header)
+// Headers of requests. Those of responses are looked up with http_headers::get
+inline std::string get_header(const std::vector<std::pair<std::string, std::string>>& headers,
+                              const std::string&                                      header)
 {
   const auto h =
     std::find_if(std::begin(headers), std::end(headers), [&header](const auto& h) { return iequals(h.first, header); });
 
   return h != std::end(headers) ? h->second : std::string{};
 }
-}  // namespace
+
 struct http_request_stats
 {
   std::chrono::duration<double> name_lookup_time_s;
@@ -42,16 +45,18 @@ struct http_request_stats
   std::int64_t                  avg_upload_speed_bps;
   std::int64_t                  downloaded_bytes;
   std::int64_t                  uploaded_bytes;
+  std::int64_t                  compressed_upload_bytes;  // Size of the request body after compression, if any
+  std::chrono::duration<double> compression_time_s;
 };
 
 class http_request_result
 {
 public:
-  http_request_result(std::uint32_t                                    http_response_code_,
-                      std::vector<std::pair<std::string, std::string>> headers_,
-                      std::vector<std::uint8_t>                        content_,
-                      std::error_code                                  error_,
-                      http_request_stats                               request_stats_)
+  http_request_result(std::uint32_t      http_response_code_,
+                      http_headers       headers_,
+                      http_body          content_,
+                      std::error_code    error_,
+                      http_request_stats request_stats_)
       : http_response_code(http_response_code_)
       , headers(std::move(headers_))
       , content_body(std::move(content_))
@@ -66,13 +71,14 @@ public:
   http_request_result() {}
 
   // Non const to allow move semantics
-  std::uint32_t                                    http_response_code;
-  std::vector<std::pair<std::string, std::string>> headers;
-  std::vector<std::uint8_t>                        content_body;
-  std::error_code                                  error;
-  http_request_stats                               stats;
+  std::uint32_t      http_response_code;
+  http_headers       headers;
+  http_body          content_body;
+  std::error_code    error;
+  http_request_stats stats;
 
-  std::string get_body_as_string() const { return { content_body.begin(), content_body.end() }; }
+  std::string      get_body_as_string() const { return std::string(content_body.view()); }
+  std::string_view get_body_as_string_view() const { return content_body.view(); }
 };
 }  // namespace asio_http
 
@@ -0,0 +1,51 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#ifndef ASIO_HTTP_PREPARED_REQUEST_H
+#define ASIO_HTTP_PREPARED_REQUEST_H
+
+#include "asio_http/http_request.h"
+#include "asio_http/url.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace asio_http
+{
+// Template for the many requests sent to an endpoint with the same headers, e.g. authentication, user agent and
+// tracing headers. The url is parsed and the headers, along with Host, are serialized only once, and every
+// request made from it shares them
+class prepared_request
+{
+public:
+  prepared_request(const std::string&                               base_url,
+                   std::vector<std::pair<std::string, std::string>> headers,
+                   ssl_settings                                     certificates = {},
+                   std::uint32_t                                    timeout_msec = http_request::DEFAULT_TIMEOUT_MSEC);
+
+  // Request to a path of the endpoint, which may carry a query, e.g. "/items?id=1". The headers given here are
+  // sent after the prepared ones
+  http_request make_request(http_method                                      method,
+                            const std::string&                               target,
+                            std::vector<std::uint8_t>                        post_data = {},
+                            compression_policy                               policy    = compression_policy::never,
+                            std::vector<std::pair<std::string, std::string>> headers   = {}) const;
+
+  const url&                                     get_url() const { return m_url; }
+  const std::shared_ptr<const prepared_headers>& get_headers() const { return m_headers; }
+
+private:
+  url                                     m_url;
+  ssl_settings                            m_certificates;
+  std::uint32_t                           m_timeout_msec;
+  std::shared_ptr<const prepared_headers> m_headers;
+};
+}  // namespace asio_http
+
+#endif
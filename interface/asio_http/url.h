@@ -9,15 +9,153 @@
 
 #include <cstdint>
 #include <string>
+#include <string_view>
+#include <tuple>
 
 namespace asio_http
 {
+// Components of a url, as views of the string it was parsed from. Missing components are empty
+struct url_components
+{
+  std::string_view protocol;
+  std::string_view userinfo;  // user[:password]
+  std::string_view host;      // IPv6 literals without their brackets
+  std::string_view path;
+  std::string_view query;     // With its '?'
+  std::string_view fragment;  // With its '#'
+  std::uint16_t    port     = 0;
+  bool             has_port = false;
+  bool             valid    = false;
+};
+
+namespace internal
+{
+constexpr bool is_alphanumeric(char c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+}
+
+constexpr bool all_of(std::string_view str, bool (*predicate)(char))
+{
+  for (const auto c : str)
+  {
+    if (!predicate(c))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+constexpr bool is_scheme_char(char c)
+{
+  return is_alphanumeric(c) || c == '+' || c == '-' || c == '.';
+}
+
+constexpr bool is_host_char(char c)
+{
+  return is_alphanumeric(c) || c == '-' || c == '.' || c == '_' || c == '~' || c == '%';
+}
+
+// Zone ids, after '%', are alphanumeric
+constexpr bool is_ipv6_char(char c)
+{
+  return is_alphanumeric(c) || c == ':' || c == '.' || c == '%';
+}
+
+constexpr bool is_digit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+}  // namespace internal
+
+// Splits a url of the form [protocol://][userinfo@]host[:port][/path][?query][#fragment] in a single pass. It
+// may run at compile time, e.g. constexpr auto components = parse_url("https://[::1]:8443/status");
+constexpr url_components parse_url(std::string_view str)
+{
+  url_components result;
+
+  const auto scheme_end = str.find("://");
+  if (scheme_end != std::string_view::npos && scheme_end != 0 &&
+      internal::all_of(str.substr(0, scheme_end), internal::is_scheme_char))
+  {
+    result.protocol = str.substr(0, scheme_end);
+    str.remove_prefix(scheme_end + 3);
+  }
+
+  const auto authority_end = str.find_first_of("/?#");
+  auto       authority     = str.substr(0, authority_end);
+  str.remove_prefix(authority.size());
+
+  const auto at = authority.rfind('@');
+  if (at != std::string_view::npos)
+  {
+    result.userinfo = authority.substr(0, at);
+    authority.remove_prefix(at + 1);
+  }
+
+  std::string_view port;
+  if (!authority.empty() && authority.front() == '[')
+  {
+    const auto close = authority.find(']');
+    if (close == std::string_view::npos || !internal::all_of(authority.substr(1, close - 1), internal::is_ipv6_char))
+    {
+      return result;
+    }
+    result.host = authority.substr(1, close - 1);
+    authority.remove_prefix(close + 1);
+    if (!authority.empty() && authority.front() != ':')
+    {
+      return result;
+    }
+    port = authority.substr(authority.empty() ? 0 : 1);
+  }
+  else
+  {
+    const auto colon = authority.find(':');
+    result.host      = authority.substr(0, colon);
+    port             = colon != std::string_view::npos ? authority.substr(colon + 1) : std::string_view{};
+    if (!internal::all_of(result.host, internal::is_host_char))
+    {
+      return result;
+    }
+  }
+
+  if (!port.empty())
+  {
+    std::uint32_t number = 0;
+    for (const auto c : port)
+    {
+      number = number * 10 + (c - '0');
+      if (!internal::is_digit(c) || number > UINT16_MAX)
+      {
+        return result;
+      }
+    }
+    result.port     = static_cast<std::uint16_t>(number);
+    result.has_port = true;
+  }
+
+  const auto query_start = str.find_first_of("?#");
+  result.path            = str.substr(0, query_start);
+  str.remove_prefix(result.path.size());
+
+  const auto fragment_start = str.find('#');
+  result.query              = str.substr(0, fragment_start);
+  result.fragment           = str.substr(result.query.size());
+
+  result.valid = !result.host.empty();
+  return result;
+}
+
 class url
 {
 public:
   // Construct a url from a string, which must have the following format:
-  // [protocol://]host[:port][/path][?query]
+  // [protocol://][userinfo@]host[:port][/path][?query][#fragment]
+  // Neither the userinfo nor the fragment are kept, as they are not sent to the server
   explicit url(const std::string& url_string);
+  explicit url(const url_components& components);
 
   url(const std::tuple<std::string, std::string, std::uint16_t, std::string, std::string>& tuple);
   url()        = default;
@@ -27,6 +165,9 @@ public:
 
   std::string to_string() const;
 
+  // Host, with brackets for IPv6 literals, and the port unless it is the default one. As sent in the Host header
+  std::string get_authority() const;
+
   std::string   protocol;
   std::string   host;
   std::string   path;
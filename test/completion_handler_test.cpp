@@ -0,0 +1,127 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#include "asio_http/internal/completion_handler.h"
+
+#include <array>
+#include <gtest/gtest.h>
+#include <memory>
+#include <utility>
+
+namespace asio_http
+{
+namespace internal
+{
+namespace test
+{
+struct allocation_counter
+{
+  int allocations   = 0;
+  int deallocations = 0;
+};
+
+template<typename T>
+struct counting_allocator
+{
+  using value_type = T;
+
+  explicit counting_allocator(allocation_counter& counter)
+      : m_counter(&counter)
+  {
+  }
+  template<typename U>
+  counting_allocator(const counting_allocator<U>& other)
+      : m_counter(other.m_counter)
+  {
+  }
+
+  T* allocate(std::size_t n)
+  {
+    m_counter->allocations++;
+    return std::allocator<T>().allocate(n);
+  }
+  void deallocate(T* p, std::size_t n)
+  {
+    m_counter->deallocations++;
+    std::allocator<T>().deallocate(p, n);
+  }
+
+  allocation_counter* m_counter;
+};
+
+template<typename T, typename U>
+bool operator==(const counting_allocator<T>& a, const counting_allocator<U>& b)
+{
+  return a.m_counter == b.m_counter;
+}
+
+template<typename T, typename U>
+bool operator!=(const counting_allocator<T>& a, const counting_allocator<U>& b)
+{
+  return !(a == b);
+}
+
+// Too large to be stored inline
+struct large_handler
+{
+  using allocator_type = counting_allocator<void>;
+
+  allocator_type get_allocator() const { return m_allocator; }
+  void           operator()(http_request_result result) { *m_code = result.http_response_code; }
+
+  allocator_type                                        m_allocator;
+  int*                                                  m_code;
+  std::array<char, completion_handler::inline_capacity> m_padding;
+};
+
+TEST(completion_handler_test, move_only_inline)
+{
+  int  code = 0;
+  auto ptr  = std::make_unique<int>(200);
+
+  completion_handler handler([&code, ptr = std::move(ptr)](http_request_result result) {
+    code = *ptr + result.http_response_code;
+  });
+  completion_handler moved(std::move(handler));
+  EXPECT_FALSE(handler);
+  EXPECT_TRUE(moved);
+
+  http_request_result result;
+  result.http_response_code = 4;
+  moved(std::move(result));
+  EXPECT_EQ(204, code);
+  EXPECT_FALSE(moved);
+}
+
+TEST(completion_handler_test, associated_allocator)
+{
+  allocation_counter counter;
+  int                code = 0;
+  {
+    completion_handler handler(large_handler{ counting_allocator<void>(counter), &code, {} });
+    EXPECT_EQ(1, counter.allocations);
+
+    completion_handler moved;
+    moved = std::move(handler);
+    EXPECT_EQ(1, counter.allocations);
+
+    http_request_result result;
+    result.http_response_code = 200;
+    moved(std::move(result));
+    EXPECT_EQ(200, code);
+    EXPECT_EQ(1, counter.deallocations);
+  }
+
+  // Never called
+  {
+    completion_handler handler(large_handler{ counting_allocator<void>(counter), &code, {} });
+  }
+  EXPECT_EQ(2, counter.allocations);
+  EXPECT_EQ(2, counter.deallocations);
+}
+}  // namespace test
+}  // namespace internal
+}  // namespace asio_http
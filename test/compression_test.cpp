@@ -0,0 +1,186 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#include "asio_http/compression_dictionary.h"
+#include "asio_http/internal/compression.h"
+
+#include <chrono>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+namespace asio_http
+{
+namespace test
+{
+namespace
+{
+const std::string UNCOMPRESSED_TEXT = "Testing compression\n";
+
+const std::vector<std::uint8_t> BROTLI_TEXT = { 0x1b, 0x13, 0x00, 0xf8, 0x25, 0x14, 0xb2, 0x10,
+                                                0x45, 0x80, 0x29, 0x5f, 0x12, 0xd2, 0xc5, 0x41 };
+
+const std::vector<std::uint8_t> ZSTD_TEXT = { 0x28, 0xb5, 0x2f, 0xfd, 0x04, 0x58, 0xa1, 0x00, 0x00, 0x54, 0x65,
+                                              0x73, 0x74, 0x69, 0x6e, 0x67, 0x20, 0x63, 0x6f, 0x6d, 0x70, 0x72,
+                                              0x65, 0x73, 0x73, 0x69, 0x6f, 0x6e, 0x0a, 0xdf, 0xfd, 0x15, 0x1d };
+
+std::vector<std::uint8_t> get_text()
+{
+  std::string text;
+  for (int i = 0; i < 10000; ++i)
+  {
+    text += "line " + std::to_string(i) + "\n";
+  }
+  return { text.begin(), text.end() };
+}
+
+// Small and similar bodies, as those of a REST API
+std::vector<std::uint8_t> get_record(int id)
+{
+  const auto record = "{\"id\":" + std::to_string(id) + ",\"name\":\"user_" + std::to_string(id * 7919 % 10007) +
+                      "\",\"email\":\"user" + std::to_string(id * 31) + "@example.com\",\"active\":" +
+                      (id % 3 ? "true" : "false") + ",\"roles\":[\"reader\",\"writer\"]}";
+  return { record.begin(), record.end() };
+}
+
+std::vector<std::uint8_t> deflate_data(const std::vector<std::uint8_t>& data, int window_bits)
+{
+  z_stream stream{};
+  deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY);
+
+  std::vector<std::uint8_t> result(deflateBound(&stream, data.size()));
+  stream.next_in   = const_cast<Bytef*>(data.data());
+  stream.avail_in  = data.size();
+  stream.next_out  = result.data();
+  stream.avail_out = result.size();
+  deflate(&stream, Z_FINISH);
+  result.resize(stream.total_out);
+  deflateEnd(&stream);
+
+  return result;
+}
+
+// Fed in small pieces, as received from the network
+std::vector<std::uint8_t>
+decode_data(internal::compression format, const std::vector<std::uint8_t>& data, std::size_t piece_size = 100)
+{
+  const auto                decoder = internal::create_decoder(format);
+  std::vector<std::uint8_t> result;
+  for (std::size_t offset = 0; offset < data.size(); offset += piece_size)
+  {
+    EXPECT_TRUE(
+      decoder->decode(data.data() + offset, std::min<std::size_t>(piece_size, data.size() - offset), result));
+  }
+  EXPECT_TRUE(decoder->finish());
+  return result;
+}
+}  // namespace
+
+TEST(compression_test, incremental_inflate)
+{
+  const auto text = get_text();
+
+  EXPECT_EQ(text, decode_data(internal::compression::gzip, internal::compress(text)));
+  EXPECT_EQ(text, decode_data(internal::compression::deflate, deflate_data(text, MAX_WBITS)));
+
+  // Raw deflate data, without the zlib wrapper
+  EXPECT_EQ(text, decode_data(internal::compression::deflate, deflate_data(text, -MAX_WBITS)));
+
+  // Even when the header arrives a byte at a time
+  EXPECT_EQ(text, decode_data(internal::compression::deflate, deflate_data(text, MAX_WBITS), 1));
+  EXPECT_EQ(text, decode_data(internal::compression::deflate, deflate_data(text, -MAX_WBITS), 1));
+  EXPECT_EQ(text, decode_data(internal::compression::gzip, internal::compress(text), 1));
+}
+
+TEST(compression_test, corrupt_data)
+{
+  const std::vector<std::uint8_t> data(UNCOMPRESSED_TEXT.begin(), UNCOMPRESSED_TEXT.end());
+  std::vector<std::uint8_t>       output;
+
+  EXPECT_FALSE(internal::create_decoder(internal::compression::gzip)->decode(data.data(), data.size(), output));
+#ifdef ASIO_HTTP_HAS_BROTLI
+  EXPECT_FALSE(internal::create_decoder(internal::compression::brotli)->decode(data.data(), data.size(), output));
+#endif
+#ifdef ASIO_HTTP_HAS_ZSTD
+  EXPECT_FALSE(internal::create_decoder(internal::compression::zstd)->decode(data.data(), data.size(), output));
+#endif
+}
+
+TEST(compression_test, truncated_data)
+{
+  const auto is_complete = [](internal::compression format, std::vector<std::uint8_t> data, std::size_t size) {
+    const auto                decoder = internal::create_decoder(format);
+    std::vector<std::uint8_t> output;
+    EXPECT_TRUE(decoder->decode(data.data(), size, output));
+    return decoder->finish();
+  };
+
+  const auto gzip_text = internal::compress(get_text());
+  EXPECT_FALSE(is_complete(internal::compression::gzip, gzip_text, gzip_text.size() / 2));
+  EXPECT_FALSE(is_complete(internal::compression::deflate, deflate_data(get_text(), -MAX_WBITS), 1));
+#ifdef ASIO_HTTP_HAS_BROTLI
+  EXPECT_FALSE(is_complete(internal::compression::brotli, BROTLI_TEXT, BROTLI_TEXT.size() - 4));
+#endif
+#ifdef ASIO_HTTP_HAS_ZSTD
+  EXPECT_FALSE(is_complete(internal::compression::zstd, ZSTD_TEXT, ZSTD_TEXT.size() - 4));
+#endif
+
+  // Bodies may be empty, e.g. those of HEAD requests
+  EXPECT_TRUE(is_complete(internal::compression::gzip, {}, 0));
+}
+
+TEST(compression_test, optional_encodings)
+{
+  const std::vector<std::uint8_t> text(UNCOMPRESSED_TEXT.begin(), UNCOMPRESSED_TEXT.end());
+
+#ifdef ASIO_HTTP_HAS_BROTLI
+  EXPECT_EQ(text, decode_data(internal::compression::brotli, BROTLI_TEXT));
+  EXPECT_NE(std::string::npos, internal::get_accept_encoding().find("br"));
+#else
+  EXPECT_FALSE(internal::create_decoder(internal::compression::brotli));
+#endif
+
+#ifdef ASIO_HTTP_HAS_ZSTD
+  EXPECT_EQ(text, decode_data(internal::compression::zstd, ZSTD_TEXT));
+  EXPECT_NE(std::string::npos, internal::get_accept_encoding().find("zstd"));
+#else
+  EXPECT_FALSE(internal::create_decoder(internal::compression::zstd));
+#endif
+}
+TEST(compression_test, dictionary_compression)
+{
+  std::vector<std::vector<std::uint8_t>> samples;
+  for (int id = 0; id < 1000; ++id)
+  {
+    samples.push_back(get_record(id));
+  }
+  const auto dictionary_data = train_compression_dictionary(samples);
+
+  compression_settings settings;
+  settings.encoding = upload_encoding::zstd;
+  settings.min_size = 0;
+
+#ifdef ASIO_HTTP_HAS_ZSTD
+  ASSERT_FALSE(dictionary_data.empty());
+  const internal::compression_dictionary dictionary(dictionary_data);
+  EXPECT_NE(0, dictionary.get_id());
+  EXPECT_EQ(get_compression_dictionary_id(dictionary_data), dictionary.get_id());
+
+  const auto                    body = get_record(5000);
+  std::chrono::duration<double> time;
+  const auto with_dictionary = internal::compress_body(body, compression_policy::always, settings, &dictionary, time);
+  const auto plain           = internal::compress_body(body, compression_policy::always, settings, nullptr, time);
+  EXPECT_LT(with_dictionary.size(), plain.size());
+  EXPECT_EQ(body, decode_data(internal::compression::zstd, plain));
+  EXPECT_EQ("zstd", internal::get_upload_content_encoding(settings));
+#else
+  EXPECT_TRUE(dictionary_data.empty());
+  EXPECT_EQ("gzip", internal::get_upload_content_encoding(settings));
+#endif
+}
+}  // namespace test
+}  // namespace asio_http
@@ -0,0 +1,121 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#include "asio_http/internal/hpack.h"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace asio_http
+{
+namespace test
+{
+namespace
+{
+using headers_t = std::vector<std::pair<std::string, std::string>>;
+
+std::vector<std::uint8_t> from_hex(const std::string& hex)
+{
+  std::vector<std::uint8_t> bytes;
+  for (std::size_t i = 0; i + 1 < hex.size(); i += 2)
+  {
+    bytes.push_back(static_cast<std::uint8_t>(std::stoul(hex.substr(i, 2), nullptr, 16)));
+  }
+  return bytes;
+}
+
+headers_t decode(internal::hpack_decoder& decoder, const std::string& hex)
+{
+  const auto block = from_hex(hex);
+  headers_t  headers;
+  EXPECT_TRUE(decoder.decode(block.data(), block.size(), headers));
+  return headers;
+}
+}  // namespace
+
+// RFC 7541, C.4: requests with Huffman coding
+TEST(hpack_test, decode_requests)
+{
+  internal::hpack_decoder decoder;
+
+  EXPECT_EQ(headers_t({ { ":method", "GET" },
+                        { ":scheme", "http" },
+                        { ":path", "/" },
+                        { ":authority", "www.example.com" } }),
+            decode(decoder, "828684418cf1e3c2e5f23a6ba0ab90f4ff"));
+  EXPECT_EQ(headers_t({ { ":method", "GET" },
+                        { ":scheme", "http" },
+                        { ":path", "/" },
+                        { ":authority", "www.example.com" },
+                        { "cache-control", "no-cache" } }),
+            decode(decoder, "828684be5886a8eb10649cbf"));
+  EXPECT_EQ(headers_t({ { ":method", "GET" },
+                        { ":scheme", "https" },
+                        { ":path", "/index.html" },
+                        { ":authority", "www.example.com" },
+                        { "custom-key", "custom-value" } }),
+            decode(decoder, "828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf"));
+}
+
+// RFC 7541, C.6: responses with Huffman coding, and evictions from a 256 bytes table
+TEST(hpack_test, decode_responses)
+{
+  internal::hpack_decoder decoder(256);
+
+  EXPECT_EQ(headers_t({ { ":status", "302" },
+                        { "cache-control", "private" },
+                        { "date", "Mon, 21 Oct 2013 20:13:21 GMT" },
+                        { "location", "https://www.example.com" } }),
+            decode(decoder,
+                   "488264025885aec3771a4b6196d07abe941054d444a8200595040b8166e082a62d1bff6e919d29ad171863c78f0b97c8e9ae8"
+                   "2ae43d3"));
+  EXPECT_EQ(headers_t({ { ":status", "307" },
+                        { "cache-control", "private" },
+                        { "date", "Mon, 21 Oct 2013 20:13:21 GMT" },
+                        { "location", "https://www.example.com" } }),
+            decode(decoder, "4883640effc1c0bf"));
+  EXPECT_EQ(headers_t({ { ":status", "200" },
+                        { "cache-control", "private" },
+                        { "date", "Mon, 21 Oct 2013 20:13:22 GMT" },
+                        { "location", "https://www.example.com" },
+                        { "content-encoding", "gzip" },
+                        { "set-cookie", "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1" } }),
+            decode(decoder,
+                   "88c16196d07abe941054d444a8200595040b8166e084a62d1bffc05a839bd9ab77ad94e7821dd7f2e6c7b335dfdfcd5b3960d"
+                   "5af27087f3672c1ab270fb5291f9587316065c003ed4ee5b1063d5007"));
+}
+
+TEST(hpack_test, malformed_block)
+{
+  internal::hpack_decoder decoder;
+  headers_t               headers;
+
+  // Index out of the tables, and string longer than the block
+  const auto unknown_index = from_hex("ff00");
+  EXPECT_FALSE(decoder.decode(unknown_index.data(), unknown_index.size(), headers));
+  const auto truncated = from_hex("400a637573746f6d");
+  EXPECT_FALSE(decoder.decode(truncated.data(), truncated.size(), headers));
+}
+
+TEST(hpack_test, encode)
+{
+  const headers_t headers{ { ":method", "GET" },
+                           { ":path", "/some/path" },
+                           { "accept-encoding", "gzip, deflate" },
+                           { "x-custom", "value" } };
+
+  std::vector<std::uint8_t> block;
+  internal::hpack_encode(headers, block);
+
+  internal::hpack_decoder decoder;
+  headers_t               decoded;
+  EXPECT_TRUE(decoder.decode(block.data(), block.size(), decoded));
+  EXPECT_EQ(headers, decoded);
+}
+}  // namespace test
+}  // namespace asio_http
@@ -0,0 +1,297 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#include "asio_http/future_handler.h"
+#include "asio_http/http_client.h"
+#include "asio_http/internal/hpack.h"
+
+#include <algorithm>
+#include <atomic>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <future>
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace asio_http
+{
+namespace test
+{
+namespace
+{
+using boost::asio::ip::tcp;
+
+const std::string HTTP2_RESPONSE = "This is the HTTP/2 response to ";
+
+enum class server_mode
+{
+  normal,
+  refuse_first_stream,
+  goaway_after_first_stream,  // Once idle, the first connection is pinged and then sent GOAWAY
+  window_overflow             // The window of the first stream is made to exceed 2^31-1 instead of responding
+};
+
+// Cleartext HTTP/2 server with prior knowledge. Every response carries the path of its request. It serves a
+// single connection, but for the GOAWAY mode, where a second one is served after the first one is closed
+class h2c_server
+{
+public:
+  explicit h2c_server(server_mode mode)
+      : m_acceptor(m_context, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0))
+      , m_mode(mode)
+      , m_connections(0)
+      , m_ping_acked(false)
+      , m_thread([this]() {
+        serve();
+        if (m_mode == server_mode::goaway_after_first_stream)
+        {
+          serve();
+        }
+      })
+  {
+  }
+
+  ~h2c_server() { m_thread.join(); }
+
+  std::string get_url(const std::string& path) const
+  {
+    return "http://127.0.0.1:" + std::to_string(m_acceptor.local_endpoint().port()) + path;
+  }
+
+  int  get_connections() const { return m_connections; }
+  bool is_ping_acked() const { return m_ping_acked; }
+
+private:
+  void serve()
+  {
+    tcp::socket socket(m_context);
+    m_acceptor.accept(socket);
+    const bool first_connection = m_connections++ == 0;
+    bool       goaway_sent      = false;
+
+    boost::system::error_code ec;
+    std::vector<std::uint8_t> preface(24);
+    boost::asio::read(socket, boost::asio::buffer(preface), ec);
+
+    write_frame(socket, 0x4, 0, 0, {});
+
+    internal::hpack_decoder decoder;
+    std::vector<std::uint8_t> header(9);
+    while (!ec && boost::asio::read(socket, boost::asio::buffer(header), ec) == header.size())
+    {
+      std::vector<std::uint8_t> payload((header[0] << 16) | (header[1] << 8) | header[2]);
+      boost::asio::read(socket, boost::asio::buffer(payload), ec);
+      const std::uint32_t stream_id = (header[5] << 24) | (header[6] << 16) | (header[7] << 8) | header[8];
+
+      if (header[3] == 0x4 && (header[4] & 0x1) == 0)
+      {
+        write_frame(socket, 0x4, 0x1, 0, {});
+      }
+      else if (header[3] == 0x6 && (header[4] & 0x1) != 0)
+      {
+        // Only the last stream processed, the first one, is completed
+        m_ping_acked = true;
+        write_frame(socket, 0x7, 0, 0, { 0, 0, 0, 1, 0, 0, 0, 0 });
+        goaway_sent = true;
+      }
+      else if (header[3] == 0x1)
+      {
+        std::vector<std::pair<std::string, std::string>> headers;
+        decoder.decode(payload.data(), payload.size(), headers);
+        if (goaway_sent)
+        {
+          continue;
+        }
+        if (m_mode == server_mode::refuse_first_stream && stream_id == 1)
+        {
+          write_frame(socket, 0x3, 0, stream_id, { 0, 0, 0, 0x7 });
+          continue;
+        }
+        if (m_mode == server_mode::window_overflow)
+        {
+          // The stream window grows to the maximum, and then the initial window size by one more byte
+          write_frame(socket, 0x8, 0, stream_id, { 0x7f, 0xff, 0x00, 0x00 });
+          write_frame(socket, 0x4, 0, 0, { 0x0, 0x4, 0x0, 0x1, 0x0, 0x0 });
+          continue;
+        }
+
+        std::vector<std::uint8_t> block;
+        internal::hpack_encode({ { ":status", "200" }, { "content-type", "text/plain" } }, block);
+        write_frame(socket, 0x1, 0x4, stream_id, block);
+
+        const auto path = std::find_if(headers.begin(), headers.end(), [](auto& h) { return h.first == ":path"; });
+        const auto body = HTTP2_RESPONSE + path->second;
+        write_frame(socket, 0x0, 0x1, stream_id, std::vector<std::uint8_t>(body.begin(), body.end()));
+
+        if (m_mode == server_mode::goaway_after_first_stream && first_connection)
+        {
+          // The client is expected to be reading while idle
+          std::this_thread::sleep_for(std::chrono::milliseconds(100));
+          write_frame(socket, 0x6, 0, 0, { 1, 2, 3, 4, 5, 6, 7, 8 });
+        }
+      }
+    }
+  }
+
+  void write_frame(tcp::socket&                     socket,
+                   std::uint8_t                     type,
+                   std::uint8_t                     flags,
+                   std::uint32_t                    stream_id,
+                   const std::vector<std::uint8_t>& payload)
+  {
+    std::vector<std::uint8_t> frame{ std::uint8_t(payload.size() >> 16),
+                                     std::uint8_t(payload.size() >> 8),
+                                     std::uint8_t(payload.size()),
+                                     type,
+                                     flags,
+                                     std::uint8_t(stream_id >> 24),
+                                     std::uint8_t(stream_id >> 16),
+                                     std::uint8_t(stream_id >> 8),
+                                     std::uint8_t(stream_id) };
+    frame.insert(frame.end(), payload.begin(), payload.end());
+
+    boost::system::error_code ec;
+    boost::asio::write(socket, boost::asio::buffer(frame), ec);
+  }
+
+  boost::asio::io_context m_context;
+  tcp::acceptor           m_acceptor;
+  server_mode             m_mode;
+  std::atomic<int>        m_connections;
+  std::atomic<bool>       m_ping_acked;
+  std::thread             m_thread;
+};
+
+http_client_settings get_http2_settings()
+{
+  http_client_settings settings;
+  settings.http2 = true;
+  return settings;
+}
+
+// Idle connections keep reading, so the io_context only runs out of work once the client is destroyed
+void run_until_ready(boost::asio::io_context& io_context, std::vector<std::future<http_request_result>>& futures)
+{
+  for (auto& future : futures)
+  {
+    while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+      io_context.restart();
+      io_context.run_one();
+    }
+  }
+}
+}  // namespace
+
+TEST(http2_test, multiplexed_requests)
+{
+  const std::size_t num_requests = 20;
+
+  h2c_server              server(server_mode::normal);
+  boost::asio::io_context io_context;
+  auto                    client = std::make_unique<http_client>(get_http2_settings(), io_context);
+
+  std::vector<std::future<http_request_result>> futures;
+  for (std::size_t i = 0; i < num_requests; ++i)
+  {
+    futures.push_back(client->get(use_std_future, server.get_url("/resource" + std::to_string(i)), "token"));
+  }
+
+  run_until_ready(io_context, futures);
+
+  for (std::size_t i = 0; i < num_requests; ++i)
+  {
+    auto result = futures[i].get();
+    EXPECT_FALSE(result.error);
+    EXPECT_EQ(200, result.http_response_code);
+    EXPECT_EQ(HTTP2_RESPONSE + "/resource" + std::to_string(i), result.get_body_as_string());
+  }
+
+  // All of them share a connection
+  EXPECT_EQ(1, client->get_stats().connections);
+
+  // Destroying the client closes its idle connection
+  client.reset();
+  io_context.restart();
+  io_context.run();
+}
+
+TEST(http2_test, refused_stream_retried)
+{
+  h2c_server              server(server_mode::refuse_first_stream);
+  boost::asio::io_context io_context;
+  auto                    client = std::make_unique<http_client>(get_http2_settings(), io_context);
+
+  std::vector<std::future<http_request_result>> futures;
+  futures.push_back(client->get(use_std_future, server.get_url("/refused?attempt=1"), "token"));
+
+  run_until_ready(io_context, futures);
+
+  auto result = futures[0].get();
+  EXPECT_FALSE(result.error);
+  EXPECT_EQ(HTTP2_RESPONSE + "/refused?attempt=1", result.get_body_as_string());
+  EXPECT_EQ(1, client->get_stats().connections);
+
+  client.reset();
+  io_context.restart();
+  io_context.run();
+}
+
+TEST(http2_test, goaway_on_idle_connection)
+{
+  h2c_server              server(server_mode::goaway_after_first_stream);
+  boost::asio::io_context io_context;
+  auto                    client = std::make_unique<http_client>(get_http2_settings(), io_context);
+
+  std::vector<std::future<http_request_result>> futures;
+  futures.push_back(client->get(use_std_future, server.get_url("/first"), "token"));
+  run_until_ready(io_context, futures);
+
+  // The PING arrives while the connection is idle, and is followed by GOAWAY
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (!server.is_ping_acked() && std::chrono::steady_clock::now() < deadline)
+  {
+    io_context.restart();
+    io_context.run_one_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_TRUE(server.is_ping_acked());
+
+  futures.push_back(client->get(use_std_future, server.get_url("/second"), "token"));
+  run_until_ready(io_context, futures);
+
+  EXPECT_EQ(HTTP2_RESPONSE + "/first", futures[0].get().get_body_as_string());
+  auto result = futures[1].get();
+  EXPECT_FALSE(result.error);
+  EXPECT_EQ(HTTP2_RESPONSE + "/second", result.get_body_as_string());
+  EXPECT_EQ(2, server.get_connections());
+
+  client.reset();
+  io_context.restart();
+  io_context.run();
+}
+
+TEST(http2_test, initial_window_size_overflow)
+{
+  h2c_server              server(server_mode::window_overflow);
+  boost::asio::io_context io_context;
+  auto                    client = std::make_unique<http_client>(get_http2_settings(), io_context);
+
+  std::vector<std::future<http_request_result>> futures;
+  futures.push_back(client->get(use_std_future, server.get_url("/overflow"), "token"));
+  run_until_ready(io_context, futures);
+
+  EXPECT_EQ(make_error_code(http2_error::flow_control_error), futures[0].get().error);
+
+  client.reset();
+  io_context.restart();
+  io_context.run();
+}
+}  // namespace test
+}  // namespace asio_http
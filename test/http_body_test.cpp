@@ -0,0 +1,58 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#include "asio_http/http_body.h"
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace asio_http
+{
+namespace test
+{
+namespace
+{
+bool is_inline(const http_body& body)
+{
+  const auto begin = reinterpret_cast<const std::uint8_t*>(&body);
+  return body.data() >= begin && body.data() < begin + sizeof(body);
+}
+}  // namespace
+
+TEST(http_body_test, small_body_inline)
+{
+  const std::string json = "{\"status\":\"ok\"}";
+  const http_body   body(std::vector<std::uint8_t>(json.begin(), json.end()));
+  const http_body   copy = body;
+  EXPECT_TRUE(is_inline(body));
+  EXPECT_TRUE(is_inline(copy));
+  EXPECT_EQ(json, copy.view());
+  EXPECT_TRUE(http_body().empty());
+}
+
+TEST(http_body_test, large_body_shared)
+{
+  const std::vector<std::uint8_t> data(http_body::inline_capacity + 1, 'x');
+  http_body                       body(std::vector<std::uint8_t>(data.begin(), data.end()));
+  const http_body                 copy = body;
+  EXPECT_FALSE(is_inline(body));
+  EXPECT_EQ(body.data(), copy.data());
+  EXPECT_EQ(data, copy);
+
+  const http_body moved = std::move(body);
+  EXPECT_EQ(copy.data(), moved.data());
+  EXPECT_TRUE(body.empty());
+
+  // Buffers owned elsewhere, like cached responses, are shared as well
+  const auto      buffer = std::make_shared<const std::vector<std::uint8_t>>(data);
+  const http_body cached(std::shared_ptr<const std::uint8_t>(buffer, buffer->data()), buffer->size());
+  EXPECT_EQ(buffer->data(), cached.data());
+}
+}  // namespace test
+}  // namespace asio_http
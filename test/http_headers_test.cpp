@@ -0,0 +1,76 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#include "asio_http/http_headers.h"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace asio_http
+{
+namespace test
+{
+TEST(http_headers_test, parsed_pieces)
+{
+  // As split by the parser across reads
+  http_headers headers;
+  headers.append_name("Content-");
+  headers.append_name("Type");
+  headers.append_value("text/");
+  headers.append_value("plain  \r\n");
+  headers.append_name("ETag");
+  headers.append_value("\"v1\"");
+  headers.add("X-Empty", "");
+
+  ASSERT_EQ(3, headers.size());
+  EXPECT_EQ("Content-Type", headers[0].first);
+  EXPECT_EQ("text/plain", headers[0].second);
+  EXPECT_EQ("ETag", headers[1].first);
+  EXPECT_EQ("\"v1\"", headers[1].second);
+  EXPECT_EQ("X-Empty", headers[2].first);
+  EXPECT_TRUE(headers[2].second.empty());
+}
+
+TEST(http_headers_test, lookup)
+{
+  const std::vector<std::pair<std::string, std::string>> vector = { { "Content-Length", "10" },
+                                                                    { "Set-Cookie", "a=1" },
+                                                                    { "set-cookie", "b=2" } };
+  const http_headers headers(vector);
+
+  EXPECT_EQ("10", headers.get("content-length"));
+  EXPECT_EQ("a=1", headers.get("SET-COOKIE"));
+  EXPECT_TRUE(headers.get("Location").empty());
+  EXPECT_EQ(vector, headers.to_vector());
+  EXPECT_EQ(3, std::distance(headers.begin(), headers.end()));
+}
+
+TEST(http_headers_test, well_known_headers)
+{
+  http_headers headers;
+  headers.append_name("X-Custom");
+  headers.append_value("1");
+  headers.append_name("cONTENT-");
+  headers.append_name("length");
+  headers.append_value("42");
+  headers.add("Location", "/first");
+  headers.add("LOCATION", "/second");
+
+  EXPECT_EQ("42", headers.get(http_header::content_length));
+  EXPECT_EQ("42", headers.get("Content-Length"));
+  EXPECT_EQ("/first", headers.get(http_header::location));
+  EXPECT_EQ("1", headers.get("x-custom"));
+  EXPECT_TRUE(headers.get(http_header::content_encoding).empty());
+  EXPECT_TRUE(headers.get(http_header::other).empty());
+
+  // Copies keep the resolved headers
+  const auto copy = headers;
+  EXPECT_EQ("/first", copy.get(http_header::location));
+}
+}  // namespace test
+}  // namespace asio_http
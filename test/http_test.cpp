@@ -6,14 +6,22 @@
 
 #include "http_test_base.h"
 
+#include "asio_http/compression_dictionary.h"
 #include "asio_http/error.h"
 #include "asio_http/future_handler.h"
 #include "asio_http/http_request.h"
+#include "asio_http/internal/compression.h"
+#include "asio_http/prepared_request.h"
 
 #include <boost/system/error_code.hpp>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
 #include <gtest/gtest.h>
 #include <memory>
+#include <random>
 #include <system_error>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -42,6 +50,15 @@ TEST_F(http_test, get_request)
             }));
 }
 
+TEST_F(http_test, request_line_with_query)
+{
+  const std::string target = REQUEST_LINE_RESOURCE + "?name=value&other=%20";
+  auto              reply  = m_http_client->get(use_std_future, get_url(target), HTTP_CANCELLATION_TOKEN).get();
+
+  EXPECT_FALSE(reply.error);
+  EXPECT_EQ("GET " + target + " HTTP/1.1", reply.get_body_as_string());
+}
+
 TEST_F(http_test, head_request)
 {
   http_request request{ http_method::HEAD, url(get_url(GET_RESOURCE)), 120000, {}, {}, {}, compression_policy::never };
@@ -72,6 +89,205 @@ TEST_F(http_test, post_request)
   EXPECT_EQ(postdata, reply.get_body_as_string());
 }
 
+TEST_F(http_test, shared_post_data)
+{
+  std::string postdata(256 * 1024, 'a');
+  for (std::size_t i = 0; i < postdata.size(); ++i)
+  {
+    postdata[i] += i % 26;
+  }
+  const auto body = std::make_shared<const std::vector<std::uint8_t>>(postdata.begin(), postdata.end());
+
+  // Both requests send the same buffer
+  std::vector<std::future<http_request_result>> futures;
+  for (int i = 0; i < 2; ++i)
+  {
+    http_request request{ http_method::POST,
+                          url(get_url(ECHO_RESOURCE)),
+                          http_request::DEFAULT_TIMEOUT_MSEC,
+                          {},
+                          {},
+                          {},
+                          compression_policy::never };
+    // The generator is replaced as well
+    request.set_body_generator([](std::uint8_t*, std::size_t) { return std::size_t(0); }, 0);
+    request.set_post_data(body);
+    EXPECT_EQ(body, request.get_post_data_buffer());
+    EXPECT_FALSE(request.get_body_generator());
+    futures.push_back(m_http_client->execute_request(use_std_future, std::move(request), HTTP_CANCELLATION_TOKEN));
+  }
+
+  for (auto& future : futures)
+  {
+    const auto reply = future.get();
+    EXPECT_FALSE(reply.error);
+    EXPECT_EQ(postdata, reply.get_body_as_string());
+  }
+}
+
+TEST_F(http_test, prepared_requests)
+{
+  const prepared_request endpoint(HOST, { { "Accept-Encoding", "identity" }, { "User-Agent", "asio_http" } });
+
+  // The prepared Accept-Encoding is not overridden
+  auto reply = m_http_client
+                 ->execute_request(use_std_future,
+                                   endpoint.make_request(http_method::GET, ACCEPT_ENCODING_RESOURCE),
+                                   HTTP_CANCELLATION_TOKEN)
+                 .get();
+  EXPECT_FALSE(reply.error);
+  EXPECT_EQ("identity", reply.get_body_as_string());
+
+  reply = m_http_client
+            ->execute_request(use_std_future,
+                              endpoint.make_request(http_method::GET, REQUEST_LINE_RESOURCE + "?id=2"),
+                              HTTP_CANCELLATION_TOKEN)
+            .get();
+  EXPECT_FALSE(reply.error);
+  EXPECT_EQ("GET " + REQUEST_LINE_RESOURCE + "?id=2 HTTP/1.1", reply.get_body_as_string());
+
+  const std::string postdata = "some post data";
+  auto              post     = endpoint.make_request(http_method::POST,
+                                          ECHO_RESOURCE,
+                                          { postdata.begin(), postdata.end() },
+                                          compression_policy::never,
+                                          { { "Content-Type", "text/plain" } });
+  reply = m_http_client->execute_request(use_std_future, std::move(post), HTTP_CANCELLATION_TOKEN).get();
+  EXPECT_FALSE(reply.error);
+  EXPECT_EQ(postdata, reply.get_body_as_string());
+}
+
+TEST_F(http_test, compressed_post_request)
+{
+  std::vector<std::uint8_t> text(20000);
+  for (std::size_t i = 0; i < text.size(); ++i)
+  {
+    text[i] = 'a' + i % 26;
+  }
+  std::vector<std::uint8_t> noise(20000);
+  std::generate(noise.begin(), noise.end(), std::minstd_rand());
+
+  const auto post = [this](const std::vector<std::uint8_t>& data) {
+    http_request request{ http_method::POST,
+                          url(get_url(ECHO_RESOURCE)),
+                          http_request::DEFAULT_TIMEOUT_MSEC,
+                          {},
+                          {},
+                          data,
+                          compression_policy::when_better };
+    return m_http_client->execute_request(use_std_future, std::move(request), HTTP_CANCELLATION_TOKEN).get();
+  };
+
+  // The server echoes the compressed body
+  auto reply = post(text);
+  EXPECT_FALSE(reply.error);
+  EXPECT_LT(0, reply.stats.compressed_upload_bytes);
+  EXPECT_EQ(reply.stats.compressed_upload_bytes, reply.content_body.size());
+  std::vector<std::uint8_t> decoded;
+  internal::create_decoder(internal::compression::gzip)
+    ->decode(reply.content_body.data(), reply.content_body.size(), decoded);
+  EXPECT_EQ(text, decoded);
+
+  // Random data is not even tried
+  reply = post(noise);
+  EXPECT_FALSE(reply.error);
+  EXPECT_EQ(0, reply.stats.compressed_upload_bytes);
+  EXPECT_EQ(0, reply.stats.compression_time_s.count());
+  EXPECT_EQ(noise, reply.content_body);
+}
+
+#ifdef ASIO_HTTP_HAS_ZSTD
+TEST_F(http_test, dictionary_compressed_post_request)
+{
+  const auto record = [](int id) {
+    const auto str = "{\"id\":" + std::to_string(id) + ",\"name\":\"user_" + std::to_string(id * 7919 % 10007) +
+                     "\",\"active\":" + (id % 3 ? "true" : "false") + "}";
+    return std::vector<std::uint8_t>(str.begin(), str.end());
+  };
+  std::vector<std::vector<std::uint8_t>> samples;
+  for (int id = 0; id < 1000; ++id)
+  {
+    samples.push_back(record(id));
+  }
+
+  http_client_settings settings;
+  settings.compression_dictionaries.push_back(train_compression_dictionary(samples));
+  m_http_client.reset(new http_client(settings, m_test_io_context));
+
+  compression_settings compression;
+  compression.encoding      = upload_encoding::zstd;
+  compression.dictionary_id = get_compression_dictionary_id(settings.compression_dictionaries.front());
+  compression.min_size      = 0;
+  http_request request{ http_method::POST,
+                        url(get_url(ECHO_RESOURCE)),
+                        http_request::DEFAULT_TIMEOUT_MSEC,
+                        {},
+                        {},
+                        record(5000),
+                        compression_policy::when_better };
+  request.set_compression_settings(compression);
+
+  // The server echoes the zstd frame
+  auto reply = m_http_client->execute_request(use_std_future, std::move(request), HTTP_CANCELLATION_TOKEN).get();
+  EXPECT_FALSE(reply.error);
+  EXPECT_LT(0, reply.stats.compressed_upload_bytes);
+  EXPECT_EQ(reply.stats.compressed_upload_bytes, reply.content_body.size());
+  EXPECT_EQ(std::vector<std::uint8_t>({ 0x28, 0xb5, 0x2f, 0xfd }),
+            std::vector<std::uint8_t>(reply.content_body.begin(), reply.content_body.begin() + 4));
+}
+#endif
+
+TEST_F(http_test, generated_post_request)
+{
+  std::string postdata;
+  for (int i = 0; i < 3000; ++i)
+  {
+    postdata.push_back('a' + i % 26);
+  }
+
+  http_request request{
+    http_method::POST, url(get_url(ECHO_RESOURCE)), http_request::DEFAULT_TIMEOUT_MSEC, {}, {}, {},
+    compression_policy::never
+  };
+  // Pulled in pieces smaller than the write buffer, and sent as chunks as the size is not given
+  request.set_body_generator([&postdata, offset = std::size_t(0)](std::uint8_t* buffer, std::size_t size) mutable {
+    const auto count = std::min<std::size_t>({ size, 700, postdata.size() - offset });
+    std::copy(postdata.begin() + offset, postdata.begin() + offset + count, buffer);
+    offset += count;
+    return count;
+  });
+
+  auto reply = m_http_client->execute_request(use_std_future, std::move(request), HTTP_CANCELLATION_TOKEN).get();
+
+  EXPECT_FALSE(reply.error);
+  EXPECT_EQ(200, reply.http_response_code);
+  EXPECT_EQ(postdata, reply.get_body_as_string());
+}
+
+TEST_F(http_test, generated_post_request_size_mismatch)
+{
+  for (const std::size_t declared_size : { 2000, 4000 })
+  {
+    http_request request{
+      http_method::POST, url(get_url(ECHO_RESOURCE)), http_request::DEFAULT_TIMEOUT_MSEC, {}, {}, {},
+      compression_policy::never
+    };
+    // 3000 bytes, more or fewer than the given size
+    request.set_body_generator(
+      [remaining = std::size_t(3000)](std::uint8_t* buffer, std::size_t size) mutable {
+        const auto count = std::min(size, remaining);
+        std::fill_n(buffer, count, 'a');
+        remaining -= count;
+        return count;
+      },
+      declared_size);
+
+    auto reply = m_http_client->execute_request(use_std_future, std::move(request), HTTP_CANCELLATION_TOKEN).get();
+
+    EXPECT_EQ(make_error_code(client_error::body_size_mismatch), reply.error);
+  }
+}
+
 TEST_F(http_test, timeout)
 {
   // Request with 1 second timeout
@@ -211,6 +427,32 @@ TEST_F(http_test, redirected_request)
             }));
 }
 
+TEST_F(http_test, redirected_compressed_post_request)
+{
+  std::vector<std::uint8_t> text(20000);
+  for (std::size_t i = 0; i < text.size(); ++i)
+  {
+    text[i] = 'a' + i % 26;
+  }
+  http_request request{ http_method::POST,
+                        url(get_url(REDIRECTION_RESOURCE)),
+                        http_request::DEFAULT_TIMEOUT_MSEC,
+                        {},
+                        {},
+                        text,
+                        compression_policy::always };
+
+  // Copies of the request share its body
+  EXPECT_EQ(http_request(request).get_post_data_buffer(), request.get_post_data_buffer());
+
+  // The body compressed for the first request is sent again to the new location
+  auto reply = m_http_client->execute_request(use_std_future, std::move(request), HTTP_CANCELLATION_TOKEN).get();
+  EXPECT_FALSE(reply.error);
+  EXPECT_EQ(GET_RESPONSE, reply.get_body_as_string());
+  EXPECT_LT(0, reply.stats.compressed_upload_bytes);
+  EXPECT_LT(0, reply.stats.compression_time_s.count());
+}
+
 TEST_F(http_test, compressed_response)
 {
   http_request_result reply =
@@ -221,5 +463,261 @@ TEST_F(http_test, compressed_response)
   EXPECT_EQ(UNCOMPRESSED_TEXT, reply.get_body_as_string());
 }
 
+TEST_F(http_test, offloaded_compression)
+{
+  boost::asio::thread_pool worker(2);
+  http_client_settings     settings;
+  settings.worker_executor   = worker.get_executor();
+  settings.offload_threshold = 1;
+  m_http_client.reset(new http_client(settings, m_test_io_context));
+
+  // The response is decoded on the worker
+  auto reply = m_http_client->get(use_std_future, get_url(COMPRESSED_RESOURCE), HTTP_CANCELLATION_TOKEN).get();
+  EXPECT_FALSE(reply.error);
+  EXPECT_EQ(UNCOMPRESSED_TEXT, reply.get_body_as_string());
+
+  // And the request body is compressed there
+  std::vector<std::uint8_t> text(20000);
+  for (std::size_t i = 0; i < text.size(); ++i)
+  {
+    text[i] = 'a' + i % 26;
+  }
+  http_request request{ http_method::POST,
+                        url(get_url(ECHO_RESOURCE)),
+                        http_request::DEFAULT_TIMEOUT_MSEC,
+                        {},
+                        {},
+                        text,
+                        compression_policy::always };
+  reply = m_http_client->execute_request(use_std_future, std::move(request), HTTP_CANCELLATION_TOKEN).get();
+  EXPECT_FALSE(reply.error);
+  EXPECT_LT(0, reply.stats.compressed_upload_bytes);
+  EXPECT_EQ(reply.stats.compressed_upload_bytes, reply.content_body.size());
+  std::vector<std::uint8_t> decoded;
+  internal::create_decoder(internal::compression::gzip)
+    ->decode(reply.content_body.data(), reply.content_body.size(), decoded);
+  EXPECT_EQ(text, decoded);
+
+  m_http_client.reset();
+  worker.join();
+}
+
+TEST_F(http_test, corrupted_response)
+{
+  auto reply = m_http_client->get(use_std_future, get_url(CORRUPTED_RESOURCE), HTTP_CANCELLATION_TOKEN).get();
+  EXPECT_EQ(make_error_code(client_error::decoding_error), reply.error);
+
+  // The connection is still usable
+  reply = m_http_client->get(use_std_future, get_url(GET_RESOURCE), HTTP_CANCELLATION_TOKEN).get();
+  EXPECT_FALSE(reply.error);
+  EXPECT_EQ(GET_RESPONSE, reply.get_body_as_string());
+
+  // Also when decoded on a worker
+  boost::asio::thread_pool worker(2);
+  http_client_settings     settings;
+  settings.worker_executor   = worker.get_executor();
+  settings.offload_threshold = 1;
+  m_http_client.reset(new http_client(settings, m_test_io_context));
+
+  reply = m_http_client->get(use_std_future, get_url(CORRUPTED_RESOURCE), HTTP_CANCELLATION_TOKEN).get();
+  EXPECT_EQ(make_error_code(client_error::decoding_error), reply.error);
+
+  m_http_client.reset();
+  worker.join();
+}
+
+TEST_F(http_test, truncated_response)
+{
+  // The body is complete as far as HTTP is concerned, but the gzip data stops short
+  auto reply = m_http_client->get(use_std_future, get_url(TRUNCATED_RESOURCE), HTTP_CANCELLATION_TOKEN).get();
+  EXPECT_EQ(make_error_code(client_error::decoding_error), reply.error);
+
+  boost::asio::thread_pool worker(2);
+  http_client_settings     settings;
+  settings.worker_executor   = worker.get_executor();
+  settings.offload_threshold = 1;
+  m_http_client.reset(new http_client(settings, m_test_io_context));
+
+  reply = m_http_client->get(use_std_future, get_url(TRUNCATED_RESOURCE), HTTP_CANCELLATION_TOKEN).get();
+  EXPECT_EQ(make_error_code(client_error::decoding_error), reply.error);
+
+  m_http_client.reset();
+  worker.join();
+}
+
+TEST_F(http_test, accept_encoding)
+{
+  auto reply = m_http_client->get(use_std_future, get_url(ACCEPT_ENCODING_RESOURCE), HTTP_CANCELLATION_TOKEN).get();
+
+  EXPECT_FALSE(reply.error);
+  EXPECT_EQ(internal::get_accept_encoding(), reply.get_body_as_string());
+
+  // Opted out
+  http_request request{ http_method::GET,
+                        url(get_url(ACCEPT_ENCODING_RESOURCE)),
+                        http_request::DEFAULT_TIMEOUT_MSEC,
+                        {},
+                        {},
+                        {},
+                        compression_policy::never };
+  request.set_auto_accept_encoding(false);
+  reply = m_http_client->execute_request(use_std_future, std::move(request), HTTP_CANCELLATION_TOKEN).get();
+
+  EXPECT_FALSE(reply.error);
+  EXPECT_EQ("none", reply.get_body_as_string());
+}
+
+TEST_F(http_test, streamed_response)
+{
+  std::string  body;
+  http_request request{
+    http_method::GET, url(get_url(COMPRESSED_RESOURCE)), http_request::DEFAULT_TIMEOUT_MSEC, {}, {}, {},
+    compression_policy::never
+  };
+  request.set_body_handler([&body](std::vector<std::uint8_t> chunk) { body.append(chunk.begin(), chunk.end()); });
+
+  http_request_result reply =
+    m_http_client->execute_request(use_std_future, std::move(request), HTTP_CANCELLATION_TOKEN).get();
+
+  // The body is decoded as it arrives and not kept in the result
+  EXPECT_FALSE(reply.error);
+  EXPECT_EQ(200, reply.http_response_code);
+  EXPECT_TRUE(reply.content_body.empty());
+  EXPECT_EQ(UNCOMPRESSED_TEXT, body);
+}
+
+TEST_F(http_test, streamed_response_slow_handler)
+{
+  std::string postdata;
+  for (int i = 0; i < 64 * 1024; ++i)
+  {
+    postdata.push_back('a' + i % 26);
+  }
+
+  std::string  body;
+  std::size_t  chunks = 0;
+  http_request request{
+    http_method::POST,
+    url(get_url(ECHO_RESOURCE)),
+    http_request::DEFAULT_TIMEOUT_MSEC,
+    {},
+    {},
+    std::vector<std::uint8_t>(postdata.begin(), postdata.end()),
+    compression_policy::never
+  };
+  // Far slower than the transfer, the connection stops reading until the handler catches up
+  request.set_body_handler([&body, &chunks](std::vector<std::uint8_t> chunk) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    body.append(chunk.begin(), chunk.end());
+    chunks++;
+  });
+
+  http_request_result reply =
+    m_http_client->execute_request(use_std_future, std::move(request), HTTP_CANCELLATION_TOKEN).get();
+
+  EXPECT_FALSE(reply.error);
+  EXPECT_EQ(200, reply.http_response_code);
+  EXPECT_LT(1, chunks);
+  EXPECT_EQ(postdata, body);
+}
+
+TEST_F(http_test, cached_response)
+{
+  http_client_settings settings;
+  settings.cache_max_size = 1024 * 1024;
+  m_http_client.reset(new http_client(settings, m_test_io_context));
+
+  for (int i = 0; i < 3; ++i)
+  {
+    http_request_result reply =
+      m_http_client->get(use_std_future, get_url(CACHEABLE_RESOURCE), HTTP_CANCELLATION_TOKEN).get();
+
+    EXPECT_FALSE(reply.error);
+    EXPECT_EQ(200, reply.http_response_code);
+    EXPECT_EQ(GET_RESPONSE, reply.get_body_as_string());
+  }
+
+  // Only the first request reaches the server
+  const auto stats = m_http_client->get_stats();
+  EXPECT_EQ(2, stats.cache_hits);
+  EXPECT_EQ(0, stats.cache_revalidations);
+}
+
+TEST_F(http_test, revalidated_response)
+{
+  http_client_settings settings;
+  settings.cache_max_size = 1024 * 1024;
+  m_http_client.reset(new http_client(settings, m_test_io_context));
+
+  for (int i = 0; i < 3; ++i)
+  {
+    http_request_result reply =
+      m_http_client->get(use_std_future, get_url(VALIDATED_RESOURCE), HTTP_CANCELLATION_TOKEN).get();
+
+    EXPECT_FALSE(reply.error);
+    EXPECT_EQ(200, reply.http_response_code);
+    EXPECT_EQ(GET_RESPONSE, reply.get_body_as_string());
+  }
+
+  // The server replies 304 Not Modified to the conditional requests
+  const auto stats = m_http_client->get_stats();
+  EXPECT_EQ(0, stats.cache_hits);
+  EXPECT_EQ(2, stats.cache_revalidations);
+}
+
+TEST_F(http_test, persistent_cached_response)
+{
+  const auto path = (std::filesystem::temp_directory_path() / "asio_http_disk_cache_test").string();
+  std::filesystem::remove_all(path);
+
+  http_client_settings settings;
+  settings.disk_cache_path = path;
+
+  for (int i = 0; i < 2; ++i)
+  {
+    // A new client, as after a process restart, must find the responses stored by the previous one
+    m_http_client.reset(new http_client(settings, m_test_io_context));
+
+    http_request_result reply =
+      m_http_client->get(use_std_future, get_url(CACHEABLE_RESOURCE), HTTP_CANCELLATION_TOKEN).get();
+
+    EXPECT_FALSE(reply.error);
+    EXPECT_EQ(200, reply.http_response_code);
+    EXPECT_EQ(GET_RESPONSE, reply.get_body_as_string());
+    EXPECT_EQ(i, m_http_client->get_stats().cache_hits);
+  }
+
+  m_http_client.reset();
+  std::filesystem::remove_all(path);
+}
+
+TEST_F(http_test, persistent_cache_unusable_directory)
+{
+  const auto path = std::filesystem::temp_directory_path() / "asio_http_disk_cache_test";
+  std::filesystem::remove_all(path);
+  std::filesystem::create_directories(path);
+  // Files which are not segments are ignored
+  std::ofstream(path / "segment-x.dat") << "x";
+  std::ofstream(path / "segment-.dat") << "x";
+  // A file where the directory should be, the client runs without a disk tier
+  std::ofstream(path / "file") << "x";
+
+  for (const auto& cache_path : { path, path / "file" / "cache" })
+  {
+    http_client_settings settings;
+    settings.disk_cache_path = cache_path.string();
+    m_http_client.reset(new http_client(settings, m_test_io_context));
+
+    http_request_result reply =
+      m_http_client->get(use_std_future, get_url(CACHEABLE_RESOURCE), HTTP_CANCELLATION_TOKEN).get();
+
+    EXPECT_FALSE(reply.error);
+    EXPECT_EQ(GET_RESPONSE, reply.get_body_as_string());
+  }
+
+  m_http_client.reset();
+  std::filesystem::remove_all(path);
+}
+
 }  // namespace test
 }  // namespace asio_http
@@ -33,6 +33,13 @@ const std::string POST_RESOURCE                     = "/post";
 const std::string CONNECTION_CLOSE_RESOURCE         = "/close";
 const std::string REDIRECTION_RESOURCE              = "/redirect";
 const std::string COMPRESSED_RESOURCE               = "/compressed";
+const std::string CORRUPTED_RESOURCE                = "/corrupted";
+const std::string TRUNCATED_RESOURCE                = "/truncated";
+const std::string CACHEABLE_RESOURCE                = "/cacheable";
+const std::string VALIDATED_RESOURCE                = "/validated";
+const std::string RESOURCE_ETAG                     = "\"v1\"";
+const std::string ACCEPT_ENCODING_RESOURCE          = "/accept_encoding";
+const std::string REQUEST_LINE_RESOURCE             = "/request_line";
 
 const std::string HTTP_CANCELLATION_TOKEN = "asio_httpTest";
 
@@ -77,7 +84,7 @@ const std::function<void(std::shared_ptr<test_server::web_client>)> echo_handler
   [](std::shared_ptr<test_server::web_client> client_data) {
     client_data->response_printf("Content-type: text/plain\r\n\r\n");
     const auto data = client_data->get_post_data();
-    client_data->response_printf(std::string(data.begin(), data.end()).c_str());
+    client_data->m_response_buffer.insert(std::end(client_data->m_response_buffer), data.begin(), data.end());
   };
 
 const std::function<void(std::shared_ptr<test_server::web_client>)> compressed_handler =
@@ -86,6 +93,55 @@ const std::function<void(std::shared_ptr<test_server::web_client>)> compressed_h
     client_data->m_response_buffer.insert(
       std::end(client_data->m_response_buffer), COMPRESSED_TEXT.begin(), COMPRESSED_TEXT.end());
   };
+
+const std::function<void(std::shared_ptr<test_server::web_client>)> corrupted_handler =
+  [](std::shared_ptr<test_server::web_client> client_data) {
+    client_data->response_printf("Content-type: text/plain\r\nContent-Encoding: gzip\r\n\r\n");
+    client_data->response_printf(GET_RESPONSE.c_str());
+  };
+
+const std::function<void(std::shared_ptr<test_server::web_client>)> truncated_handler =
+  [](std::shared_ptr<test_server::web_client> client_data) {
+    client_data->response_printf("Content-type: text/plain\r\nContent-Encoding: gzip\r\n\r\n");
+    client_data->m_response_buffer.insert(std::end(client_data->m_response_buffer),
+                                          COMPRESSED_TEXT.begin(),
+                                          COMPRESSED_TEXT.begin() + COMPRESSED_TEXT.size() / 2);
+  };
+
+const std::function<void(std::shared_ptr<test_server::web_client>)> cacheable_handler =
+  [](std::shared_ptr<test_server::web_client> client_data) {
+    client_data->response_printf("Cache-Control: max-age=3600\r\nContent-type: text/plain\r\n\r\n");
+    client_data->response_printf(GET_RESPONSE.c_str());
+  };
+
+const std::function<void(std::shared_ptr<test_server::web_client>)> validated_handler =
+  [](std::shared_ptr<test_server::web_client> client_data) {
+    if (client_data->get_header("If-None-Match") == RESOURCE_ETAG)
+    {
+      client_data->m_status_line = "304 Not Modified";
+      client_data->response_printf("ETag: %s\r\n\r\n", RESOURCE_ETAG.c_str());
+    }
+    else
+    {
+      client_data->response_printf("Cache-Control: no-cache\r\nETag: %s\r\n", RESOURCE_ETAG.c_str());
+      client_data->response_printf("Content-type: text/plain\r\n\r\n");
+      client_data->response_printf(GET_RESPONSE.c_str());
+    }
+  };
+
+const std::function<void(std::shared_ptr<test_server::web_client>)> accept_encoding_handler =
+  [](std::shared_ptr<test_server::web_client> client_data) {
+    client_data->response_printf("Content-type: text/plain\r\n\r\n");
+    const auto accept_encoding = client_data->get_header("Accept-Encoding");
+    client_data->response_printf(accept_encoding.empty() ? "none" : accept_encoding.c_str());
+  };
+
+const std::function<void(std::shared_ptr<test_server::web_client>)> request_line_handler =
+  [](std::shared_ptr<test_server::web_client> client_data) {
+    client_data->response_printf("Content-type: text/plain\r\n\r\n");
+    const auto request_line = client_data->m_http_head.substr(0, client_data->m_http_head.find("\r\n"));
+    client_data->response_printf("%s", request_line.c_str());
+  };
 }  // namespace
 
 class post_data_queue
@@ -147,6 +203,12 @@ protected:
                        { ECHO_RESOURCE, echo_handler },
                        { REDIRECTION_RESOURCE, redirection_handler },
                        { COMPRESSED_RESOURCE, compressed_handler },
+                       { CORRUPTED_RESOURCE, corrupted_handler },
+                       { TRUNCATED_RESOURCE, truncated_handler },
+                       { CACHEABLE_RESOURCE, cacheable_handler },
+                       { VALIDATED_RESOURCE, validated_handler },
+                       { ACCEPT_ENCODING_RESOURCE, accept_encoding_handler },
+                       { REQUEST_LINE_RESOURCE, request_line_handler },
                        { POST_RESOURCE,
                          [&](std::shared_ptr<test_server::web_client> client_data) {
                            m_post_data_queue.add_request_post_data(client_data);
@@ -70,5 +70,108 @@ TEST_F(io_context_test, executor_binding)
 
   m_io_context.run();
 }
+
+TEST_F(io_context_test, move_only_handler)
+{
+  std::uint32_t code  = 0;
+  auto          owned = std::make_unique<std::uint32_t>(0);
+  m_http_client->get(
+    [&code, owned = std::move(owned)](http_request_result result) { code = *owned + result.http_response_code; },
+    get_url(GET_RESOURCE),
+    HTTP_CANCELLATION_TOKEN);
+
+  m_io_context.run();
+
+  EXPECT_EQ(200, code);
+}
+
+TEST_F(io_context_test, coalesced_requests)
+{
+  const std::size_t num_requests = 10;
+
+  http_client_settings settings;
+  settings.coalesce_requests = true;
+  m_http_client.reset(new http_client(settings, m_io_context));
+
+  // The io_context is not running yet, so the first request is still in progress when the others arrive
+  std::vector<std::future<http_request_result>> futures;
+  for (std::size_t i = 0; i < num_requests; ++i)
+  {
+    futures.push_back(m_http_client->get(use_std_future, get_url(GET_RESOURCE), HTTP_CANCELLATION_TOKEN));
+  }
+  http_request head_request{
+    http_method::HEAD, url(get_url(GET_RESOURCE)), 120000, {}, {}, {}, compression_policy::never
+  };
+  auto other_future = m_http_client->execute_request(use_std_future, head_request, HTTP_CANCELLATION_TOKEN);
+
+  m_io_context.run();
+
+  for (auto& future : futures)
+  {
+    auto result = future.get();
+    EXPECT_FALSE(result.error);
+    EXPECT_EQ(200, result.http_response_code);
+    EXPECT_EQ(GET_RESPONSE, result.get_body_as_string());
+  }
+  EXPECT_EQ(200, other_future.get().http_response_code);
+
+  const auto stats = m_http_client->get_stats();
+  EXPECT_EQ(num_requests + 1, stats.requests);
+  EXPECT_EQ(num_requests - 1, stats.coalesced_requests);
+}
+
+TEST_F(io_context_test, pipelined_requests)
+{
+  const std::size_t num_requests = 20;
+
+  http_client_settings settings(8, 5);
+  settings.pipeline_depth = 4;
+  m_http_client.reset(new http_client(settings, m_io_context));
+
+  std::vector<std::future<http_request_result>> futures;
+  for (std::size_t i = 0; i < num_requests; ++i)
+  {
+    futures.push_back(m_http_client->get(use_std_future, get_url(GET_RESOURCE), HTTP_CANCELLATION_TOKEN));
+  }
+
+  m_io_context.run();
+
+  for (auto& future : futures)
+  {
+    auto result = future.get();
+    EXPECT_FALSE(result.error);
+    EXPECT_EQ(200, result.http_response_code);
+    EXPECT_EQ(GET_RESPONSE, result.get_body_as_string());
+  }
+
+  // Eight requests in parallel, four on each connection
+  EXPECT_EQ(2, m_http_client->get_stats().connections);
+}
+
+TEST_F(io_context_test, pipelined_requests_replayed)
+{
+  const std::size_t num_requests = 8;
+
+  // The server closes the connection after the first response, the requests behind it are sent again
+  http_client_settings settings(4, 10);
+  settings.pipeline_depth_per_host[url(get_url(CONNECTION_CLOSE_RESOURCE)).host] = 4;
+  m_http_client.reset(new http_client(settings, m_io_context));
+
+  std::vector<std::future<http_request_result>> futures;
+  for (std::size_t i = 0; i < num_requests; ++i)
+  {
+    futures.push_back(m_http_client->get(use_std_future, get_url(CONNECTION_CLOSE_RESOURCE), HTTP_CANCELLATION_TOKEN));
+  }
+
+  m_io_context.run();
+
+  for (auto& future : futures)
+  {
+    auto result = future.get();
+    EXPECT_FALSE(result.error);
+    EXPECT_EQ(200, result.http_response_code);
+  }
+  EXPECT_LE(num_requests, m_http_client->get_stats().connections);
+}
 }  // namespace test
 }  // namespace asio_http
@@ -0,0 +1,58 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#include "asio_http/internal/recycling_allocator.h"
+
+#include <boost/asio.hpp>
+#include <gtest/gtest.h>
+#include <type_traits>
+#include <vector>
+
+namespace asio_http
+{
+namespace internal
+{
+namespace test
+{
+TEST(recycling_allocator_test, blocks_reused)
+{
+  auto* block = recycling_memory::allocate(100);
+  recycling_memory::deallocate(block, 100);
+
+  // Same size class
+  auto* other = recycling_memory::allocate(120);
+  EXPECT_EQ(block, other);
+  recycling_memory::deallocate(other, 120);
+
+  // Too large to be kept
+  auto* large = recycling_memory::allocate(4096);
+  recycling_memory::deallocate(large, 4096);
+
+  std::vector<int, recycling_allocator<int>> numbers(10, 1);
+  EXPECT_EQ(10, numbers.size());
+}
+
+TEST(recycling_allocator_test, associated_allocator)
+{
+  boost::asio::io_context context;
+  auto                    strand = boost::asio::make_strand(context);
+  int                     calls  = 0;
+
+  auto handler = make_recycling_handler([&calls]() { calls++; });
+  static_assert(std::is_same<boost::asio::associated_allocator_t<decltype(handler)>, recycling_allocator<void>>::value,
+                "Not allocated from recycled memory");
+
+  for (int i = 0; i < 10; ++i)
+  {
+    boost::asio::post(strand, handler);
+    boost::asio::post(context, bind_recycling_handler(strand, [&calls]() { calls++; }));
+  }
+  context.run();
+  EXPECT_EQ(20, calls);
+}
+}  // namespace test
+}  // namespace internal
+}  // namespace asio_http
@@ -0,0 +1,146 @@
+/**
+    asio_http: http client library for boost asio
+    Copyright (c) 2017-2019 Julio Becerra Gomez
+    See COPYING for license information.
+*/
+
+#include "asio_http/internal/disk_cache.h"
+#include "asio_http/internal/response_cache.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace asio_http
+{
+namespace internal
+{
+namespace test
+{
+namespace
+{
+std::shared_ptr<const cached_response>
+store(response_cache& cache, const std::string& cache_control, const std::string& age)
+{
+  const std::vector<std::pair<std::string, std::string>> headers = { { "Cache-Control", cache_control },
+                                                                     { "Age", age },
+                                                                     { "ETag", "\"v1\"" } };
+  cache.store("key", 200, headers, http_body(std::vector<std::uint8_t>{ 'a' }));
+  return cache.find("key");
+}
+
+std::uintmax_t get_directory_size(const std::filesystem::path& path)
+{
+  std::uintmax_t size = 0;
+  for (const auto& entry : std::filesystem::directory_iterator(path))
+  {
+    size += entry.file_size();
+  }
+  return size;
+}
+}  // namespace
+
+TEST(response_cache_test, max_age)
+{
+  response_cache cache(1024 * 1024, nullptr);
+
+  EXPECT_TRUE(store(cache, "max-age=3600", "0")->is_fresh());
+  EXPECT_FALSE(store(cache, "max-age=3600", "3601")->is_fresh());
+
+  // Greater than 2^31, taken as 2^31 instead of overflowing
+  EXPECT_TRUE(store(cache, "max-age=99999999999999999999", "")->is_fresh());
+  EXPECT_FALSE(store(cache, "max-age=99999999999999999999", "99999999999999999999")->is_fresh());
+
+  // Invalid values mean already expired
+  EXPECT_FALSE(store(cache, "max-age=-1", "")->is_fresh());
+  EXPECT_FALSE(store(cache, "max-age=1\xb2", "")->is_fresh());
+}
+
+TEST(response_cache_test, client_identity_in_key)
+{
+  const auto request = [](ssl_settings ssl) {
+    return http_request(http_method::GET,
+                        url("https://127.0.0.1/resource"),
+                        http_request::DEFAULT_TIMEOUT_MSEC,
+                        std::move(ssl),
+                        {},
+                        {},
+                        compression_policy::never);
+  };
+
+  const auto key = response_cache::get_cache_key(request({ "key1.pem", "cert1.pem", "" }));
+  EXPECT_EQ(key, response_cache::get_cache_key(request({ "key1.pem", "cert1.pem", "" })));
+  EXPECT_NE(key, response_cache::get_cache_key(request({ "key2.pem", "cert2.pem", "" })));
+  EXPECT_NE(key, response_cache::get_cache_key(request({})));
+}
+
+TEST(response_cache_test, refreshed_on_disk)
+{
+  const auto path = std::filesystem::temp_directory_path() / "asio_http_response_cache_test";
+  std::filesystem::remove_all(path);
+
+  const std::vector<std::uint8_t> body(100000, 'a');
+  // Each scope is a process run, the disk cache is closed and its records written at the end
+  {
+    response_cache cache(0, disk_cache::open(path.string(), 1024 * 1024 * 1024));
+    cache.store("key", 200, { { "Cache-Control", "no-cache" }, { "ETag", "\"v1\"" } }, http_body(std::vector<std::uint8_t>(body)));
+  }
+  const auto stored_size = get_directory_size(path);
+
+  {
+    response_cache cache(0, disk_cache::open(path.string(), 1024 * 1024 * 1024));
+    const auto     stale = cache.find("key");
+    ASSERT_TRUE(stale);
+    EXPECT_FALSE(stale->is_fresh());
+    cache.refresh("key", *stale, { { "Cache-Control", "max-age=3600" } });
+  }
+  // Only the headers are written again
+  EXPECT_GT(stored_size + 1000, get_directory_size(path));
+
+  {
+    response_cache cache(0, disk_cache::open(path.string(), 1024 * 1024 * 1024));
+    const auto     fresh = cache.find("key");
+    ASSERT_TRUE(fresh);
+    EXPECT_TRUE(fresh->is_fresh());
+    EXPECT_EQ(body, fresh->get_body().to_vector());
+  }
+
+  std::filesystem::remove_all(path);
+}
+
+TEST(response_cache_test, corrupt_disk_segment)
+{
+  const auto path = std::filesystem::temp_directory_path() / "asio_http_response_cache_test";
+  std::filesystem::remove_all(path);
+  std::filesystem::create_directories(path);
+
+  // Same layout as the record headers of the disk cache, with a body size which wraps the end offset around
+  struct
+  {
+    std::uint32_t magic;
+    std::uint32_t status_code;
+    std::uint32_t key_size;
+    std::uint32_t headers_size;
+    std::int64_t  expiration_time_ms;
+    std::uint64_t body_size;
+  } header{ 0x31524841, 200, 3, 0, 0, ~std::uint64_t(0) - 16 };
+  {
+    std::ofstream segment(path / "segment-0.dat", std::ios::binary);
+    segment.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    segment.write("key", 3);
+  }
+
+  {
+    response_cache cache(0, disk_cache::open(path.string(), 1024 * 1024 * 1024));
+    EXPECT_FALSE(cache.find("key"));
+  }
+
+  std::filesystem::remove_all(path);
+}
+}  // namespace test
+}  // namespace internal
+}  // namespace asio_http
@@ -6,7 +6,12 @@
 
 #include "asio_http/internal/tuple_ptr.h"
 
+#include <cstdlib>
+#include <functional>
 #include <gtest/gtest.h>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
 
 namespace asio_http
 {
@@ -87,6 +92,65 @@ TEST(shared_ptr_test, test2)
   EXPECT_EQ(counter, 2);
 }
 
+int allocations   = 0;
+int deallocations = 0;
+
+template<typename T>
+struct counting_allocator : std::allocator<T>
+{
+  counting_allocator() = default;
+  template<typename U>
+  counting_allocator(const counting_allocator<U>&)
+  {
+  }
+  T* allocate(std::size_t n)
+  {
+    allocations++;
+    return std::allocator<T>::allocate(n);
+  }
+  void deallocate(T* p, std::size_t n)
+  {
+    deallocations++;
+    std::allocator<T>::deallocate(p, n);
+  }
+};
+
+struct ThrowingClass
+{
+  ThrowingClass() { throw std::runtime_error("Construction failed"); }
+};
+
+TEST(shared_ptr_test, allocate_tuple)
+{
+  int counter{};
+  allocations   = 0;
+  deallocations = 0;
+
+  {
+    auto shared = allocate_tuple<counting_allocator, TestClass, TestClass2>(
+      std::make_tuple(std::make_tuple(std::ref(counter)), std::make_tuple(std::ref(counter))));
+    EXPECT_EQ(allocations, 1);
+
+    // Both objects are in the same block
+    const auto first  = reinterpret_cast<char*>(shared.get<0>().get());
+    const auto second = reinterpret_cast<char*>(shared.get<1>().get());
+    EXPECT_LT(std::abs(first - second), 64);
+
+    auto element = shared.get<1>()->shared_from_this();
+    shared.reset();
+    EXPECT_EQ(counter, 0);
+  }
+
+  EXPECT_EQ(counter, 2);
+  EXPECT_EQ(deallocations, 1);
+
+  EXPECT_THROW((allocate_tuple<counting_allocator, TestClass, ThrowingClass>(
+                 std::make_tuple(std::make_tuple(std::ref(counter)), std::make_tuple()))),
+               std::runtime_error);
+  EXPECT_EQ(counter, 3);
+  EXPECT_EQ(deallocations, 2);
+}
+
 }  // namespace test
 }  // namespace internal
 }  // namespace asio_http
@@ -91,10 +91,13 @@ public:
       , m_header_size(0)
       , m_content_size(0)
       , m_requested_range(0)
+      , m_chunked(false)
+      , m_chunked_body()
       , m_handlers_map(handlers_map)
       , m_can_close(false)
       , m_close_connection(false)
       , m_timer(context)
+      , m_status_line()
   {
   }
   std::vector<char>                                                                        m_read_buffer;
@@ -107,11 +110,14 @@ public:
   std::size_t                                                                              m_header_size;
   std::size_t                                                                              m_content_size;
   std::size_t                                                                              m_requested_range;
+  bool                                                                                     m_chunked;
+  std::vector<char>                                                                        m_chunked_body;
   std::map<std::string, std::string>                                                       m_headers;
   std::shared_ptr<std::map<std::string, std::function<void(std::shared_ptr<web_client>)>>> m_handlers_map;
   bool                                                                                     m_can_close;
   bool                                                                                     m_close_connection;
   boost::asio::deadline_timer                                                              m_timer;
+  std::string                                                                              m_status_line;
 
   void start_reading()
   {
@@ -123,46 +129,84 @@ public:
 
   void read_client(const boost::system::error_code& error, size_t size)
   {
-    const char* tmp;
-
     if ((boost::asio::error::eof != error) && (boost::asio::error::connection_reset != error))
     {
       m_request_buffer.insert(std::end(m_request_buffer), std::begin(m_read_buffer), std::begin(m_read_buffer) + size);
+      parse_request();
+    }
+  }
+
+  // The buffer may also contain pipelined requests following the current one
+  void parse_request()
+  {
+    const char* tmp;
 
-      if (m_header_size == 0)
+    if (m_header_size == 0)
+    {
+      if ((tmp = mystrnstr(m_request_buffer.data(), "\r\n\r\n", m_request_buffer.size())))
       {
-        if ((tmp = mystrnstr(m_request_buffer.data(), "\r\n\r\n", m_request_buffer.size())))
-        {
-          m_header_size = (tmp - m_request_buffer.data());
-          m_http_head.assign(m_request_buffer.begin(), m_request_buffer.end());
-        }
+        m_header_size = (tmp - m_request_buffer.data());
+        m_http_head.assign(m_request_buffer.begin(), m_request_buffer.begin() + m_header_size + 4);
       }
-      if (m_header_size != 0)
+    }
+    if (m_header_size != 0)
+    {
+      auto dataSize = m_request_buffer.size() - m_header_size;
+      if (m_content_size == 0)
       {
-        auto dataSize = m_request_buffer.size() - m_header_size;
-        if (m_content_size == 0)
+        const std::string contentLength = get_header("Content-Length");
+        if (!contentLength.empty())
         {
-          const std::string contentLength = get_header("Content-Length");
-          if (!contentLength.empty())
-          {
-            m_content_size = std::stol(contentLength);
-          }
+          m_content_size = std::stol(contentLength);
         }
-
-        if (m_content_size == dataSize - 4)
-        {
-          process_client();
-        }
-        else
+        else if (get_header("Transfer-Encoding") == "chunked" && !decode_chunked_body())
         {
           start_reading();
+          return;
         }
       }
+
+      if (m_content_size <= dataSize - 4)
+      {
+        process_client();
+      }
       else
       {
         start_reading();
       }
     }
+    else
+    {
+      start_reading();
+    }
+  }
+
+  // The whole body is needed, m_content_size gets the size of the encoded body
+  bool decode_chunked_body()
+  {
+    const char* body     = m_request_buffer.data() + m_header_size + 4;
+    const auto  body_end = m_request_buffer.data() + m_request_buffer.size();
+    const char* pos      = body;
+
+    m_chunked_body.clear();
+    const char* line_end;
+    while (pos < body_end && (line_end = mystrnstr(pos, "\r\n", body_end - pos)))
+    {
+      const auto chunk_size = std::stoul(std::string(pos, line_end), nullptr, 16);
+      if (static_cast<std::size_t>(body_end - line_end) < chunk_size + 4)
+      {
+        break;
+      }
+      m_chunked_body.insert(m_chunked_body.end(), line_end + 2, line_end + 2 + chunk_size);
+      pos = line_end + 4 + chunk_size;
+      if (chunk_size == 0)
+      {
+        m_chunked      = true;
+        m_content_size = pos - body;
+        return true;
+      }
+    }
+    return false;
   }
 
   std::string get_header(const std::string& name)
@@ -240,22 +284,29 @@ public:
 
   std::vector<char> get_post_data()
   {
+    if (m_chunked)
+    {
+      return m_chunked_body;
+    }
     char* begin = mystrnstr(m_request_buffer.data(), "\r\n\r\n", m_request_buffer.size());
-    return std::vector<char>(begin + 4, &(*(--m_request_buffer.end())) + 1);
+    return std::vector<char>(begin + 4, begin + 4 + m_content_size);
   }
 
   void response_printf(const char* fmt, ...)
   {
     va_list args;
+    va_list args_copy;
 
     va_start(args, fmt);
+    va_copy(args_copy, args);
 
     auto              len = vsnprintf(nullptr, 0, fmt, args);
     std::vector<char> formattedString(len + 1);
-    vsnprintf(formattedString.data(), len + 1, fmt, args);
+    vsnprintf(formattedString.data(), len + 1, fmt, args_copy);
 
     m_response_buffer.insert(std::end(m_response_buffer), std::begin(formattedString), --std::end(formattedString));
 
+    va_end(args_copy);
     va_end(args);
   }
 
@@ -311,7 +362,11 @@ public:
       web_client_writef(range_msg, server);
     }
 
-    if (m_requested_range > 0)
+    if (!m_status_line.empty())
+    {
+      web_client_writef("HTTP/1.1 %s\r\n", m_status_line.c_str());
+    }
+    else if (m_requested_range > 0)
     {
       web_client_writef("HTTP/1.1 206 Partial Content\r\n");
     }
@@ -369,7 +424,7 @@ public:
       else
       {
         client_data_cleanup();
-        start_reading();
+        parse_request();
       }
     }
   }
@@ -381,11 +436,16 @@ public:
     m_response_buffer.clear();
     m_output_buffer.clear();
     m_write_buffer.clear();
-    m_request_buffer.clear();
+    m_request_buffer.erase(m_request_buffer.begin(),
+                           m_request_buffer.begin() + std::min(m_request_buffer.size(), m_header_size + 4 + m_content_size));
     m_http_head.clear();
+    m_headers.clear();
     m_header_size     = 0;
     m_content_size    = 0;
     m_requested_range = 0;
+    m_chunked         = false;
+    m_chunked_body.clear();
+    m_status_line.clear();
     m_timer.cancel();
   }
 